@@ -0,0 +1,260 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <windows.h>
+#include <process.h>
+#include "common.h"
+#include "pcm.h"
+#include "audioenv.h"
+
+struct A2pAudioEnvs {
+    const char             *script;
+    int                     channels;
+    int                     sample_type;  // read from every environment
+    size_t                  source_size;  // bytes per sample read
+    size_t                  size;         // bytes per sample written
+    int                     bits;         // pcm bits or 0
+    int                     dither;
+    
+    uint64_t                first;        // first sample
+    uint64_t                count;        // samples from first
+    size_t                  block;        // samples per block
+    size_t                  overlap;      // warm up samples before a block
+    
+    int                     envs;
+    int                     depth;        // slots in the reorder buffer
+    int64_t                 next;         // next block a worker will claim
+    int64_t                 blocks;       // blocks in count
+    int64_t                 consumed;     // next block handed out in order
+    volatile LONG           stop;
+    
+    BYTE                  **slots;        // block n is read into n % depth
+    HANDLE                 *ready;        // per slot, released when read
+    HANDLE                  window;       // counts free slots
+    HANDLE                 *workers;
+    CRITICAL_SECTION        claim;
+    CRITICAL_SECTION        load;         // scripts are loaded one at a time
+};
+
+static unsigned __stdcall
+a2p_audio_envs_worker(void *data)
+{
+    A2pAudioEnvs *ae = data;
+    AVS_ScriptEnvironment *env;
+    AVS_Clip *clip;
+    const AVS_VideoInfo *info;
+    A2pPcm pcm;
+    BYTE *scratch, *slot;
+    size_t count, step;
+    uint64_t start, warm, last;
+    uint32_t seed;
+    int64_t n;
+    int i;
+    
+    // plugins are not all safe to load from several threads at once
+    EnterCriticalSection(&ae->load);
+    env = avs_create_script_environment(AVISYNTH_INTERFACE_VERSION);
+    clip = a2p_avs_source(env, (char *) ae->script);
+    LeaveCriticalSection(&ae->load);
+    info = avs_get_video_info(clip);
+    if(!avs_has_audio(info) || info->nchannels != ae->channels ||
+       info->sample_type != ae->sample_type ||
+       (uint64_t) info->num_audio_samples < ae->first + ae->count) {
+        a2p_log(A2P_LOG_ERROR, "a script environment loaded different "
+                "audio.\n");
+    }
+    
+    scratch = malloc(ae->block * ae->source_size);
+    if(scratch == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate sample buffer.\n");
+    }
+    
+    last = 0;
+    for(;;) {
+        // at most depth blocks are claimed and not yet consumed, so by the
+        // time block n is claimed block n - depth has left slot n % depth
+        WaitForSingleObject(ae->window, INFINITE);
+        
+        EnterCriticalSection(&ae->claim);
+        n = ae->next;
+        if(!ae->stop && n < ae->blocks) ae->next++;
+        LeaveCriticalSection(&ae->claim);
+        
+        if(ae->stop || n >= ae->blocks) {
+            // pass the wake up on so every worker sees the end
+            ReleaseSemaphore(ae->window, 1, NULL);
+            break;
+        }
+        
+        start = ae->first + n * ae->block;
+        count = n == ae->blocks - 1 ?
+                (size_t) (ae->count - n * ae->block) : ae->block;
+        
+        // the samples before the block warm up the filter chain and are
+        // thrown away, unless this environment just read them
+        warm = start > ae->overlap ? start - ae->overlap : 0;
+        if(warm < last) warm = last;
+        while(warm < start) {
+            step = start - warm > ae->block ? ae->block :
+                   (size_t) (start - warm);
+            avs_get_audio(clip, scratch, warm, step);
+            warm += step;
+        }
+        
+        slot = ae->slots[n % ae->depth];
+        if(ae->bits > 0) {
+            // the dither of a block follows from its number, not from
+            // which environment read it, so reruns write the same bytes
+            a2p_pcm_init(&pcm, ae->bits, ae->dither);
+            for(i = 0; i < 4; i++) {
+                seed = pcm.seed[i] ^ (uint32_t) (n + 1) * 0x85ebca6b;
+                if(seed != 0) pcm.seed[i] = seed;
+            }
+            avs_get_audio(clip, scratch, start, count);
+            a2p_pcm_convert(&pcm, slot, (float *) scratch,
+                            count * ae->channels);
+        } else {
+            avs_get_audio(clip, slot, start, count);
+        }
+        last = start + count;
+        
+        ReleaseSemaphore(ae->ready[n % ae->depth], 1, NULL);
+    }
+    
+    free(scratch);
+    avs_release_clip(clip);
+    avs_delete_script_environment(env);
+    
+    return 0;
+}
+
+A2pAudioEnvs *
+a2p_audio_envs_create(const char *script, const AVS_VideoInfo *info,
+                      uint64_t first, uint64_t count, int envs, size_t block,
+                      size_t overlap, int bits, int dither)
+{
+    A2pAudioEnvs *ae;
+    int i;
+    
+    ae = malloc(sizeof(*ae));
+    if(ae == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate audio render state.\n");
+    }
+    ae->script = script;
+    ae->channels = info->nchannels;
+    ae->sample_type = info->sample_type;
+    ae->source_size = avs_bytes_per_channel_sample(info) * info->nchannels;
+    ae->size = bits > 0 ? bits / 8 * info->nchannels : ae->source_size;
+    ae->bits = bits;
+    ae->dither = dither;
+    ae->first = first;
+    ae->count = count;
+    ae->block = block;
+    ae->overlap = overlap;
+    ae->envs = envs;
+    ae->depth = 2 * envs; // a block being read and one waiting for each
+    ae->next = 0;
+    ae->blocks = (count + block - 1) / block;
+    ae->consumed = 0;
+    ae->stop = 0;
+    
+    ae->slots = malloc(ae->depth * sizeof(*ae->slots));
+    ae->ready = malloc(ae->depth * sizeof(*ae->ready));
+    ae->workers = malloc(envs * sizeof(*ae->workers));
+    if(ae->slots == NULL || ae->ready == NULL || ae->workers == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate audio render state.\n");
+    }
+    
+    InitializeCriticalSection(&ae->claim);
+    InitializeCriticalSection(&ae->load);
+    ae->window = CreateSemaphore(NULL, ae->depth, ae->depth, NULL);
+    for(i = 0; i < ae->depth; i++) {
+        ae->slots[i] = malloc(block * ae->size);
+        ae->ready[i] = CreateSemaphore(NULL, 0, 1, NULL);
+        if(ae->slots[i] == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not allocate sample buffer.\n");
+        }
+        if(ae->ready[i] == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not create audio semaphore.\n");
+        }
+    }
+    if(ae->window == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not create audio semaphore.\n");
+    }
+    
+    a2p_log(A2P_LOG_INFO, "reading %u sample blocks in %d script "
+            "environments, %u samples overlap.\n", (unsigned) block, envs,
+            (unsigned) overlap);
+    
+    for(i = 0; i < envs; i++) {
+        ae->workers[i] = (HANDLE) _beginthreadex(NULL, 0,
+                                                 a2p_audio_envs_worker, ae, 0,
+                                                 NULL);
+        if(ae->workers[i] == 0) {
+            a2p_log(A2P_LOG_ERROR, "could not start audio thread.\n");
+        }
+    }
+    
+    return ae;
+}
+
+BYTE *
+a2p_audio_envs_next(A2pAudioEnvs *ae, size_t *count)
+{
+    WaitForSingleObject(ae->ready[ae->consumed % ae->depth], INFINITE);
+    *count = ae->consumed == ae->blocks - 1 ?
+             (size_t) (ae->count - ae->consumed * ae->block) : ae->block;
+    return ae->slots[ae->consumed % ae->depth];
+}
+
+void
+a2p_audio_envs_release(A2pAudioEnvs *ae)
+{
+    ae->consumed++;
+    ReleaseSemaphore(ae->window, 1, NULL);
+}
+
+void
+a2p_audio_envs_destroy(A2pAudioEnvs *ae)
+{
+    int i;
+    
+    // stop claiming blocks and wake any worker waiting on a free slot
+    InterlockedExchange(&ae->stop, 1);
+    ReleaseSemaphore(ae->window, 1, NULL);
+    
+    for(i = 0; i < ae->envs; i++) {
+        WaitForSingleObject(ae->workers[i], INFINITE);
+        CloseHandle(ae->workers[i]);
+    }
+    for(i = 0; i < ae->depth; i++) {
+        CloseHandle(ae->ready[i]);
+        free(ae->slots[i]);
+    }
+    CloseHandle(ae->window);
+    DeleteCriticalSection(&ae->load);
+    DeleteCriticalSection(&ae->claim);
+    
+    free(ae->workers);
+    free(ae->ready);
+    free(ae->slots);
+    free(ae);
+}
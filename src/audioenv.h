@@ -0,0 +1,59 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Parallel audio render, the samples are split into blocks read by
+// several script environments that each load the script on their own
+// thread, so a single threaded resample or time stretch scales over the
+// cores like a segmented video render. Each block is read after the
+// overlap samples before it, which are thrown away, so stateful filters
+// have warmed up by the first sample kept. Blocks are handed out in
+// order through a reorder window like A2pPrefetch.
+
+#ifndef AUDIOENV_H
+#define AUDIOENV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "avs2pipe.h"
+
+typedef struct A2pAudioEnvs A2pAudioEnvs;
+
+// renders samples [first, first + count) of script, which must have the
+// channels and sample type of info, in envs environments a block at a
+// time, bits 16 or 24 converts float audio to pcm with --audio-dither
+// dither, 0 keeps the samples
+A2pAudioEnvs *
+a2p_audio_envs_create(const char *script, const AVS_VideoInfo *info,
+                      uint64_t first, uint64_t count, int envs, size_t block,
+                      size_t overlap, int bits, int dither);
+
+// blocks until the next block in order is read, returns its buffer and
+// sets count to its samples, only the last block is short
+BYTE *
+a2p_audio_envs_next(A2pAudioEnvs *envs, size_t *count);
+
+// returns the buffer from a2p_audio_envs_next to the workers
+void
+a2p_audio_envs_release(A2pAudioEnvs *envs);
+
+void
+a2p_audio_envs_destroy(A2pAudioEnvs *envs);
+
+#endif // AUDIOENV_H
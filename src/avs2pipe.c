@@ -27,325 +27,1824 @@
 #include <fcntl.h>
 #include <io.h>
 #include <string.h>
-#ifdef A2P_AVS26
-    #include "avisynth26/avisynth_c.h"
-#else
-    #include "avisynth/avisynth_c.h"
-#endif
+#include <windows.h>
+#include "avs2pipe.h"
 #include "common.h"
 #include "wave.h"
+#include "video.h"
+#include "prefetch.h"
+#include "segment.h"
+#include "mapfile.h"
+#include "pool.h"
+#include "writer.h"
+#include "ladder.h"
+#include "ring.h"
+#include "net.h"
+#include "lz4.h"
+#include "daemon.h"
+#include "coord.h"
+#include "cpu.h"
+#include "pcm.h"
+#include "mkv.h"
+#include "audioenv.h"
 
+// most --video-out destinations and --rung sizes one render is written to
+#define A2P_MAX_OUTPUTS 8
+
+// fewest samples read from AviSynth at once when the chunk is sized
+#define A2P_AUDIO_CHUNK_MIN 4096
+
+// seconds of samples each --envs environment reads at a time
+#define A2P_AUDIO_BLOCK_SECONDS 2
+
+typedef struct A2pArgs A2pArgs;
+
+struct A2pArgs {
+    int     start;          // first frame written
+    int     frames;         // frames written from start, 0 for the rest
+    int     threads;        // prefetch worker threads, 0 renders inline
+    int     prefetch;       // frames rendered ahead of the writer
+    int     envs;           // script environments rendering chunks, 0 for one
+    int     chunk;          // frames per chunk, 0 splits evenly
+    const char *segment_out; // segment file name pattern
+    const char *map_out;    // file written through mapped views
+    const char *ring;       // shared memory ring name
+    const char *serve;      // host:port a client fetches the output from
+    int     lz4;            // compress what is served
+    const char *daemon;     // host:port of a daemon holding the script
+    int     cache;          // scripts a daemon keeps loaded
+    const char *coordinate; // host:port render workers connect to
+    int     spawn;          // local worker processes started
+    const char *input;      // script, loaded again by each environment
+    int     buffers;        // writer thread ring size, 1 writes inline
+    int     audio_chunk;    // samples per audio buffer, 0 sizes to the cache
+    int     audio_bits;     // pcm bits float audio is written as, 0 keeps it
+    int     audio_dither;   // tpdf dither the converted audio
+    int     rf64;           // RF64 wav headers whatever the size
+    int     audio_overlap;  // warm up samples before each --envs block
+    int     direct;         // write straight from AviSynth frame memory
+    int     async;          // overlapped writes instead of writer threads
+    const char *video_out[A2P_MAX_OUTPUTS]; // video files or pipes
+    int     video_outs;     // 0 writes video to stdout
+    const char *audio_out;  // av audio file or pipe
+    int     rung_width[A2P_MAX_OUTPUTS]; // scaled copies of the video
+    int     rung_height[A2P_MAX_OUTPUTS];
+    const char *rung_out[A2P_MAX_OUTPUTS];
+    int     rungs;          // 0 writes no ladder
+    A2pScaleKernel scaler;  // filter the rungs are scaled with
+    A2pVideoOptions video;  // output format choices
+};
+
+
+AVS_Clip *
+a2p_avs_invoke(AVS_ScriptEnvironment *env, const char *name, AVS_Value *args,
+               int args_num)
+{
+    AVS_Value val_array, val_return;
+    AVS_Clip *clip;
+    
+    val_array = avs_new_value_array(args, args_num);
+    val_return = avs_invoke(env, name, val_array, 0);
+    
+    if(avs_is_error(val_return)) {
+        a2p_log(A2P_LOG_ERROR, "%s\n", avs_as_string(val_return));
+    } else if(!avs_is_clip(val_return)) {
+        a2p_log(A2P_LOG_ERROR, "%s return value is not a clip.\n", name);
+    }
+    
+    clip = avs_take_clip(val_return, env);
+    
+    avs_release_value(val_array);
+    avs_release_value(val_return);
+    
+    return clip;
+}
+
+AVS_Clip *
+a2p_avs_filter(AVS_ScriptEnvironment *env, const char *filter, AVS_Clip *clip)
+{
+    AVS_Value val_clip;
+    
+    val_clip = avs_new_value_clip(clip);
+    avs_release_clip(clip);
+    
+    clip = a2p_avs_invoke(env, filter, &val_clip, 1);
+    
+    avs_release_value(val_clip);
+    
+    return clip;
+}
+
+// Trim cuts the audio at the first sample of each boundary frame, sample
+// n * rate * fps_den / fps_num, so consecutive ranges join sample exact
+AVS_Clip *
+a2p_avs_trim(AVS_ScriptEnvironment *env, AVS_Clip *clip, int start,
+             int frames)
+{
+    const AVS_VideoInfo *info;
+    AVS_Value val_args[3];
+    int64_t first;
+    
+    info = avs_get_video_info(clip);
+    if(!avs_has_video(info)) {
+        a2p_log(A2P_LOG_ERROR, "frame ranges need a clip with video.\n");
+    }
+    if(start >= info->num_frames) {
+        a2p_log(A2P_LOG_ERROR, "--start %d is past the last frame %d.\n",
+                start, info->num_frames - 1);
+    }
+    if(frames == 0 || frames > info->num_frames - start) {
+        frames = info->num_frames - start;
+    }
+    if(start == 0 && frames == info->num_frames) return clip;
+    
+    // a negative end is a frame count, unlike 0 which means the last frame
+    val_args[0] = avs_new_value_clip(clip);
+    val_args[1] = avs_new_value_int(start);
+    val_args[2] = avs_new_value_int(-frames);
+    avs_release_clip(clip);
+    
+    clip = a2p_avs_invoke(env, "Trim", val_args, 3);
+    
+    avs_release_value(val_args[0]);
+    
+    a2p_log(A2P_LOG_INFO, "keeping frames %d to %d.\n", start,
+            start + frames - 1);
+    if(avs_has_audio(info)) {
+        first = (int64_t) start * info->audio_samples_per_second *
+                info->fps_denominator / info->fps_numerator;
+        info = avs_get_video_info(clip);
+        a2p_log(A2P_LOG_INFO, "keeping audio samples %I64d to %I64d.\n",
+                first, first + info->num_audio_samples - 1);
+    }
+    
+    return clip;
+}
 
 AVS_Clip *
-a2p_avs_invoke(AVS_ScriptEnvironment *env, const char *name, AVS_Value *arg)
+a2p_avs_source(AVS_ScriptEnvironment *env, char *file)
+{
+    AVS_Clip *clip;
+    AVS_Value val_string;
+    char *ext, *import;
+    
+    import = "Import";
+    ext = strrchr(file, '.');
+    if(!strcmp(ext, ".avsg")) {
+        if(avs_function_exists(env, "GImport")) {
+            a2p_log(A2P_LOG_INFO, "Enabling GScript support for GImport.\n");
+            import = "GImport";
+        } else {
+            a2p_log(A2P_LOG_WARNING, "GScript support missing, trying standard Import.\n");
+        }
+    }
+    
+    val_string = avs_new_value_string(file);
+    
+    clip = a2p_avs_invoke(env, import, &val_string, 1);
+    
+    avs_release_value(val_string);
+    
+    return clip;
+}
+
+// wav format of the audio, unknown types are tried as pcm
+static WaveFormatType
+a2p_wave_format(const AVS_VideoInfo *info)
+{
+    if(!avs_has_audio(info)) {
+        a2p_log(A2P_LOG_ERROR, "source has no audio.\n");
+    }
+    
+    a2p_log(A2P_LOG_INFO, "writing %I64d seconds of %d Hz, %d channel audio.\n",
+            (info->num_audio_samples / info->audio_samples_per_second),
+            info->audio_samples_per_second, info->nchannels);
+    
+    // AviSynth only supports AVS_SAMPLE_FLOAT & AVS_SAMPLE_INT*
+    switch(info->sample_type) {
+        case AVS_SAMPLE_FLOAT:
+            return WAVE_FORMAT_IEEE_FLOAT;
+        default:
+            a2p_log(A2P_LOG_WARNING, "audio format unknown trying PCM.\n");
+        case AVS_SAMPLE_INT8:
+        case AVS_SAMPLE_INT16:
+        case AVS_SAMPLE_INT24:
+        case AVS_SAMPLE_INT32:
+            return WAVE_FORMAT_PCM;
+    }
+}
+
+// wav header of samples of the audio to be freed, sets size to its
+// length, RF64 when asked for or the data passes 4GB
+static void *
+a2p_wave_create(WaveFormatType format, const AVS_VideoInfo *info,
+                int64_t samples, int rf64, size_t *size)
+{
+    if(rf64 || wave_needs_rf64(info->nchannels,
+                               avs_bytes_per_channel_sample(info), samples)) {
+        *size = sizeof(WaveRf64Header);
+        return wave_create_rf64_header(format, info->nchannels,
+                                       info->audio_samples_per_second,
+                                       avs_bytes_per_channel_sample(info),
+                                       samples);
+    }
+    *size = sizeof(WaveRiffHeader);
+    
+    return wave_create_riff_header(format, info->nchannels,
+                                   info->audio_samples_per_second,
+                                   avs_bytes_per_channel_sample(info),
+                                   samples);
+}
+
+// checks and logs the audio, returns its wav header to be freed and sets
+// size to its length
+static void *
+a2p_wave_header(const AVS_VideoInfo *info, int rf64, size_t *size)
+{
+    void *header;
+    
+    header = a2p_wave_create(a2p_wave_format(info), info,
+                             info->num_audio_samples, rf64, size);
+    if(*size == sizeof(WaveRf64Header)) {
+        a2p_log(A2P_LOG_INFO, "writing an RF64 header.\n");
+    }
+    
+    return header;
+}
+
+// checks the audio and writes its wav header to out. A file gets an RF64
+// sized header, RIFF with a JUNK chunk while the data fits, which is
+// returned for a2p_audio_finish to rewrite with the sizes written. Pipes
+// get a header sized up front and NULL is returned
+static WaveRf64Header *
+a2p_audio_header(FILE *out, const AVS_VideoInfo *info, int rf64)
+{
+    WaveRf64Header *header;
+    void *plain;
+    size_t size;
+    
+    if(GetFileType((HANDLE) _get_osfhandle(_fileno(out))) != FILE_TYPE_DISK) {
+        plain = a2p_wave_header(info, rf64, &size);
+        fwrite(plain, size, 1, out);
+        fflush(out);
+        free(plain); // free the wav header
+        return NULL;
+    }
+    
+    header = wave_create_rf64_header(a2p_wave_format(info), info->nchannels,
+                                     info->audio_samples_per_second,
+                                     avs_bytes_per_channel_sample(info),
+                                     info->num_audio_samples);
+    wave_set_rf64_size(header, info->num_audio_samples, rf64);
+    fwrite(header, sizeof(*header), 1, out);
+    fflush(out);
+    
+    return header;
+}
+
+// rewrites the header a2p_audio_header returned for the samples written,
+// it becomes RF64 if they passed 4GB
+static void
+a2p_audio_finish(FILE *out, WaveRf64Header *header, uint64_t samples,
+                 int rf64)
+{
+    if(header == NULL) return;
+    
+    wave_set_rf64_size(header, samples, rf64);
+    fflush(out);
+    if(fseek(out, 0, SEEK_SET) != 0 ||
+       fwrite(header, sizeof(*header), 1, out) != 1 || fflush(out) != 0) {
+        a2p_log(A2P_LOG_WARNING, "could not rewrite the wav header.\n");
+    }
+    free(header);
+}
+
+// "-" is stdout, anything else is opened like a file, so named pipes
+// such as \\.\pipe\name work too
+static FILE *
+a2p_open_output(const char *path)
+{
+    FILE *out;
+    
+    if(path == NULL || strcmp(path, "-") == 0) {
+        if(_setmode(_fileno(stdout), _O_BINARY) == -1) {
+            a2p_log(A2P_LOG_ERROR, "cannot switch stdout to binary mode.\n");
+        }
+        return stdout;
+    }
+    out = fopen(path, "wb");
+    if(out == NULL) {
+        a2p_log(A2P_LOG_ERROR, "cannot open %s for writing.\n", path);
+    }
+    
+    return out;
+}
+
+// opens every --video-out, stdout when there are none
+static int
+a2p_open_video_outputs(const A2pArgs *args, FILE **outs)
+{
+    int i;
+    
+    if(args->video_outs == 0) {
+        outs[0] = a2p_open_output(NULL);
+        return 1;
+    }
+    for(i = 0; i < args->video_outs; i++) {
+        outs[i] = a2p_open_output(args->video_out[i]);
+    }
+    
+    return args->video_outs;
+}
+
+// writer for every output, with overlapped writes when asked for
+static A2pWriter *
+a2p_create_writer(const A2pArgs *args, FILE *const *outs, int outs_num,
+                  size_t size)
+{
+    if(args->async) {
+        return a2p_writer_create_async(outs, outs_num, size, args->buffers);
+    }
+    return a2p_writer_create_tee(outs, outs_num, size, args->buffers);
+}
+
+// samples per audio buffer, --audio-chunk or as many as keep the ring
+// and the buffer being read within half the cache, so the writer reads
+// what AviSynth just wrote from cache and wide float audio still gets
+// short reads
+static size_t
+a2p_audio_chunk(const AVS_VideoInfo *info, const A2pArgs *args)
+{
+    size_t size, count;
+    
+    if(args->audio_chunk > 0) return args->audio_chunk;
+    size = avs_bytes_per_channel_sample(info) * info->nchannels;
+    count = a2p_cpu_cache_size() / 2 / ((args->buffers + 1) * size);
+    if(count > (size_t) info->audio_samples_per_second) {
+        count = info->audio_samples_per_second;
+    }
+    if(count < A2P_AUDIO_CHUNK_MIN) count = A2P_AUDIO_CHUNK_MIN;
+    
+    return count;
+}
+
+static void
+a2p_audio_done(const AVS_VideoInfo *info, uint64_t wrote, uint64_t target)
+{
+    a2p_log(A2P_LOG_INFO, "finished, wrote %I64u seconds [%I64u%%].\n", 
+        wrote / info->audio_samples_per_second,
+        (100 * wrote) / target);
+    
+    if(wrote != target) {
+        a2p_log(A2P_LOG_ERROR, "only wrote %I64u of %I64u samples.\n",
+                wrote, target);
+    }
+}
+
+// blocks of samples read by the --envs environments, which load the
+// untrimmed script, written to stdout in order, returns the samples
+// written
+static uint64_t
+a2p_audio_write_envs(const AVS_VideoInfo *info, const A2pArgs *args,
+                     int bits, size_t size)
+{
+    A2pAudioEnvs *envs;
+    A2pWriter *writer;
+    FILE *out;
+    BYTE *buff;
+    void *copy;
+    size_t block, count, step;
+    uint64_t first, wrote, done;
+    
+    first = 0;
+    if(args->start > 0) {
+        first = (uint64_t) args->start * info->audio_samples_per_second *
+                info->fps_denominator / info->fps_numerator;
+    }
+    block = A2P_AUDIO_BLOCK_SECONDS * info->audio_samples_per_second;
+    envs = a2p_audio_envs_create(args->input, info, first,
+                                 info->num_audio_samples, args->envs, block,
+                                 args->audio_overlap, bits,
+                                 args->audio_dither);
+    
+    out = stdout;
+    writer = args->async ? a2p_create_writer(args, &out, 1, block * size) :
+                           NULL;
+    wrote = 0;
+    while(wrote < (uint64_t) info->num_audio_samples) {
+        buff = a2p_audio_envs_next(envs, &count);
+        if(writer != NULL) {
+            copy = a2p_writer_acquire(writer);
+            if(copy != NULL) {
+                memcpy(copy, buff, count * size);
+                a2p_writer_commit(writer, count * size);
+            }
+            step = copy != NULL ? count : 0;
+        } else {
+            step = fwrite(buff, size, count, stdout);
+        }
+        a2p_audio_envs_release(envs);
+        // fail early if there is a problem instead of end of input
+        if(step != count) break;
+        wrote += count;
+    }
+    if(writer != NULL) {
+        // only the last block is short
+        done = a2p_writer_destroy(writer) * block;
+        if(done < wrote) wrote = done;
+    }
+    a2p_audio_envs_destroy(envs);
+    
+    return wrote;
+}
+
+// samples are read into the writer ring while the writer thread, or
+// overlapped writes, empty it, so AviSynth never waits on the pipe,
+// float audio is converted to --audio-bits on the way into the ring,
+// with --envs blocks of samples are read by several environments
+void
+a2p_do_audio(AVS_ScriptEnvironment *env, AVS_Clip *clip, const A2pArgs *args)
+{
+    const AVS_VideoInfo *info;
+    AVS_VideoInfo written;
+    WaveRf64Header *header;
+    A2pWriter *writer;
+    A2pPcm pcm;
+    FILE *out;
+    void *buff;
+    float *samples;
+    size_t size, chunk, count;
+    uint64_t i, wrote, target;
+    
+    info = avs_get_video_info(clip);
+    
+    if(_setmode(_fileno(stdout), _O_BINARY) == -1) {
+        a2p_log(A2P_LOG_ERROR, "cannot switch stdout to binary mode.\n");
+    }
+    
+    // the header describes the samples as written
+    written = *info;
+    samples = NULL;
+    if(args->audio_bits > 0 && info->sample_type != AVS_SAMPLE_FLOAT) {
+        a2p_log(A2P_LOG_WARNING, "--audio-bits only converts float audio, "
+                "writing it unchanged.\n");
+    } else if(args->audio_bits > 0) {
+        written.sample_type = args->audio_bits == 16 ? AVS_SAMPLE_INT16 :
+                              AVS_SAMPLE_INT24;
+        a2p_pcm_init(&pcm, args->audio_bits, args->audio_dither);
+    }
+    header = a2p_audio_header(stdout, &written, args->rf64);
+    
+    target = info->num_audio_samples;
+    size = avs_bytes_per_channel_sample(&written) * info->nchannels;
+    if(args->envs > 0) {
+        wrote = a2p_audio_write_envs(info, args, written.sample_type !=
+                                     info->sample_type ? args->audio_bits : 0,
+                                     size);
+        a2p_audio_finish(stdout, header, wrote, args->rf64);
+        fflush(stdout);
+        a2p_audio_done(info, wrote, target);
+        return;
+    }
+    
+    chunk = a2p_audio_chunk(info, args);
+    a2p_log(A2P_LOG_INFO, "reading %u samples per buffer.\n",
+            (unsigned) chunk);
+    if(written.sample_type != info->sample_type) {
+        samples = malloc(chunk * info->nchannels * sizeof(*samples));
+        if(samples == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not allocate sample buffer.\n");
+        }
+    }
+    
+    out = stdout;
+    writer = a2p_create_writer(args, &out, 1, chunk * size);
+    count = chunk;
+    for(i = 0; i < target; i += count) {
+        if(target - i < count) count = (size_t) (target - i);
+        buff = a2p_writer_acquire(writer);
+        if(buff == NULL) break;
+        if(samples != NULL) {
+            avs_get_audio(clip, samples, i, count);
+            a2p_pcm_convert(&pcm, buff, samples, count * info->nchannels);
+        } else {
+            avs_get_audio(clip, buff, i, count);
+        }
+        a2p_writer_commit(writer, count * size);
+    }
+    // only the last buffer is short
+    wrote = a2p_writer_destroy(writer) * chunk;
+    if(wrote > target) wrote = target;
+    a2p_audio_finish(stdout, header, wrote, args->rf64);
+    fflush(stdout);
+    free(samples);
+    
+    a2p_audio_done(info, wrote, target);
+}
+
+static void
+a2p_close_outputs(FILE **outs, int outs_num)
+{
+    int i;
+    
+    for(i = 0; i < outs_num; i++) {
+        if(outs[i] == stdout) {
+            fflush(stdout);
+        } else {
+            fclose(outs[i]);
+        }
+    }
+}
+
+// logs the video and writes its y4m header to out, if any
+static void
+a2p_video_header(FILE *out, const AVS_VideoInfo *info,
+                 const A2pVideoFormat *format, const A2pVideoOptions *options)
+{
+    char header[A2P_Y4M_HEADER_MAX];
+    
+    a2p_log(A2P_LOG_INFO, "writing %d frames of %d/%d fps, %dx%d YUV%s %s video.\n",
+            info->num_frames, info->fps_numerator, info->fps_denominator,
+            info->width, info->height, format->yuv_csp, !avs_is_field_based(info) ?
+             "progressive" : !avs_is_bff(info) ? "tff" : "bff"); // default tff
+    
+    if(out == NULL) return;
+    a2p_video_y4m_header(header, info, format, options);
+    fputs(header, out);
+    fflush(out);
+}
+
+// opens every --rung with its y4m header, NULL when there are none
+static A2pLadder *
+a2p_open_ladder(const A2pArgs *args, const AVS_VideoInfo *info,
+                const A2pVideoFormat *format, FILE **files)
+{
+    A2pVideoFormat rungs[A2P_MAX_OUTPUTS];
+    AVS_VideoInfo rung_info;
+    int i;
+    
+    if(args->rungs == 0) return NULL;
+    if(args->video.output != A2P_OUTPUT_Y4M) {
+        a2p_log(A2P_LOG_ERROR, "--rung can not be used with --raw.\n");
+    }
+    if(avs_is_field_based(info)) {
+        a2p_log(A2P_LOG_WARNING, "--rung scales interlaced video as "
+                "progressive frames.\n");
+    }
+    
+    rung_info = *info;
+    for(i = 0; i < args->rungs; i++) {
+        a2p_video_rung(format, args->rung_width[i], args->rung_height[i],
+                       &rungs[i]);
+        files[i] = a2p_open_output(args->rung_out[i]);
+        rung_info.width = args->rung_width[i];
+        rung_info.height = args->rung_height[i];
+        a2p_video_header(files[i], &rung_info, &rungs[i], &args->video);
+    }
+    
+    return a2p_ladder_create(format, rungs, files, args->rungs, args->scaler,
+                             args->video.convert_threads, args->buffers);
+}
+
+void
+a2p_do_video(AVS_ScriptEnvironment *env, AVS_Clip *clip, const A2pArgs *args)
+{
+    const AVS_VideoInfo *info;
+    AVS_VideoFrame *frame;
+    A2pVideoFormat format;
+    A2pPrefetch *prefetch;
+    A2pSegments *segments;
+    A2pWriter *writer;
+    A2pIoVec *vec;
+    A2pLadder *ladder;
+    FILE *outs[A2P_MAX_OUTPUTS], *rung_files[A2P_MAX_OUTPUTS];
+    
+    BYTE *buff, *copy;
+    int32_t wrote; // frame loop count
+    uint64_t rung_wrote;
+    size_t step;
+    int outs_num, direct, i;
+    
+    clip = a2p_video_setup(env, clip, &args->video, &format);
+    info = avs_get_video_info(clip);
+    
+    outs_num = a2p_open_video_outputs(args, outs);
+    for(i = 0; i < outs_num; i++) {
+        a2p_video_header(outs[i], info, &format, &args->video);
+    }
+    ladder = a2p_open_ladder(args, info, &format, rung_files);
+    
+    direct = args->direct && format.pack == A2P_PACK_PLANAR &&
+             outs_num == 1 && ladder == NULL;
+    if(args->direct && !direct) {
+        a2p_log(A2P_LOG_WARNING, "--direct needs unconverted planar video "
+                "and one output, ignoring it.\n");
+    } else if(direct && (args->threads > 0 || args->envs > 0)) {
+        a2p_log(A2P_LOG_WARNING, "--direct writes from the rendering thread, "
+                "ignoring it with --threads and --envs.\n");
+        direct = 0;
+    }
+    
+    if(args->envs > 0 && args->threads > 0) {
+        a2p_log(A2P_LOG_WARNING, "--envs renders each environment on one "
+                "thread, ignoring --threads.\n");
+    }
+    
+    wrote = 0;
+    if(args->threads > 0 || args->envs > 0) {
+        // workers render ahead while this thread only writes, several
+        // outputs each get their own queue through a tee writer
+        prefetch = NULL;
+        segments = NULL;
+        if(args->envs > 0) {
+            // the environments load the untrimmed script, so they are
+            // given the frame numbers before --start was applied
+            segments = a2p_segments_create(args->input, &args->video, &format,
+                                           args->envs, args->chunk,
+                                           args->prefetch, args->start,
+                                           args->start + info->num_frames,
+                                           NULL, NULL, NULL);
+        } else {
+            prefetch = a2p_prefetch_create(env, clip, &format, args->threads,
+                                           args->prefetch, 0, info->num_frames);
+        }
+        writer = outs_num > 1 || args->async ?
+                 a2p_create_writer(args, outs, outs_num, format.size) : NULL;
+        while(wrote < info->num_frames) {
+            buff = segments != NULL ? a2p_segments_next(segments) :
+                                      a2p_prefetch_next(prefetch);
+            if(writer != NULL) {
+                copy = a2p_writer_acquire(writer);
+                if(copy != NULL) {
+                    memcpy(copy, buff, format.size);
+                    a2p_writer_commit(writer, format.size);
+                }
+                step = copy != NULL ? format.size : 0;
+            } else {
+                step = fwrite(buff, sizeof(BYTE), format.size, outs[0]);
+            }
+            // the rungs are scaled while the writers drain the base frame
+            if(ladder != NULL && !a2p_ladder_write(ladder, buff)) step = 0;
+            if(segments != NULL) {
+                a2p_segments_release(segments);
+            } else {
+                a2p_prefetch_release(prefetch);
+            }
+            // fail early if there is a problem instead of end of input
+            if(step != format.size) break;
+            wrote++;
+        }
+        if(segments != NULL) {
+            a2p_segments_destroy(segments);
+        } else {
+            a2p_prefetch_destroy(prefetch);
+        }
+        if(writer != NULL) wrote = (int32_t) a2p_writer_destroy(writer);
+    } else if(direct) {
+        // skip the packing copy, each frame is written from its own rows
+        vec = malloc(format.segments * sizeof(*vec));
+        copy = malloc(A2P_GATHER_CHUNK);
+        if(vec == NULL || copy == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not allocate frame segments.\n");
+        }
+        while(wrote < info->num_frames) {
+            frame = avs_get_frame(clip, wrote);
+            step = a2p_write_gather(_fileno(outs[0]), vec,
+                                    a2p_video_gather(&format, frame, vec),
+                                    copy);
+            avs_release_frame(frame);
+            // fail early if there is a problem instead of end of input
+            if(step != format.size) break;
+            wrote++;
+        }
+        free(copy);
+        free(vec);
+    } else if(args->buffers > 1 || outs_num > 1 || args->async) {
+        // writer threads drain frame n while frame n + 1 renders here
+        writer = a2p_create_writer(args, outs, outs_num, format.size);
+        while(wrote < info->num_frames) {
+            buff = a2p_writer_acquire(writer);
+            if(buff == NULL) break;
+            frame = avs_get_frame(clip, wrote);
+            a2p_video_pack(env, &format, frame, buff);
+            avs_release_frame(frame);
+            a2p_writer_commit(writer, format.size);
+            // buff is only reused after the next acquire, so reading it
+            // here races nothing
+            if(ladder != NULL && !a2p_ladder_write(ladder, buff)) break;
+            wrote++;
+        }
+        wrote = (int32_t) a2p_writer_destroy(writer);
+    } else {
+        buff = a2p_video_alloc(&format);
+        while(wrote < info->num_frames) {
+            frame = avs_get_frame(clip, wrote);
+            a2p_video_pack(env, &format, frame, buff);
+            step = fwrite(buff, sizeof(BYTE), format.size, outs[0]);
+            avs_release_frame(frame);
+            if(ladder != NULL && !a2p_ladder_write(ladder, buff)) step = 0;
+            // fail early if there is a problem instead of end of input
+            if(step != format.size) break;
+            wrote++;
+        }
+        free(buff);
+    }
+    if(ladder != NULL) {
+        rung_wrote = a2p_ladder_destroy(ladder);
+        if(rung_wrote < (uint64_t) wrote) wrote = (int32_t) rung_wrote;
+        a2p_close_outputs(rung_files, args->rungs);
+    }
+    a2p_close_outputs(outs, outs_num);
+    a2p_video_close(&format);
+    
+    if(wrote != info->num_frames) {
+        a2p_log(A2P_LOG_ERROR, "failed, only wrote %d of %d frames.\n",
+                wrote, info->num_frames);
+    } else {
+        a2p_log(A2P_LOG_INFO, "finished, wrote %d frames [%d%%].\n", 
+                wrote, (100 * wrote) / info->num_frames);
+    }
+}
+
+// every range the environments render goes to its own file, named after
+// its first frame so that the files sort into frame order
+void
+a2p_do_segments(AVS_ScriptEnvironment *env, AVS_Clip *clip, const A2pArgs *args)
+{
+    const AVS_VideoInfo *info;
+    A2pVideoFormat format;
+    A2pSegments *segments;
+    char header[A2P_Y4M_HEADER_MAX];
+    int envs, wrote;
+    
+    clip = a2p_video_setup(env, clip, &args->video, &format);
+    info = avs_get_video_info(clip);
+    
+    a2p_video_header(NULL, info, &format, &args->video);
+    a2p_video_y4m_header(header, info, &format, &args->video);
+    if(args->video_outs > 0 || args->rungs > 0 || args->map_out != NULL) {
+        a2p_log(A2P_LOG_WARNING, "--segment-out writes only segment files, "
+                "ignoring --video-out, --rung and --map-out.\n");
+    }
+    
+    envs = args->envs > 0 ? args->envs : a2p_cpu_count();
+    segments = a2p_segments_create(args->input, &args->video, &format, envs,
+                                   args->chunk, 0, args->start,
+                                   args->start + info->num_frames,
+                                   args->segment_out, NULL, header);
+    wrote = a2p_segments_wait(segments);
+    a2p_segments_destroy(segments);
+    a2p_video_close(&format);
+    
+    if(wrote != info->num_frames) {
+        a2p_log(A2P_LOG_ERROR, "failed, only wrote %d of %d frames.\n",
+                wrote, info->num_frames);
+    } else {
+        a2p_log(A2P_LOG_INFO, "finished, wrote %d frames [%d%%].\n", 
+                wrote, (100 * wrote) / info->num_frames);
+    }
+}
+
+typedef struct A2pMapJob A2pMapJob;
+
+// one render written straight into a mapped file by a pool of threads
+struct A2pMapJob {
+    AVS_ScriptEnvironment  *env;
+    AVS_Clip               *clip;
+    const A2pVideoFormat   *format;
+    A2pMapFile             *map;
+    uint64_t                offset;     // where the frames or samples start
+    uint64_t                samples;    // audio samples in the clip
+    size_t                  count;      // audio samples per job
+    size_t                  size;       // bytes per audio sample
+};
+
+static void
+a2p_map_header(A2pMapFile *map, const void *header, size_t size)
+{
+    void *view;
+    
+    if(size == 0) return;
+    view = a2p_map_view(map, 0, size);
+    memcpy(view, header, size);
+    a2p_map_unview(map, view, 0);
+}
+
+static void
+a2p_map_frame(void *data, int n)
+{
+    A2pMapJob *job = data;
+    AVS_VideoFrame *frame;
+    uint64_t offset;
+    void *view;
+    
+    offset = job->offset + (uint64_t) n * job->format->size;
+    view = a2p_map_view(job->map, offset, job->format->size);
+    frame = avs_get_frame(job->clip, n);
+    a2p_video_pack(job->env, job->format, frame, view);
+    avs_release_frame(frame);
+    a2p_map_unview(job->map, view, offset);
+}
+
+static void
+a2p_map_samples(void *data, int n)
+{
+    A2pMapJob *job = data;
+    uint64_t start, offset;
+    size_t count;
+    void *view;
+    
+    start = (uint64_t) n * job->count;
+    count = job->samples - start < job->count ?
+            (size_t) (job->samples - start) : job->count;
+    offset = job->offset + start * job->size;
+    view = a2p_map_view(job->map, offset, count * job->size);
+    avs_get_audio(job->clip, view, start, count);
+    a2p_map_unview(job->map, view, offset);
+}
+
+// every frame has the same size and so a known place in the file, the
+// file is made at its final size and the frames are packed straight into
+// it in whatever order they finish, with no reorder buffer or pipe
+void
+a2p_do_video_map(AVS_ScriptEnvironment *env, AVS_Clip *clip,
+                 const A2pArgs *args)
+{
+    const AVS_VideoInfo *info;
+    A2pVideoFormat format;
+    A2pSegments *segments;
+    A2pPool *pool;
+    A2pMapJob job;
+    char header[A2P_Y4M_HEADER_MAX];
+    int wrote;
+    
+    clip = a2p_video_setup(env, clip, &args->video, &format);
+    info = avs_get_video_info(clip);
+    
+    a2p_video_header(NULL, info, &format, &args->video);
+    a2p_video_y4m_header(header, info, &format, &args->video);
+    if(args->video_outs > 0 || args->rungs > 0 || args->direct) {
+        a2p_log(A2P_LOG_WARNING, "--map-out writes only the mapped file, "
+                "ignoring --video-out, --rung and --direct.\n");
+    }
+    
+    job.map = a2p_map_create(args->map_out, strlen(header) +
+                             (uint64_t) info->num_frames * format.size);
+    if(args->envs > 0) {
+        segments = a2p_segments_create(args->input, &args->video, &format,
+                                       args->envs, args->chunk, 0,
+                                       args->start,
+                                       args->start + info->num_frames,
+                                       NULL, job.map, header);
+        wrote = a2p_segments_wait(segments);
+        a2p_segments_destroy(segments);
+    } else {
+        // several threads rendering one clip need MT AviSynth, as --threads
+        a2p_map_header(job.map, header, strlen(header));
+        job.env = env;
+        job.clip = clip;
+        job.format = &format;
+        job.offset = strlen(header);
+        pool = a2p_pool_create(args->threads > 0 ? args->threads : 1);
+        a2p_pool_run(pool, a2p_map_frame, &job, info->num_frames);
+        a2p_pool_destroy(pool);
+        wrote = info->num_frames;
+    }
+    a2p_map_destroy(job.map);
+    a2p_video_close(&format);
+    
+    if(wrote != info->num_frames) {
+        a2p_log(A2P_LOG_ERROR, "failed, only wrote %d of %d frames.\n",
+                wrote, info->num_frames);
+    } else {
+        a2p_log(A2P_LOG_INFO, "finished, wrote %d frames [%d%%].\n", 
+                wrote, (100 * wrote) / info->num_frames);
+    }
+}
+
+// the wav data has a known size too, each second of samples is read
+// straight into its place in the mapped file
+void
+a2p_do_audio_map(AVS_ScriptEnvironment *env, AVS_Clip *clip,
+                 const A2pArgs *args)
+{
+    const AVS_VideoInfo *info;
+    void *header;
+    size_t header_size;
+    A2pPool *pool;
+    A2pMapJob job;
+    
+    info = avs_get_video_info(clip);
+    header = a2p_wave_header(info, args->rf64, &header_size);
+    
+    job.env = env;
+    job.clip = clip;
+    job.offset = header_size;
+    job.samples = info->num_audio_samples;
+    job.count = info->audio_samples_per_second;
+    job.size = avs_bytes_per_channel_sample(info) * info->nchannels;
+    job.map = a2p_map_create(args->map_out, job.offset + job.samples *
+                                            job.size);
+    a2p_map_header(job.map, header, header_size);
+    free(header);
+    
+    pool = a2p_pool_create(args->threads > 0 ? args->threads : 1);
+    a2p_pool_run(pool, a2p_map_samples, &job,
+                 (int) ((job.samples + job.count - 1) / job.count));
+    a2p_pool_destroy(pool);
+    a2p_map_destroy(job.map);
+    
+    a2p_log(A2P_LOG_INFO, "finished, wrote %I64u seconds [100%%].\n",
+            job.samples / info->audio_samples_per_second);
+}
+
+typedef struct A2pRender A2pRender;
+
+// frames for the ring and network outputs, rendered ahead by --threads or
+// --envs, otherwise packed here into the buffer the caller passes
+struct A2pRender {
+    AVS_ScriptEnvironment  *env;
+    AVS_Clip               *clip;
+    const A2pVideoFormat   *format;
+    A2pPrefetch            *prefetch;
+    A2pSegments            *segments;
+    int                     next;       // frame packed inline
+};
+
+static void
+a2p_render_open(A2pRender *render, AVS_ScriptEnvironment *env,
+                AVS_Clip *clip, const A2pVideoFormat *format,
+                const A2pArgs *args)
+{
+    const AVS_VideoInfo *info;
+    
+    info = avs_get_video_info(clip);
+    render->env = env;
+    render->clip = clip;
+    render->format = format;
+    render->prefetch = NULL;
+    render->segments = NULL;
+    render->next = 0;
+    if(args->envs > 0) {
+        render->segments = a2p_segments_create(args->input, &args->video,
+                                               format, args->envs,
+                                               args->chunk, args->prefetch,
+                                               args->start, args->start +
+                                               info->num_frames, NULL, NULL,
+                                               NULL);
+    } else if(args->threads > 0) {
+        render->prefetch = a2p_prefetch_create(env, clip, format,
+                                               args->threads, args->prefetch,
+                                               0, info->num_frames);
+    }
+}
+
+// the next frame, in buff unless it was rendered ahead
+static BYTE *
+a2p_render_next(A2pRender *render, BYTE *buff)
+{
+    AVS_VideoFrame *frame;
+    
+    if(render->segments != NULL) return a2p_segments_next(render->segments);
+    if(render->prefetch != NULL) return a2p_prefetch_next(render->prefetch);
+    
+    frame = avs_get_frame(render->clip, render->next++);
+    a2p_video_pack(render->env, render->format, frame, buff);
+    avs_release_frame(frame);
+    
+    return buff;
+}
+
+static void
+a2p_render_release(A2pRender *render)
+{
+    if(render->segments != NULL) a2p_segments_release(render->segments);
+    if(render->prefetch != NULL) a2p_prefetch_release(render->prefetch);
+}
+
+static void
+a2p_render_close(A2pRender *render)
+{
+    if(render->segments != NULL) a2p_segments_destroy(render->segments);
+    if(render->prefetch != NULL) a2p_prefetch_destroy(render->prefetch);
+}
+
+// frames are packed straight into the slots of a shared memory ring for
+// an encoder on the same machine, the reader gives each slot back once it
+// has the frame, so --buffers slots are in flight
+void
+a2p_do_video_ring(AVS_ScriptEnvironment *env, AVS_Clip *clip,
+                  const A2pArgs *args)
+{
+    const AVS_VideoInfo *info;
+    A2pVideoFormat format;
+    A2pRender render;
+    A2pRingHeader header;
+    A2pRing *ring;
+    BYTE *buff, *slot;
+    int32_t wrote;
+    int p;
+    
+    clip = a2p_video_setup(env, clip, &args->video, &format);
+    info = avs_get_video_info(clip);
+    
+    a2p_video_header(NULL, info, &format, &args->video);
+    if(args->video_outs > 0 || args->rungs > 0 || args->direct ||
+       args->async) {
+        a2p_log(A2P_LOG_WARNING, "--ring writes only to the ring, ignoring "
+                "--video-out, --rung, --direct and --async.\n");
+    }
+    
+    memset(&header, 0, sizeof(header));
+    header.slots = args->buffers;
+    header.frame_size = format.size;
+    header.slot_size = (format.size + A2P_RING_ALIGN - 1) &
+                       ~(A2P_RING_ALIGN - 1);
+    header.frames = info->num_frames;
+    header.width = info->width;
+    header.height = info->height;
+    header.fps_numerator = info->fps_numerator;
+    header.fps_denominator = info->fps_denominator;
+    header.sample_size = format.sample_size;
+    header.depth = format.depth;
+    header.planes_num = format.planes_num;
+    for(p = 0; p < format.planes_num; p++) {
+        header.plane_offset[p] = format.offset[p];
+        header.plane_pitch[p] = format.width[p];
+        header.plane_height[p] = format.height[p];
+    }
+    a2p_video_y4m_header(header.stream, info, &format, &args->video);
+    ring = a2p_ring_create(args->ring, &header);
+    
+    a2p_render_open(&render, env, clip, &format, args);
+    wrote = 0;
+    while(wrote < info->num_frames) {
+        slot = a2p_ring_acquire(ring);
+        if(slot == NULL) break;
+        buff = a2p_render_next(&render, slot);
+        if(buff != slot) memcpy(slot, buff, format.size);
+        a2p_render_release(&render);
+        a2p_ring_commit(ring);
+        wrote++;
+    }
+    a2p_render_close(&render);
+    a2p_ring_close(ring);
+    a2p_video_close(&format);
+    
+    if(wrote != info->num_frames) {
+        a2p_log(A2P_LOG_ERROR, "failed, the reader left after %d of %d "
+                "frames.\n", wrote, info->num_frames);
+    } else {
+        a2p_log(A2P_LOG_INFO, "finished, wrote %d frames [%d%%].\n", 
+                wrote, (100 * wrote) / info->num_frames);
+    }
+}
+
+// reference reader, turns a ring back into the stream avs2pipe video
+// would have written
+void
+a2p_do_ringcat(const char *name, const A2pArgs *args)
+{
+    const A2pRingHeader *header;
+    const void *slot;
+    A2pRing *ring;
+    FILE *out;
+    int32_t wrote, frames;
+    size_t step;
+    
+    ring = a2p_ring_open(name, 10000);
+    header = a2p_ring_header(ring);
+    out = a2p_open_output(args->video_outs > 0 ? args->video_out[0] : NULL);
+    a2p_log(A2P_LOG_INFO, "reading %d frames of %u/%u fps, %dx%d video.\n",
+            header->frames, header->fps_numerator, header->fps_denominator,
+            header->width, header->height);
+    fputs(header->stream, out);
+    
+    wrote = 0;
+    while((slot = a2p_ring_next(ring)) != NULL) {
+        step = fwrite(slot, sizeof(BYTE), header->frame_size, out);
+        a2p_ring_release(ring);
+        // fail early if there is a problem instead of end of input
+        if(step != header->frame_size) break;
+        wrote++;
+    }
+    fflush(out);
+    if(out != stdout) fclose(out);
+    // the writer is told the reader has gone before the header goes
+    frames = header->frames;
+    a2p_ring_close(ring);
+    
+    if(wrote != frames) {
+        a2p_log(A2P_LOG_ERROR, "failed, only read %d of %d frames.\n",
+                wrote, frames);
+    } else {
+        a2p_log(A2P_LOG_INFO, "finished, read %d frames [%d%%].\n",
+                wrote, (100 * wrote) / frames);
+    }
+}
+
+// each plane is a packet of its own, compressed here while the writer
+// thread sends the frame before it
+void
+a2p_do_video_net(AVS_ScriptEnvironment *env, AVS_Clip *clip,
+                 const A2pArgs *args)
+{
+    const AVS_VideoInfo *info;
+    A2pVideoFormat format;
+    A2pRender render;
+    A2pWriter *writer;
+    A2pNet *net;
+    char header[A2P_Y4M_HEADER_MAX];
+    size_t bounds[A2P_MAX_PLANES + 1];
+    uint32_t *table;
+    BYTE *buff, *planes, *packets;
+    size_t size;
+    int32_t wrote;
+    int p;
+    
+    clip = a2p_video_setup(env, clip, &args->video, &format);
+    info = avs_get_video_info(clip);
+    
+    a2p_video_header(NULL, info, &format, &args->video);
+    a2p_video_y4m_header(header, info, &format, &args->video);
+    if(args->video_outs > 0 || args->rungs > 0 || args->direct ||
+       args->async) {
+        a2p_log(A2P_LOG_WARNING, "--serve writes only to the client, ignoring "
+                "--video-out, --rung, --direct and --async.\n");
+    }
+    
+    // one packet per written plane, raw outputs describe only the planes
+    // they pack, the first plane takes the FRAME header with it
+    size = 0;
+    for(p = 0; p < format.planes_num; p++) {
+        bounds[p] = p == 0 ? 0 : format.offset[p];
+    }
+    bounds[format.planes_num] = format.size;
+    for(p = 0; p < format.planes_num; p++) {
+        if(bounds[p + 1] < bounds[p]) {
+            a2p_log(A2P_LOG_ERROR, "plane %d of the frame layout starts "
+                    "after the next one.\n", p);
+        }
+        size += a2p_net_bound(bounds[p + 1] - bounds[p]);
+    }
+    table = malloc(A2P_LZ4_TABLE * sizeof(*table));
+    buff = a2p_video_alloc(&format);
+    if(table == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate compression table.\n");
+    }
+    
+    net = a2p_net_serve(args->serve);
+    if(!a2p_net_start(net, header, strlen(header))) {
+        a2p_log(A2P_LOG_ERROR, "the client left before the first frame.\n");
+    }
+    writer = a2p_writer_create_net(net, size, args->buffers);
+    a2p_render_open(&render, env, clip, &format, args);
+    wrote = 0;
+    while(wrote < info->num_frames) {
+        packets = a2p_writer_acquire(writer);
+        if(packets == NULL) break;
+        planes = a2p_render_next(&render, buff);
+        size = 0;
+        for(p = 0; p < format.planes_num; p++) {
+            size += a2p_net_pack(packets + size, planes + bounds[p],
+                                 bounds[p + 1] - bounds[p], args->lz4, table);
+        }
+        a2p_render_release(&render);
+        a2p_writer_commit(writer, size);
+        wrote++;
+    }
+    a2p_render_close(&render);
+    wrote = (int32_t) a2p_writer_destroy(writer);
+    if(wrote == info->num_frames && !a2p_net_finish(net)) wrote = 0;
+    a2p_net_close(net);
+    free(buff);
+    free(table);
+    a2p_video_close(&format);
+    
+    if(wrote != info->num_frames) {
+        a2p_log(A2P_LOG_ERROR, "failed, only sent %d of %d frames.\n",
+                wrote, info->num_frames);
+    } else {
+        a2p_log(A2P_LOG_INFO, "finished, sent %d frames [%d%%].\n", 
+                wrote, (100 * wrote) / info->num_frames);
+    }
+}
+
+// a second of samples per packet
+void
+a2p_do_audio_net(AVS_ScriptEnvironment *env, AVS_Clip *clip,
+                 const A2pArgs *args)
 {
-    AVS_Value val_array, val_return;
-    AVS_Clip *clip;
+    const AVS_VideoInfo *info;
+    void *header;
+    A2pWriter *writer;
+    A2pNet *net;
+    uint32_t *table;
+    BYTE *buff, *packet;
+    size_t size, count, header_size;
+    uint64_t i, sent, target;
     
-    val_array = avs_new_value_array(arg, 1);
-    val_return = avs_invoke(env, name, val_array, 0);
+    info = avs_get_video_info(clip);
+    header = a2p_wave_header(info, args->rf64, &header_size);
     
-    if(avs_is_error(val_return)) {
-        a2p_log(A2P_LOG_ERROR, "%s\n", avs_as_string(val_return));
-    } else if(!avs_is_clip(val_return)) {
-        a2p_log(A2P_LOG_ERROR, "%s return value is not a clip.\n", name);
+    count = info->audio_samples_per_second;
+    target = info->num_audio_samples;
+    size = avs_bytes_per_channel_sample(info) * info->nchannels;
+    table = malloc(A2P_LZ4_TABLE * sizeof(*table));
+    buff = malloc(count * size);
+    if(table == NULL || buff == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate sample buffer.\n");
     }
     
-    clip = avs_take_clip(val_return, env);
-    
-    avs_release_value(val_array);
-    avs_release_value(val_return);
+    net = a2p_net_serve(args->serve);
+    if(!a2p_net_start(net, header, header_size)) {
+        a2p_log(A2P_LOG_ERROR, "the client left before the first sample.\n");
+    }
+    free(header);
+    writer = a2p_writer_create_net(net, a2p_net_bound(count * size),
+                                   args->buffers);
+    for(i = 0; i < target; i += count) {
+        if(target - i < count) count = (size_t) (target - i);
+        packet = a2p_writer_acquire(writer);
+        if(packet == NULL) break;
+        avs_get_audio(clip, buff, i, count);
+        a2p_writer_commit(writer, a2p_net_pack(packet, buff, count * size,
+                                               args->lz4, table));
+    }
+    sent = a2p_writer_destroy(writer) * info->audio_samples_per_second;
+    if(sent > target) sent = target;
+    if(sent == target && !a2p_net_finish(net)) sent = 0;
+    a2p_net_close(net);
+    free(buff);
+    free(table);
     
-    return clip;
+    if(sent != target) {
+        a2p_log(A2P_LOG_ERROR, "only sent %I64u of %I64u samples.\n",
+                sent, target);
+    } else {
+        a2p_log(A2P_LOG_INFO, "finished, sent %I64u seconds [100%%].\n",
+                sent / info->audio_samples_per_second);
+    }
 }
 
-AVS_Clip *
-a2p_avs_filter(AVS_ScriptEnvironment *env, const char *filter, AVS_Clip *clip)
+// loopback client, writes the stream a --serve server sends as avs2pipe
+// video or audio would have, checking every packet on the way
+void
+a2p_do_fetch(const char *address, const A2pArgs *args)
 {
-    AVS_Value val_clip;
+    A2pNetHello hello;
+    A2pNetPacket packet;
+    A2pNet *net;
+    FILE *out;
+    BYTE *data, *payload;
+    size_t data_size, payload_size;
+    uint64_t packets, received;
     
-    val_clip = avs_new_value_clip(clip);
-    avs_release_clip(clip);
-    
-    clip = a2p_avs_invoke(env, filter, &val_clip);
+    net = a2p_net_connect(address);
+    if(!a2p_net_recv(net, &hello, sizeof(hello)) ||
+       hello.magic != A2P_NET_MAGIC) {
+        a2p_log(A2P_LOG_ERROR, "%s is not an avs2pipe server.\n", address);
+    }
+    if(hello.version != A2P_NET_VERSION) {
+        a2p_log(A2P_LOG_ERROR, "%s speaks version %u, not %u.\n", address,
+                hello.version, A2P_NET_VERSION);
+    }
+    out = a2p_open_output(args->video_outs > 0 ? args->video_out[0] : NULL);
     
-    avs_release_value(val_clip);
+    data = NULL;
+    payload = NULL;
+    data_size = 0;
+    payload_size = 0;
+    packets = 0;
+    received = 0;
+    for(;;) {
+        if(!a2p_net_recv(net, &packet, sizeof(packet))) {
+            a2p_log(A2P_LOG_ERROR, "connection lost after %I64u bytes.\n",
+                    received);
+        }
+        // the first packet is the stream header, which raw video leaves
+        // empty, any other empty packet ends the stream
+        if(packet.size == 0 && packets > 0) break;
+        if(packet.size > data_size) {
+            data_size = packet.size;
+            data = realloc(data, data_size);
+        }
+        if(packet.packed > payload_size) {
+            payload_size = packet.packed;
+            payload = realloc(payload, payload_size);
+        }
+        if((data == NULL && data_size > 0) ||
+           (payload == NULL && payload_size > 0)) {
+            a2p_log(A2P_LOG_ERROR, "could not allocate packet buffer.\n");
+        }
+        if(!a2p_net_recv(net, payload, packet.packed)) {
+            a2p_log(A2P_LOG_ERROR, "connection lost after %I64u bytes.\n",
+                    received);
+        }
+        if(!a2p_net_unpack(data, &packet, payload)) {
+            a2p_log(A2P_LOG_ERROR, "packet %I64u is corrupt.\n", packets);
+        }
+        if(fwrite(data, sizeof(BYTE), packet.size, out) != packet.size) {
+            a2p_log(A2P_LOG_ERROR, "failed after %I64u bytes.\n", received);
+        }
+        packets++;
+        received += packet.size;
+    }
+    fflush(out);
+    if(out != stdout) fclose(out);
+    a2p_net_close(net);
+    free(payload);
+    free(data);
     
-    return clip;
+    a2p_log(A2P_LOG_INFO, "finished, received %I64u bytes in %I64u "
+            "packets.\n", received, packets);
 }
 
-AVS_Clip *
-a2p_avs_source(AVS_ScriptEnvironment *env, char *file)
+// chunks of frames rendered by worker processes, written in order or
+// each to its own --segment-out file
+void
+a2p_do_video_coord(AVS_ScriptEnvironment *env, AVS_Clip *clip,
+                   const A2pArgs *args)
 {
-    AVS_Clip *clip;
-    AVS_Value val_string;
-    char *ext, *import;
+    const AVS_VideoInfo *info;
+    A2pVideoFormat format;
+    A2pCoordTask task;
+    char header[A2P_Y4M_HEADER_MAX];
+    int64_t wrote;
     
-    import = "Import";
-    ext = strrchr(file, '.');
-    if(!strcmp(ext, ".avsg")) {
-        if(avs_function_exists(env, "GImport")) {
-            a2p_log(A2P_LOG_INFO, "Enabling GScript support for GImport.\n");
-            import = "GImport";
-        } else {
-            a2p_log(A2P_LOG_WARNING, "GScript support missing, trying standard Import.\n");
-        }
-    }
+    clip = a2p_video_setup(env, clip, &args->video, &format);
+    info = avs_get_video_info(clip);
     
-    val_string = avs_new_value_string(file);
+    a2p_video_header(NULL, info, &format, &args->video);
+    a2p_video_y4m_header(header, info, &format, &args->video);
+    if(args->video_outs > 1 || args->rungs > 0 || args->map_out != NULL ||
+       args->threads > 0 || args->envs > 0) {
+        a2p_log(A2P_LOG_WARNING, "--coordinate writes the first output only, "
+                "ignoring --rung, --map-out, --threads and --envs.\n");
+    }
     
-    clip = a2p_avs_invoke(env, import, &val_string);
+    memset(&task, 0, sizeof(task));
+    task.address = args->coordinate;
+    task.script = args->input;
+    task.op = A2P_COORD_VIDEO;
+    task.options = &args->video;
+    task.start = args->start;
+    task.count = info->num_frames;
+    task.unit = 1;
+    task.size = format.size;
+    task.chunk = args->chunk > 0 ? args->chunk : A2P_COORD_CHUNK;
+    task.spawn = args->spawn;
+    task.lz4 = args->lz4;
+    task.header = header;
+    task.header_size = strlen(header);
+    if(args->segment_out != NULL) {
+        task.pattern = args->segment_out;
+    } else {
+        task.out = a2p_open_output(args->video_outs > 0 ? args->video_out[0] :
+                                   NULL);
+    }
+    wrote = a2p_coord_run(&task);
+    if(task.out != NULL && task.out != stdout) fclose(task.out);
+    a2p_video_close(&format);
     
-    avs_release_value(val_string);
+    if(wrote != info->num_frames) {
+        a2p_log(A2P_LOG_ERROR, "failed, only wrote %I64d of %d frames.\n",
+                wrote, info->num_frames);
+    } else {
+        a2p_log(A2P_LOG_INFO, "finished, wrote %I64d frames [100%%].\n",
+                wrote);
+    }
+}
+
+typedef struct A2pCoordWave A2pCoordWave;
+
+// what the wav header of each --segment-out file is made from
+struct A2pCoordWave {
+    const AVS_VideoInfo    *info;
+    WaveFormatType          format;
+    int                     rf64;
+};
+
+static void *
+a2p_coord_wave_header(void *data, int64_t count, size_t *size)
+{
+    const A2pCoordWave *wave = data;
     
-    return clip;
+    return a2p_wave_create(wave->format, wave->info, count, wave->rf64, size);
 }
 
+// seconds of samples rendered by worker processes, cut at the frames
+// like a2p_avs_trim, each --segment-out file gets a header of its own
 void
-a2p_do_audio(AVS_ScriptEnvironment *env, AVS_Clip *clip)
+a2p_do_audio_coord(AVS_ScriptEnvironment *env, AVS_Clip *clip,
+                   const A2pArgs *args)
 {
     const AVS_VideoInfo *info;
-    WaveRiffHeader *header;
-    WaveFormatType format;
-    void *buff;
-    size_t size, count, step;
-    uint64_t i, wrote, target;
+    void *header;
+    A2pCoordTask task;
+    A2pCoordWave wave;
+    int64_t wrote;
     
     info = avs_get_video_info(clip);
+    memset(&task, 0, sizeof(task));
+    task.address = args->coordinate;
+    task.script = args->input;
+    task.op = A2P_COORD_AUDIO;
+    task.options = &args->video;
+    if(args->start > 0) {
+        task.start = (int64_t) args->start * info->audio_samples_per_second *
+                     info->fps_denominator / info->fps_numerator;
+    }
+    task.count = info->num_audio_samples;
+    task.unit = info->audio_samples_per_second;
+    task.size = avs_bytes_per_channel_sample(info) * info->nchannels;
+    task.chunk = args->chunk > 0 ? args->chunk : A2P_COORD_CHUNK;
+    task.spawn = args->spawn;
+    task.lz4 = args->lz4;
+    header = NULL;
+    if(args->segment_out != NULL) {
+        wave.info = info;
+        wave.format = a2p_wave_format(info);
+        wave.rf64 = args->rf64;
+        task.pattern = args->segment_out;
+        task.file_header = a2p_coord_wave_header;
+        task.file_header_data = &wave;
+    } else {
+        header = a2p_wave_header(info, args->rf64, &task.header_size);
+        task.header = header;
+        task.out = a2p_open_output(NULL);
+    }
+    wrote = a2p_coord_run(&task);
+    free(header);
     
-    if(!avs_has_audio(info)) {
-        a2p_log(A2P_LOG_ERROR, "source has no audio.\n");
+    if(wrote != info->num_audio_samples) {
+        a2p_log(A2P_LOG_ERROR, "only wrote %I64d of %I64d samples.\n",
+                wrote, info->num_audio_samples);
+    } else {
+        a2p_log(A2P_LOG_INFO, "finished, wrote %I64d seconds [100%%].\n",
+                wrote / info->audio_samples_per_second);
+    }
+}
+
+// the script is loaded by a running daemon, which keeps it loaded for
+// the next request, --start and --frames pick the frames asked for
+void
+a2p_do_daemon_video(const char *script, const A2pArgs *args)
+{
+    A2pDaemonInfo info;
+    A2pDaemon *daemon;
+    FILE *out;
+    BYTE *buff;
+    int32_t start, frames, wrote;
+    
+    daemon = a2p_daemon_connect(args->daemon, script, args->lz4);
+    a2p_daemon_info(daemon, &info);
+    if(!avs_has_video(&info.source)) {
+        a2p_log(A2P_LOG_ERROR, "source has no video.\n");
+    }
+    start = args->start;
+    frames = args->frames;
+    if(start >= info.source.num_frames) {
+        a2p_log(A2P_LOG_ERROR, "--start %d is past the last frame %d.\n",
+                start, info.source.num_frames - 1);
     }
+    if(frames == 0 || frames > info.source.num_frames - start) {
+        frames = info.source.num_frames - start;
+    }
+    a2p_log(A2P_LOG_INFO, "fetching frames %d to %d from the daemon.\n",
+            start, start + frames - 1);
     
-    // AviSynth only supports AVS_SAMPLE_FLOAT & AVS_SAMPLE_INT*
-    switch(info->sample_type) {
-        case AVS_SAMPLE_FLOAT:
-            format = WAVE_FORMAT_IEEE_FLOAT;
-            break;
-        default:
-            a2p_log(A2P_LOG_WARNING, "audio format unknown trying PCM.\n");
-        case AVS_SAMPLE_INT8:
-        case AVS_SAMPLE_INT16:
-        case AVS_SAMPLE_INT24:
-        case AVS_SAMPLE_INT32:
-            format = WAVE_FORMAT_PCM;
+    out = a2p_open_output(args->video_outs > 0 ? args->video_out[0] : NULL);
+    fputs(info.stream, out);
+    buff = malloc(info.frame_size);
+    if(buff == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate frame buffer.\n");
+    }
+    for(wrote = 0; wrote < frames; wrote++) {
+        a2p_daemon_frame(daemon, start + wrote, buff, info.frame_size);
+        // fail early if there is a problem instead of end of input
+        if(fwrite(buff, sizeof(BYTE), info.frame_size, out) !=
+           info.frame_size) {
             break;
+        }
+    }
+    fflush(out);
+    if(out != stdout) fclose(out);
+    free(buff);
+    a2p_daemon_close(daemon);
+    
+    if(wrote != frames) {
+        a2p_log(A2P_LOG_ERROR, "failed, only wrote %d of %d frames.\n",
+                wrote, frames);
+    } else {
+        a2p_log(A2P_LOG_INFO, "finished, wrote %d frames [%d%%].\n", 
+                wrote, (100 * wrote) / frames);
     }
+}
+
+// a second of samples per request, cut at the frames like a2p_avs_trim
+void
+a2p_do_daemon_audio(const char *script, const A2pArgs *args)
+{
+    A2pDaemonInfo info;
+    A2pDaemon *daemon;
+    WaveRf64Header *header;
+    void *buff;
+    size_t size, count;
+    int64_t first, last;
+    uint64_t i, wrote, target;
+    int end;
     
+    daemon = a2p_daemon_connect(args->daemon, script, args->lz4);
+    a2p_daemon_info(daemon, &info);
+    first = 0;
+    last = info.source.num_audio_samples;
+    if(args->start > 0 || args->frames > 0) {
+        if(!avs_has_video(&info.source)) {
+            a2p_log(A2P_LOG_ERROR, "frame ranges need a clip with video.\n");
+        }
+        end = args->frames > 0 ? args->start + args->frames :
+                                 info.source.num_frames;
+        first = (int64_t) args->start * info.source.audio_samples_per_second *
+                info.source.fps_denominator / info.source.fps_numerator;
+        if(end < info.source.num_frames) {
+            last = (int64_t) end * info.source.audio_samples_per_second *
+                   info.source.fps_denominator / info.source.fps_numerator;
+        }
+        if(first > last) first = last;
+    }
+    info.source.num_audio_samples = last - first;
     if(_setmode(_fileno(stdout), _O_BINARY) == -1) {
         a2p_log(A2P_LOG_ERROR, "cannot switch stdout to binary mode.\n");
     }
+    header = a2p_audio_header(stdout, &info.source, args->rf64);
     
-    a2p_log(A2P_LOG_INFO, "writing %I64d seconds of %d Hz, %d channel audio.\n",
-            (info->num_audio_samples / info->audio_samples_per_second),
-            info->audio_samples_per_second, info->nchannels);
-    
-    header = wave_create_riff_header(format, info->nchannels,
-                                     info->audio_samples_per_second,
-                                     avs_bytes_per_channel_sample(info),
-                                     info->num_audio_samples);
-    fwrite(header, sizeof(*header), 1, stdout);
-    fflush(stdout);
-    free(header); // free the wav header
-    
-    count = info->audio_samples_per_second;
-    wrote = 0;
-    target = info->num_audio_samples;
-    size = avs_bytes_per_channel_sample(info) * info->nchannels;
+    count = info.source.audio_samples_per_second;
+    target = info.source.num_audio_samples;
+    size = avs_bytes_per_channel_sample(&info.source) * info.source.nchannels;
     buff = malloc(count * size);
-    if(buff == NULL) { // some idiot (me) forgot to check malloc return before
+    if(buff == NULL) {
         a2p_log(A2P_LOG_ERROR, "could not allocate sample buffer.\n");
     }
-    for (i = 0; i < target; i += count) {
+    wrote = 0;
+    for(i = 0; i < target; i += count) {
         if(target - i < count) count = (size_t) (target - i);
-        avs_get_audio(clip, buff, i, count);
-        step = fwrite(buff, size, count, stdout);
-        wrote += step;
+        a2p_daemon_audio(daemon, first + i, count, buff, count * size);
         // fail early if there is a problem instead of end of input
-        if(step != count) break;
+        if(fwrite(buff, size, count, stdout) != count) break;
+        wrote += count;
     }
+    a2p_audio_finish(stdout, header, wrote, args->rf64);
     fflush(stdout);
     free(buff);
-    
-    a2p_log(A2P_LOG_INFO, "finished, wrote %I64u seconds [%I64u%%].\n", 
-        wrote / info->audio_samples_per_second,
-        (100 * wrote) / target);
+    a2p_daemon_close(daemon);
     
     if(wrote != target) {
         a2p_log(A2P_LOG_ERROR, "only wrote %I64u of %I64u samples.\n",
                 wrote, target);
     }
+    a2p_log(A2P_LOG_INFO, "finished, wrote %I64u seconds [100%%].\n",
+            wrote / info.source.audio_samples_per_second);
+}
+
+// first audio sample at the time of frame n
+static uint64_t
+a2p_frame_sample(const AVS_VideoInfo *info, int n)
+{
+    return (uint64_t) n * info->audio_samples_per_second *
+           info->fps_denominator / info->fps_numerator;
 }
 
+// one evaluation of the script feeds both streams, after each frame the
+// audio up to the start of the next frame is queued so that consumers
+// reading the two in step are never starved by each other
 void
-a2p_do_video(AVS_ScriptEnvironment *env, AVS_Clip *clip)
+a2p_do_av(AVS_ScriptEnvironment *env, AVS_Clip *clip, const A2pArgs *args)
 {
-    #define MAX_PLANES 3
-    static const int planes[] = {AVS_PLANAR_Y, AVS_PLANAR_U, AVS_PLANAR_V};
-    static const char *FRAME_HEADER = "FRAME\n";
-    
     const AVS_VideoInfo *info;
     AVS_VideoFrame *frame;
+    A2pVideoFormat format;
+    A2pWriter *video, *audio;
+    FILE *outs[A2P_MAX_OUTPUTS], *audio_out;
+    WaveRf64Header *header;
+    BYTE *buff;
+    int32_t n, wrote;
+    int outs_num, i;
+    size_t size, chunk, count;
+    uint64_t sample, end, target, queued;
     
-    int32_t width[MAX_PLANES], height[MAX_PLANES];
-    int32_t width_sft, height_sft, planes_num;
-    char *yuv_csp;
-
-    BYTE *buff, *buff_ptr, *buff_0;
-    int32_t buff_inc[MAX_PLANES], buff_sz;
-    
-    int32_t p, wrote; // plane and frame for loop counts
-    size_t step, count;
-    
-    //const BYTE *read_ptr;
-    //int32_t r, pitch;
-    
-    info = avs_get_video_info(clip);
-    
-    if(!avs_has_video(info)) {
-        a2p_log(A2P_LOG_ERROR, "source has no video.\n");
+    if(args->audio_out == NULL) {
+        a2p_log(A2P_LOG_ERROR, "av needs --audio-out.\n");
+    }
+    if(strcmp(args->audio_out, "-") == 0) {
+        for(i = 0; i < args->video_outs; i++) {
+            if(strcmp(args->video_out[i], "-") == 0) break;
+        }
+        if(args->video_outs == 0 || i < args->video_outs) {
+            a2p_log(A2P_LOG_ERROR, "audio and video can not both go to "
+                    "stdout.\n");
+        }
     }
     
-    // Default number of planes to MAX_PLANES
-    planes_num = MAX_PLANES;
-    
-    // Setup correct color space handling, tnx Chikuzen
-    // If np > 3 is ever needed increase MAX_PLANES define
-    switch(info->pixel_type) {
-        #ifdef A2P_AVS26
-        case AVS_CS_BGR32:
-        case AVS_CS_BGR24:
-            a2p_log(A2P_LOG_INFO, "converting video to yv24.\n");
-            clip = a2p_avs_filter(env, "ConvertToYV24", clip);
-            info = avs_get_video_info(clip);
-        case AVS_CS_YV24:
-            yuv_csp = "444";
-            count = info->width * info->height * 3;
-            width_sft = 0;
-            height_sft = 0;
-            break;
-        case AVS_CS_YUY2:
-            a2p_log(A2P_LOG_INFO, "converting video to yv16.\n");
-            clip = a2p_avs_filter(env, "ConvertToYV16", clip);
-            info = avs_get_video_info(clip);
-        case AVS_CS_YV16:
-            yuv_csp = "422";
-            count = info->width * info->height * 2;
-            width_sft = 1;
-            height_sft = 0;
-            break;
-        case AVS_CS_YV411:
-            yuv_csp = "411";
-            count = info->width * info->height * 3 / 2;
-            width_sft = 2;
-            height_sft = 0;
-            break;
-        case AVS_CS_Y8:
-            yuv_csp = "mono";
-            count = info->width * info->height;
-            width_sft = 0;
-            height_sft = 0;
-            planes_num = 1; // special case only one plane for mono
-            break;
-        #endif        
-        default:
-            a2p_log(A2P_LOG_INFO, "converting video to yv12.\n");
-            clip = a2p_avs_filter(env, "ConvertToYV12", clip);
-            info = avs_get_video_info(clip);
-        case AVS_CS_I420:
-        case AVS_CS_YV12:
-            yuv_csp = "420";
-            count = info->width * info->height * 3 / 2;
-            width_sft = 1;
-            height_sft = 1;
+    if(args->threads > 0 || args->envs > 0 || args->segment_out != NULL ||
+       args->map_out != NULL || args->ring != NULL || args->serve != NULL ||
+       args->coordinate != NULL || args->direct) {
+        a2p_log(A2P_LOG_WARNING, "av renders inline, ignoring --threads, "
+                "--envs, --segment-out, --map-out, --ring, --serve, "
+                "--coordinate and --direct.\n");
+    }
+    if(args->rungs > 0) {
+        a2p_log(A2P_LOG_WARNING, "av does not scale, ignoring --rung.\n");
     }
     
-    if(_setmode(_fileno(stdout), _O_BINARY) == -1) {
-        a2p_log(A2P_LOG_ERROR, "cannot switch stdout to binary mode.\n");
+    clip = a2p_video_setup(env, clip, &args->video, &format);
+    info = avs_get_video_info(clip);
+    if(!avs_has_audio(info)) {
+        a2p_log(A2P_LOG_ERROR, "source has no audio.\n");
     }
     
-    a2p_log(A2P_LOG_INFO, "writing %d frames of %d/%d fps, %dx%d YUV%s %s video.\n",
-            info->num_frames, info->fps_numerator, info->fps_denominator,
-            info->width, info->height, yuv_csp, !avs_is_field_based(info) ?
-             "progressive" : !avs_is_bff(info) ? "tff" : "bff"); // default tff
+    outs_num = a2p_open_video_outputs(args, outs);
+    for(i = 0; i < outs_num; i++) {
+        a2p_video_header(outs[i], info, &format, &args->video);
+    }
+    audio_out = a2p_open_output(args->audio_out);
+    header = a2p_audio_header(audio_out, info, args->rf64);
     
-    // YUV4MPEG2 header http://wiki.multimedia.cx/index.php?title=YUV4MPEG2
-    fprintf(stdout, "YUV4MPEG2 W%d H%d F%u:%u I%s A0:0 C%s\n", info->width,
-            info->height, info->fps_numerator, info->fps_denominator,
-            !avs_is_field_based(info) ? "p" : !avs_is_bff(info) ? "t" : "b",
-            yuv_csp);
-    fflush(stdout);
+    // largest run of samples between two frames, rounded up
+    size = avs_bytes_per_channel_sample(info) * info->nchannels;
+    chunk = (size_t) (a2p_frame_sample(info, 1) + 1);
+    target = info->num_audio_samples;
     
-    // avs2yuv method changed to c with malloc, memcpy, avs_bit_blt, more csps
-    // calculate output buffer planes pitches
-    buff_sz = strlen(FRAME_HEADER) * sizeof(char); // space for FRAME header
-    count += buff_sz / sizeof(BYTE); // increase count to add FRAME
-    for(p = 0; p < planes_num; p++) {
-        width[p] = info->width >> (p ? width_sft : 0);
-        height[p] = info->height >> (p? height_sft : 0);
-        buff_inc[p] = width[p] * height[p] * sizeof(BYTE);
-        buff_sz += buff_inc[p];
-        //buff_inc[p] = width[p] * sizeof(BYTE);
-        //buff_sz += buff_inc[p] * height[p];
-    }
-    // check buff size to be sure on spec
-    if(buff_sz / sizeof(BYTE) != count) {
-        a2p_log(A2P_LOG_ERROR, "buffer size %d does not match count %d.\n",
-                buff_sz / sizeof(BYTE), count);
-    }
-    buff = (BYTE *) malloc(buff_sz);
-    if(buff == NULL) { // some idiot (me) forgot to check malloc return before
-        a2p_log(A2P_LOG_ERROR, "could not allocate frame buffer.\n");
-    }
-    // copy FRAME header to buffer and offset past it
-    memcpy(buff, FRAME_HEADER, strlen(FRAME_HEADER) * sizeof(char));
-    buff_0 = buff + (strlen(FRAME_HEADER) * sizeof(char));
-    wrote = 0;
-    while(wrote < info->num_frames) {
-        frame = avs_get_frame(clip, wrote);
-        buff_ptr = buff_0; // reset buff pointer
-        for(p = 0; p < planes_num; p++) {
-            // use avs_bit_blt to perform copy
-            avs_bit_blt(env, buff_ptr, width[p], avs_get_read_ptr_p(frame, planes[p]),
-                        avs_get_pitch_p(frame, planes[p]),
-                        avs_get_row_size_p(frame, planes[p]),
-                        avs_get_height_p(frame, planes[p]));
-            buff_ptr += buff_inc[p];
-            
-            // use memcpy to perform copy
-            /*pitch = avs_get_pitch_p(frame, planes[p]);
-            read_ptr = avs_get_read_ptr_p(frame, planes[p]);
-            for(r = 0; r < height[p]; r++) {
-                memcpy(buff_ptr, read_ptr, buff_inc[p]);
-                read_ptr += pitch;
-                buff_ptr += buff_inc[p];
-            }*/
-        }
-        step = fwrite(buff, sizeof(BYTE), count, stdout);
-        avs_release_frame(frame);
-        // fail early if there is a problem instead of end of input
-        if(step != count) break;
-        wrote++;
+    video = a2p_create_writer(args, outs, outs_num, format.size);
+    audio = a2p_create_writer(args, &audio_out, 1, chunk * size);
+    sample = 0;
+    queued = 0;
+    for(n = 0; n <= info->num_frames; n++) {
+        if(n < info->num_frames) {
+            buff = a2p_writer_acquire(video);
+            if(buff == NULL) break;
+            frame = avs_get_frame(clip, n);
+            a2p_video_pack(env, &format, frame, buff);
+            avs_release_frame(frame);
+            a2p_writer_commit(video, format.size);
+            end = a2p_frame_sample(info, n + 1);
+            if(end > target) end = target;
+        } else {
+            end = target; // audio running past the last frame
+        }
+        while(sample < end) {
+            count = end - sample < chunk ? (size_t) (end - sample) : chunk;
+            buff = a2p_writer_acquire(audio);
+            if(buff == NULL) break;
+            avs_get_audio(clip, buff, sample, count);
+            a2p_writer_commit(audio, count * size);
+            sample += count;
+            queued++;
+        }
+        if(sample < end) break;
     }
-    fflush(stdout);
-    free(buff);
+    wrote = (int32_t) a2p_writer_destroy(video);
+    // a failed audio write leaves queued chunks unwritten
+    if(a2p_writer_destroy(audio) != queued) sample = 0;
+    a2p_audio_finish(audio_out, header, sample, args->rf64);
+    a2p_video_close(&format);
+    
+    a2p_close_outputs(outs, outs_num);
+    a2p_close_outputs(&audio_out, 1);
     
     if(wrote != info->num_frames) {
         a2p_log(A2P_LOG_ERROR, "failed, only wrote %d of %d frames.\n",
                 wrote, info->num_frames);
-    } else {
-        a2p_log(A2P_LOG_INFO, "finished, wrote %d frames [%d%%].\n", 
-                wrote, (100 * wrote) / info->num_frames);
+    } else if(sample != target) {
+        a2p_log(A2P_LOG_ERROR, "failed, audio stopped before the end.\n");
     }
+    a2p_log(A2P_LOG_INFO, "finished, wrote %d frames and %I64u samples.\n",
+            wrote, target);
 }
 
+// video and audio muxed into one matroska stream, each cluster is one
+// frame and its audio built in a writer buffer, so the frame is packed
+// straight after its block header
 void
-a2p_do_info(AVS_ScriptEnvironment *env, AVS_Clip *clip)
+a2p_do_mkv(AVS_ScriptEnvironment *env, AVS_Clip *clip, const A2pArgs *args)
 {
     const AVS_VideoInfo *info;
+    AVS_VideoFrame *frame;
+    A2pVideoFormat format;
+    A2pMkvInfo mkv;
+    A2pWriter *writer;
+    FILE *outs[A2P_MAX_OUTPUTS];
+    BYTE header[A2P_MKV_HEADER_MAX];
+    BYTE *buff, *p;
+    int32_t n;
+    int outs_num, i, failed;
+    size_t size, frame_size, header_size, chunk, count;
+    uint64_t sample, end, target, time, queued;
+    
+    if(args->threads > 0 || args->envs > 0 || args->segment_out != NULL ||
+       args->map_out != NULL || args->ring != NULL || args->serve != NULL ||
+       args->coordinate != NULL || args->direct || args->rungs > 0) {
+        a2p_log(A2P_LOG_WARNING, "mkv renders inline, ignoring --threads, "
+                "--envs, --segment-out, --map-out, --ring, --serve, "
+                "--coordinate, --direct and --rung.\n");
+    }
     
+    clip = a2p_video_setup(env, clip, &args->video, &format);
     info = avs_get_video_info(clip);
     
+    memset(&mkv, 0, sizeof(mkv));
+    if(!a2p_video_fourcc(&format, mkv.fourcc)) {
+        a2p_log(A2P_LOG_ERROR, "matroska has no raw tag for %s video.\n",
+                format.yuv_csp);
+    }
+    a2p_video_header(NULL, info, &format, &args->video);
+    mkv.width = info->width;
+    mkv.height = info->height;
+    mkv.fps_numerator = info->fps_numerator;
+    mkv.fps_denominator = info->fps_denominator;
+    mkv.frames = info->num_frames;
+    size = 0;
+    target = 0;
+    if(avs_has_audio(info)) {
+        mkv.channels = info->nchannels;
+        mkv.sample_rate = info->audio_samples_per_second;
+        mkv.sample_bits = avs_bytes_per_channel_sample(info) * 8;
+        mkv.sample_float = info->sample_type == AVS_SAMPLE_FLOAT;
+        size = avs_bytes_per_channel_sample(info) * info->nchannels;
+        target = info->num_audio_samples;
+        a2p_log(A2P_LOG_INFO, "muxing %d Hz, %d channel audio.\n",
+                info->audio_samples_per_second, info->nchannels);
+    }
+    
+    outs_num = a2p_open_video_outputs(args, outs);
+    header_size = a2p_mkv_header(header, &mkv);
+    for(i = 0; i < outs_num; i++) {
+        fwrite(header, 1, header_size, outs[i]);
+        fflush(outs[i]);
+    }
+    
+    // audio after the last frame goes out a second at a time
+    frame_size = format.size - format.header;
+    chunk = (size_t) (a2p_frame_sample(info, 1) + 1);
+    count = A2P_MKV_CLUSTER_HEADER + 2 * A2P_MKV_BLOCK_HEADER + frame_size +
+            chunk * size;
+    if(count < A2P_MKV_CLUSTER_HEADER + A2P_MKV_BLOCK_HEADER +
+               info->audio_samples_per_second * size) {
+        count = A2P_MKV_CLUSTER_HEADER + A2P_MKV_BLOCK_HEADER +
+                info->audio_samples_per_second * size;
+    }
+    writer = a2p_create_writer(args, outs, outs_num, count);
+    sample = 0;
+    queued = 0;
+    for(n = 0; n < info->num_frames || sample < target; n++) {
+        buff = a2p_writer_acquire(writer);
+        if(buff == NULL) break;
+        p = buff + A2P_MKV_CLUSTER_HEADER;
+        if(n < info->num_frames) {
+            // the FRAME header lands where the block header goes
+            frame = avs_get_frame(clip, n);
+            a2p_video_pack(env, &format, frame, p + A2P_MKV_BLOCK_HEADER -
+                                                format.header);
+            avs_release_frame(frame);
+            time = (uint64_t) n * 1000 * info->fps_denominator /
+                   info->fps_numerator;
+            p += a2p_mkv_block(p, A2P_MKV_VIDEO_TRACK, 0, frame_size);
+            p += frame_size;
+            end = a2p_frame_sample(info, n + 1);
+        } else {
+            time = sample * 1000 / info->audio_samples_per_second;
+            end = sample + info->audio_samples_per_second;
+        }
+        if(end > target) end = target;
+        if(sample < end) {
+            count = (size_t) (end - sample);
+            p += a2p_mkv_block(p, A2P_MKV_AUDIO_TRACK, (int) (sample * 1000 /
+                               info->audio_samples_per_second - time),
+                               count * size);
+            avs_get_audio(clip, p, sample, count);
+            p += count * size;
+            sample = end;
+        }
+        a2p_mkv_cluster(buff, time, p - buff - A2P_MKV_CLUSTER_HEADER);
+        a2p_writer_commit(writer, p - buff);
+        queued++;
+    }
+    failed = a2p_writer_destroy(writer) != queued || n < info->num_frames ||
+             sample != target;
+    a2p_video_close(&format);
+    a2p_close_outputs(outs, outs_num);
+    
+    if(failed) {
+        a2p_log(A2P_LOG_ERROR, "failed, the stream stopped before the "
+                "end.\n");
+    }
+    a2p_log(A2P_LOG_INFO, "finished, muxed %d frames and %I64u samples.\n",
+            info->num_frames, target);
+}
+
+static void
+a2p_info_print(const AVS_VideoInfo *info)
+{
     if(avs_has_video(info)) {
         fprintf(stdout, "v:width       %d\n", info->width);
         fprintf(stdout, "v:height      %d\n", info->height);
@@ -371,6 +1870,24 @@ a2p_do_info(AVS_ScriptEnvironment *env, AVS_Clip *clip)
     }
 }
 
+void
+a2p_do_info(AVS_ScriptEnvironment *env, AVS_Clip *clip)
+{
+    a2p_info_print(avs_get_video_info(clip));
+}
+
+void
+a2p_do_daemon_info(const char *script, const A2pArgs *args)
+{
+    A2pDaemonInfo info;
+    A2pDaemon *daemon;
+    
+    daemon = a2p_daemon_connect(args->daemon, script, args->lz4);
+    a2p_daemon_info(daemon, &info);
+    a2p_daemon_close(daemon);
+    a2p_info_print(&info.source);
+}
+
 void
 a2p_do_x264bd(AVS_ScriptEnvironment *env, AVS_Clip *clip)
 {
@@ -527,33 +2044,298 @@ a2p_do_x264bd(AVS_ScriptEnvironment *env, AVS_Clip *clip)
             keyint, ref, args, color, color, color);
 }
 
+static int
+a2p_arg_int(const char *name, const char *value, int min)
+{
+    char *end;
+    long result;
+    
+    result = strtol(value, &end, 10);
+    if(*value == '\0' || *end != '\0' || result < min) {
+        a2p_log(A2P_LOG_ERROR, "invalid value '%s' for %s.\n", value, name);
+    }
+    
+    return (int) result;
+}
+
 int __cdecl
 main (int argc, char *argv[])
 {
     AVS_ScriptEnvironment *env;
     AVS_Clip *clip;
+    A2pArgs args;
     char * input;
+    int i, used;
     enum {
         A2P_ACTION_AUDIO,
         A2P_ACTION_VIDEO,
+        A2P_ACTION_AV,
+        A2P_ACTION_MKV,
         A2P_ACTION_INFO,
         A2P_ACTION_X264BD,
+        A2P_ACTION_RINGCAT,
+        A2P_ACTION_FETCH,
+        A2P_ACTION_DAEMON,
+        A2P_ACTION_WORKER,
         A2P_ACTION_NOTHING    
     } action;
     
     action = A2P_ACTION_NOTHING;
     
-    if(argc == 3) {
+    args.start = 0;
+    args.frames = 0;
+    args.threads = 0;
+    args.prefetch = 0;
+    args.envs = 0;
+    args.chunk = 0;
+    args.segment_out = NULL;
+    args.map_out = NULL;
+    args.ring = NULL;
+    args.serve = NULL;
+    args.lz4 = 0;
+    args.daemon = NULL;
+    args.cache = A2P_DAEMON_CACHE;
+    args.coordinate = NULL;
+    args.spawn = 0;
+    args.buffers = 2;
+    args.audio_chunk = 0;
+    args.audio_overlap = 0;
+    args.audio_bits = 0;
+    args.audio_dither = 1;
+    args.rf64 = 0;
+    args.direct = 0;
+    args.async = 0;
+    args.video_outs = 0;
+    args.audio_out = NULL;
+    args.rungs = 0;
+    args.scaler = A2P_SCALE_BICUBIC;
+    args.video.rgb = 0;
+    args.video.csp420 = 0;
+    args.video.matrix = 601;
+    args.video.convert_threads = 0;
+    args.video.sample_bits = 16;
+    args.video.depth = 0;
+    args.video.dither = A2P_DITHER_ORDERED;
+    args.video.output = A2P_OUTPUT_Y4M;
+    
+    if(argc >= 3) {
         if(strcmp(argv[1], "audio") == 0) {
             action = A2P_ACTION_AUDIO;
         } else if(strcmp(argv[1], "video") == 0) {
             action = A2P_ACTION_VIDEO;
+        } else if(strcmp(argv[1], "av") == 0) {
+            action = A2P_ACTION_AV;
+        } else if(strcmp(argv[1], "mkv") == 0) {
+            action = A2P_ACTION_MKV;
         } else if(strcmp(argv[1], "info") == 0) {
             action = A2P_ACTION_INFO;
         } else if(strcmp(argv[1], "x264bd") == 0) {
             action = A2P_ACTION_X264BD;
+        } else if(strcmp(argv[1], "ringcat") == 0) {
+            action = A2P_ACTION_RINGCAT;
+        } else if(strcmp(argv[1], "fetch") == 0) {
+            action = A2P_ACTION_FETCH;
+        } else if(strcmp(argv[1], "daemon") == 0) {
+            action = A2P_ACTION_DAEMON;
+        } else if(strcmp(argv[1], "worker") == 0) {
+            action = A2P_ACTION_WORKER;
         }
-        input = argv[2];
+        // options sit between the action and the input script
+        for(i = 2; i < argc - 1; i++) {
+            if(strcmp(argv[i], "--start") == 0 && i + 1 < argc - 1) {
+                args.start = a2p_arg_int(argv[i], argv[i + 1], 0);
+                i++;
+            } else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc - 1) {
+                args.frames = a2p_arg_int(argv[i], argv[i + 1], 1);
+                i++;
+            } else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc - 1) {
+                args.threads = a2p_arg_int(argv[i], argv[i + 1], 0);
+                i++;
+            } else if(strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc - 1) {
+                args.prefetch = a2p_arg_int(argv[i], argv[i + 1], 1);
+                i++;
+            } else if(strcmp(argv[i], "--envs") == 0 && i + 1 < argc - 1) {
+                args.envs = a2p_arg_int(argv[i], argv[i + 1], 1);
+                i++;
+            } else if(strcmp(argv[i], "--chunk") == 0 && i + 1 < argc - 1) {
+                args.chunk = a2p_arg_int(argv[i], argv[i + 1], 1);
+                i++;
+            } else if(strcmp(argv[i], "--segment-out") == 0 && i + 1 < argc - 1) {
+                if(!a2p_segments_pattern(argv[i + 1])) {
+                    a2p_log(A2P_LOG_ERROR, "%s needs one %%d for the first "
+                            "frame, eg. part%%06d.y4m.\n", argv[i]);
+                }
+                args.segment_out = argv[i + 1];
+                i++;
+            } else if(strcmp(argv[i], "--map-out") == 0 && i + 1 < argc - 1) {
+                args.map_out = argv[i + 1];
+                i++;
+            } else if(strcmp(argv[i], "--ring") == 0 && i + 1 < argc - 1) {
+                args.ring = argv[i + 1];
+                i++;
+            } else if(strcmp(argv[i], "--serve") == 0 && i + 1 < argc - 1) {
+                args.serve = argv[i + 1];
+                i++;
+            } else if(strcmp(argv[i], "--daemon") == 0 && i + 1 < argc - 1) {
+                args.daemon = argv[i + 1];
+                i++;
+            } else if(strcmp(argv[i], "--cache") == 0 && i + 1 < argc - 1) {
+                args.cache = a2p_arg_int(argv[i], argv[i + 1], 1);
+                i++;
+            } else if(strcmp(argv[i], "--coordinate") == 0 && i + 1 < argc - 1) {
+                args.coordinate = argv[i + 1];
+                i++;
+            } else if(strcmp(argv[i], "--spawn") == 0 && i + 1 < argc - 1) {
+                args.spawn = a2p_arg_int(argv[i], argv[i + 1], 1);
+                i++;
+            } else if(strcmp(argv[i], "--lz4") == 0) {
+                args.lz4 = 1;
+            } else if(strcmp(argv[i], "--async") == 0) {
+                args.async = 1;
+            } else if(strcmp(argv[i], "--direct") == 0) {
+                args.direct = 1;
+            } else if(strcmp(argv[i], "--rgb") == 0) {
+                args.video.rgb = 1;
+            } else if(strcmp(argv[i], "--csp") == 0 && i + 1 < argc - 1) {
+                if(strcmp(argv[i + 1], "420") != 0) {
+                    a2p_log(A2P_LOG_ERROR, "%s only supports 420.\n", argv[i]);
+                }
+                args.video.csp420 = 1;
+                i++;
+            } else if(strcmp(argv[i], "--matrix") == 0 && i + 1 < argc - 1) {
+                args.video.matrix = a2p_arg_int(argv[i], argv[i + 1], 601);
+                if(args.video.matrix != 601 && args.video.matrix != 709) {
+                    a2p_log(A2P_LOG_ERROR, "%s must be 601 or 709.\n", argv[i]);
+                }
+                i++;
+            } else if(strcmp(argv[i], "--convert-threads") == 0 && i + 1 < argc - 1) {
+                args.video.convert_threads = a2p_arg_int(argv[i], argv[i + 1], 0);
+                i++;
+            } else if(strcmp(argv[i], "--sample-bits") == 0 && i + 1 < argc - 1) {
+                args.video.sample_bits = a2p_arg_int(argv[i], argv[i + 1], 9);
+                if(args.video.sample_bits > 16) {
+                    a2p_log(A2P_LOG_ERROR, "%s must be 9 to 16.\n", argv[i]);
+                }
+                i++;
+            } else if(strcmp(argv[i], "--depth") == 0 && i + 1 < argc - 1) {
+                args.video.depth = a2p_arg_int(argv[i], argv[i + 1], 8);
+                if(args.video.depth > 16) {
+                    a2p_log(A2P_LOG_ERROR, "%s must be 8 to 16.\n", argv[i]);
+                }
+                i++;
+            } else if(strcmp(argv[i], "--dither") == 0 && i + 1 < argc - 1) {
+                if(strcmp(argv[i + 1], "none") == 0) {
+                    args.video.dither = A2P_DITHER_NONE;
+                } else if(strcmp(argv[i + 1], "ordered") == 0) {
+                    args.video.dither = A2P_DITHER_ORDERED;
+                } else if(strcmp(argv[i + 1], "fs") == 0) {
+                    args.video.dither = A2P_DITHER_FS;
+                } else {
+                    a2p_log(A2P_LOG_ERROR, "invalid value '%s' for %s.\n",
+                            argv[i + 1], argv[i]);
+                }
+                i++;
+            } else if(strcmp(argv[i], "--raw") == 0 && i + 1 < argc - 1) {
+                if(strcmp(argv[i + 1], "p010") == 0) {
+                    args.video.output = A2P_OUTPUT_P010;
+                } else if(strcmp(argv[i + 1], "v210") == 0) {
+                    args.video.output = A2P_OUTPUT_V210;
+                } else {
+                    a2p_log(A2P_LOG_ERROR, "invalid value '%s' for %s.\n",
+                            argv[i + 1], argv[i]);
+                }
+                i++;
+            } else if(strcmp(argv[i], "--video-out") == 0 && i + 1 < argc - 1) {
+                if(args.video_outs == A2P_MAX_OUTPUTS) {
+                    a2p_log(A2P_LOG_ERROR, "at most %d %s allowed.\n",
+                            A2P_MAX_OUTPUTS, argv[i]);
+                }
+                args.video_out[args.video_outs++] = argv[i + 1];
+                i++;
+            } else if(strcmp(argv[i], "--rung") == 0 && i + 1 < argc - 1) {
+                if(args.rungs == A2P_MAX_OUTPUTS) {
+                    a2p_log(A2P_LOG_ERROR, "at most %d %s allowed.\n",
+                            A2P_MAX_OUTPUTS, argv[i]);
+                }
+                // WxH:file, the file may hold colons itself
+                used = 0;
+                if(sscanf(argv[i + 1], "%dx%d:%n", &args.rung_width[args.rungs],
+                          &args.rung_height[args.rungs], &used) != 2 ||
+                   used == 0 || argv[i + 1][used] == '\0') {
+                    a2p_log(A2P_LOG_ERROR, "invalid value '%s' for %s, "
+                            "use WxH:file.\n", argv[i + 1], argv[i]);
+                }
+                args.rung_out[args.rungs++] = argv[i + 1] + used;
+                i++;
+            } else if(strcmp(argv[i], "--scaler") == 0 && i + 1 < argc - 1) {
+                if(strcmp(argv[i + 1], "bilinear") == 0) {
+                    args.scaler = A2P_SCALE_BILINEAR;
+                } else if(strcmp(argv[i + 1], "bicubic") == 0) {
+                    args.scaler = A2P_SCALE_BICUBIC;
+                } else if(strcmp(argv[i + 1], "lanczos") == 0) {
+                    args.scaler = A2P_SCALE_LANCZOS;
+                } else {
+                    a2p_log(A2P_LOG_ERROR, "invalid value '%s' for %s.\n",
+                            argv[i + 1], argv[i]);
+                }
+                i++;
+            } else if(strcmp(argv[i], "--audio-out") == 0 && i + 1 < argc - 1) {
+                args.audio_out = argv[i + 1];
+                i++;
+            } else if(strcmp(argv[i], "--buffers") == 0 && i + 1 < argc - 1) {
+                args.buffers = a2p_arg_int(argv[i], argv[i + 1], 1);
+                i++;
+            } else if(strcmp(argv[i], "--audio-chunk") == 0 && i + 1 < argc - 1) {
+                args.audio_chunk = a2p_arg_int(argv[i], argv[i + 1], 1);
+                i++;
+            } else if(strcmp(argv[i], "--audio-overlap") == 0 && i + 1 < argc - 1) {
+                args.audio_overlap = a2p_arg_int(argv[i], argv[i + 1], 0);
+                i++;
+            } else if(strcmp(argv[i], "--audio-bits") == 0 && i + 1 < argc - 1) {
+                args.audio_bits = a2p_arg_int(argv[i], argv[i + 1], 16);
+                if(args.audio_bits != 16 && args.audio_bits != 24) {
+                    a2p_log(A2P_LOG_ERROR, "invalid value '%s' for %s.\n",
+                            argv[i + 1], argv[i]);
+                }
+                i++;
+            } else if(strcmp(argv[i], "--rf64") == 0) {
+                args.rf64 = 1;
+            } else if(strcmp(argv[i], "--audio-dither") == 0 && i + 1 < argc - 1) {
+                if(strcmp(argv[i + 1], "none") == 0) {
+                    args.audio_dither = 0;
+                } else if(strcmp(argv[i + 1], "tpdf") == 0) {
+                    args.audio_dither = 1;
+                } else {
+                    a2p_log(A2P_LOG_ERROR, "invalid value '%s' for %s.\n",
+                            argv[i + 1], argv[i]);
+                }
+                i++;
+            } else {
+                a2p_log(A2P_LOG_WARNING, "unknown option %s.\n", argv[i]);
+                action = A2P_ACTION_NOTHING;
+                break;
+            }
+        }
+        input = argv[argc - 1];
+        args.input = input;
+    }
+    
+    // only the plain audio path converts samples
+    if(args.audio_bits > 0 && (action != A2P_ACTION_AUDIO ||
+       args.map_out != NULL || args.serve != NULL ||
+       args.coordinate != NULL || args.daemon != NULL)) {
+        a2p_log(A2P_LOG_WARNING, "--audio-bits is only used by audio written "
+                "to stdout, ignoring it.\n");
+    }
+    // in order output hands out short chunks, segment files split evenly
+    if(args.envs > 0 && args.segment_out == NULL && args.chunk == 0) {
+        args.chunk = A2P_SEGMENT_CHUNK;
+    }
+    // default to keeping two frames in flight per worker, or a chunk for
+    // each environment
+    if(args.prefetch == 0) {
+        args.prefetch = args.envs > 0 ? args.envs * args.chunk :
+                        args.threads * 2;
     }
     
     if(action == A2P_ACTION_NOTHING) {
@@ -563,23 +2345,147 @@ main (int argc, char *argv[])
         #else
             fprintf(stderr, "avs2pipe for AviSynth 2.5.8\n");
         #endif
-        fprintf(stderr, "Usage: avs2pipe [audio|video|info|x264] input.avs\n");
+        fprintf(stderr, "Usage: avs2pipe [audio|video|av|mkv|info|x264|ringcat|fetch|daemon|worker] [options] input.avs\n");
         fprintf(stderr, "   audio  - output wav extensible format audio to stdout.\n");
         fprintf(stderr, "   video  - output yuv4mpeg2 format video to stdout.\n");
+        fprintf(stderr, "   av     - output video and audio from one script load.\n");
+        fprintf(stderr, "   mkv    - output video and audio interleaved in one matroska\n");
+        fprintf(stderr, "            stream to stdout.\n");
         fprintf(stderr, "   info   - output information about aviscript clip.\n");
         fprintf(stderr, "   x264bd - suggest x264 arguments for bluray disc encoding.\n");
+        fprintf(stderr, "   ringcat - write the video in a --ring to stdout, the ring\n");
+        fprintf(stderr, "            name is given in place of input.avs.\n");
+        fprintf(stderr, "   fetch  - write the stream of a --serve server to stdout, its\n");
+        fprintf(stderr, "            host:port is given in place of input.avs.\n");
+        fprintf(stderr, "   daemon - keep scripts loaded and serve their frames, the\n");
+        fprintf(stderr, "            host:port to listen on is given in place of input.avs.\n");
+        fprintf(stderr, "   worker - render chunks for a --coordinate, its host:port is\n");
+        fprintf(stderr, "            given in place of input.avs.\n");
+        fprintf(stderr, "Range options, audio follows the frames:\n");
+        fprintf(stderr, "   --start N     - first frame written, default 0.\n");
+        fprintf(stderr, "   --frames N    - frames written from --start, default all.\n");
+        fprintf(stderr, "Video options:\n");
+        fprintf(stderr, "   --threads N   - render frames on N threads, needs MT AviSynth.\n");
+        fprintf(stderr, "   --prefetch N  - frames rendered ahead, default 2 per thread or a chunk per env.\n");
+        fprintf(stderr, "   --buffers N   - frames queued for the writer thread, default 2.\n");
+        fprintf(stderr, "   --direct      - write frames unpacked from AviSynth memory.\n");
+        fprintf(stderr, "   --async       - overlapped writes to files and named pipes, for\n");
+        fprintf(stderr, "                   audio too, no writer thread.\n");
+        fprintf(stderr, "   --envs N      - render chunks of frames in N script environments.\n");
+        fprintf(stderr, "   --chunk N     - frames per --envs chunk, default 16.\n");
+        fprintf(stderr, "   --segment-out P - write each range to a file named after its first\n");
+        fprintf(stderr, "                   frame, eg. part%%06d.y4m, --envs default 1 per cpu.\n");
+        fprintf(stderr, "   --video-out F - file or pipe instead of stdout, repeat to tee.\n");
+        fprintf(stderr, "   --map-out F   - file written in place by every render thread, for\n");
+        fprintf(stderr, "                   audio too, --threads needs MT AviSynth.\n");
+        fprintf(stderr, "   --ring NAME   - pack frames into a shared memory ring of --buffers\n");
+        fprintf(stderr, "                   slots for a reader on the same machine.\n");
+        fprintf(stderr, "   --serve A     - send to one client connecting to host:port or :port,\n");
+        fprintf(stderr, "                   for audio too.\n");
+        fprintf(stderr, "   --lz4         - compress what --serve sends, for slow links.\n");
+        #ifdef A2P_AVS26
+        fprintf(stderr, "   --rgb         - write rgb as C444 gbr planes, no matrix.\n");
+        fprintf(stderr, "   --csp 420     - convert rgb, yuy2, yv16 and yv24 to 420.\n");
+        fprintf(stderr, "   --sample-bits N - bits used in 16 bit video, eg. 10, default 16.\n");
+        fprintf(stderr, "   --depth N     - reduce 16 bit video to N bits, eg. 8 or 10.\n");
+        fprintf(stderr, "   --dither M    - none, ordered or fs for --depth, default ordered.\n");
+        #endif
+        fprintf(stderr, "   --raw F       - write raw p010 or v210 frames instead of y4m.\n");
+        fprintf(stderr, "   --matrix N    - 601 or 709 for rgb to yuv, default 601.\n");
+        fprintf(stderr, "   --rung WxH:F  - also write the video scaled to WxH, repeat for more.\n");
+        fprintf(stderr, "   --scaler K    - bilinear, bicubic or lanczos for --rung, default bicubic.\n");
+        fprintf(stderr, "   --convert-threads N - threads converting and scaling, default 1 per cpu.\n");
+        fprintf(stderr, "Audio options:\n");
+        fprintf(stderr, "   --audio-chunk N - samples per buffer, default fits --buffers in cache.\n");
+        fprintf(stderr, "   --audio-overlap N - samples read and thrown away before each --envs\n");
+        fprintf(stderr, "                   block to warm up stateful filters, default 0.\n");
+        fprintf(stderr, "   --audio-bits N - write float audio as 16 or 24 bit pcm.\n");
+        fprintf(stderr, "   --audio-dither M - none or tpdf for --audio-bits, default tpdf.\n");
+        fprintf(stderr, "   --rf64        - always write RF64, otherwise only past 4GB, for av too.\n");
+        fprintf(stderr, "Av options, the video output and format options apply too:\n");
+        fprintf(stderr, "   --audio-out F - wav audio file or pipe, - for stdout.\n");
+        fprintf(stderr, "Daemon options, the format options apply to the daemon:\n");
+        fprintf(stderr, "   --daemon A    - audio, video or info from the daemon on host:port,\n");
+        fprintf(stderr, "                   eg. 127.0.0.1:7778, instead of loading the script.\n");
+        fprintf(stderr, "   --cache N     - scripts the daemon keeps loaded, default 4.\n");
+        fprintf(stderr, "Coordinator options, audio or video:\n");
+        fprintf(stderr, "   --coordinate A - hand chunks to worker processes connecting to\n");
+        fprintf(stderr, "                   host:port or :port, in order or --segment-out.\n");
+        fprintf(stderr, "   --spawn N     - start N workers on this machine, default none.\n");
+        fprintf(stderr, "   --chunk N     - frames or seconds per worker chunk, default 16.\n");
         exit(2);
     }
     
+    // ring readers and clients have no script to load
+    if(action == A2P_ACTION_RINGCAT) {
+        a2p_do_ringcat(input, &args);
+        exit(0);
+    }
+    if(action == A2P_ACTION_FETCH) {
+        a2p_do_fetch(input, &args);
+        exit(0);
+    }
+    if(action == A2P_ACTION_DAEMON) {
+        a2p_daemon_run(input, &args.video, args.cache);
+        exit(0);
+    }
+    if(action == A2P_ACTION_WORKER) {
+        a2p_coord_work(input);
+        exit(0);
+    }
+    // nor does a client of a daemon, which has it loaded already
+    if(args.daemon != NULL) {
+        if(action == A2P_ACTION_AUDIO) {
+            a2p_do_daemon_audio(input, &args);
+        } else if(action == A2P_ACTION_VIDEO) {
+            a2p_do_daemon_video(input, &args);
+        } else if(action == A2P_ACTION_INFO) {
+            a2p_do_daemon_info(input, &args);
+        } else {
+            a2p_log(A2P_LOG_ERROR, "--daemon only serves audio, video and "
+                    "info.\n");
+        }
+        exit(0);
+    }
+    
     env = avs_create_script_environment(AVISYNTH_INTERFACE_VERSION);
     clip = a2p_avs_source(env, input);
+    if(args.start > 0 || args.frames > 0) {
+        clip = a2p_avs_trim(env, clip, args.start, args.frames);
+    }
     
     switch(action) {
         case A2P_ACTION_AUDIO:
-            a2p_do_audio(env, clip);
+            if(args.coordinate != NULL) {
+                a2p_do_audio_coord(env, clip, &args);
+            } else if(args.map_out != NULL) {
+                a2p_do_audio_map(env, clip, &args);
+            } else if(args.serve != NULL) {
+                a2p_do_audio_net(env, clip, &args);
+            } else {
+                a2p_do_audio(env, clip, &args);
+            }
             break;
         case A2P_ACTION_VIDEO:
-            a2p_do_video(env, clip);
+            if(args.coordinate != NULL) {
+                a2p_do_video_coord(env, clip, &args);
+            } else if(args.segment_out != NULL) {
+                a2p_do_segments(env, clip, &args);
+            } else if(args.map_out != NULL) {
+                a2p_do_video_map(env, clip, &args);
+            } else if(args.ring != NULL) {
+                a2p_do_video_ring(env, clip, &args);
+            } else if(args.serve != NULL) {
+                a2p_do_video_net(env, clip, &args);
+            } else {
+                a2p_do_video(env, clip, &args);
+            }
+            break;
+        case A2P_ACTION_AV:
+            a2p_do_av(env, clip, &args);
+            break;
+        case A2P_ACTION_MKV:
+            a2p_do_mkv(env, clip, &args);
             break;
         case A2P_ACTION_INFO:
             a2p_do_info(env, clip);
@@ -587,6 +2493,10 @@ main (int argc, char *argv[])
         case A2P_ACTION_X264BD:
             a2p_do_x264bd(env, clip);
             break;
+        case A2P_ACTION_RINGCAT:
+        case A2P_ACTION_FETCH:
+        case A2P_ACTION_DAEMON:
+        case A2P_ACTION_WORKER:
         case A2P_ACTION_NOTHING: // Removing GCC warning, this action is handled above
             break;
     }
@@ -0,0 +1,45 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef AVS2PIPE_H
+#define AVS2PIPE_H
+
+#ifdef A2P_AVS26
+    #include "avisynth26/avisynth_c.h"
+#else
+    #include "avisynth/avisynth_c.h"
+#endif
+
+AVS_Clip *
+a2p_avs_invoke(AVS_ScriptEnvironment *env, const char *name, AVS_Value *args,
+               int args_num);
+
+AVS_Clip *
+a2p_avs_filter(AVS_ScriptEnvironment *env, const char *filter, AVS_Clip *clip);
+
+// keeps frames [start, start + frames), 0 frames keeps the rest
+AVS_Clip *
+a2p_avs_trim(AVS_ScriptEnvironment *env, AVS_Clip *clip, int start,
+             int frames);
+
+AVS_Clip *
+a2p_avs_source(AVS_ScriptEnvironment *env, char *file);
+
+#endif // AVS2PIPE_H
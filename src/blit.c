@@ -0,0 +1,99 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include "cpu.h"
+#include "blit.h"
+
+static void a2p_blit_detect(uint8_t *, int, const uint8_t *, int, int, int);
+static void a2p_blit_stream_detect(uint8_t *, int, const uint8_t *, int,
+                                   int, int);
+
+static A2pBlitFunc a2p_blit_func = a2p_blit_detect;
+static A2pBlitFunc a2p_blit_stream_func = a2p_blit_stream_detect;
+
+// first call picks the kernels, racing threads all pick the same ones
+static void
+a2p_blit_select(void)
+{
+    int flags;
+    
+    flags = a2p_cpu_flags();
+    a2p_blit_stream_func = a2p_blit_c;
+    a2p_blit_func = a2p_blit_c;
+    if(flags & A2P_CPU_SSE2) {
+        a2p_blit_stream_func = a2p_blit_stream_sse2;
+        a2p_blit_func = a2p_blit_sse2;
+    }
+    #ifdef A2P_HAVE_AVX2
+    if(flags & A2P_CPU_AVX2) {
+        a2p_blit_stream_func = a2p_blit_stream_avx2;
+        a2p_blit_func = a2p_blit_avx2;
+    }
+    #endif
+}
+
+static void
+a2p_blit_detect(uint8_t *dst, int dst_pitch, const uint8_t *src,
+                int src_pitch, int row_size, int height)
+{
+    a2p_blit_select();
+    a2p_blit_func(dst, dst_pitch, src, src_pitch, row_size, height);
+}
+
+static void
+a2p_blit_stream_detect(uint8_t *dst, int dst_pitch, const uint8_t *src,
+                       int src_pitch, int row_size, int height)
+{
+    a2p_blit_select();
+    a2p_blit_stream_func(dst, dst_pitch, src, src_pitch, row_size, height);
+}
+
+void
+a2p_blit(uint8_t *dst, int dst_pitch, const uint8_t *src, int src_pitch,
+         int row_size, int height)
+{
+    a2p_blit_func(dst, dst_pitch, src, src_pitch, row_size, height);
+}
+
+void
+a2p_blit_stream(uint8_t *dst, int dst_pitch, const uint8_t *src,
+                int src_pitch, int row_size, int height)
+{
+    a2p_blit_stream_func(dst, dst_pitch, src, src_pitch, row_size, height);
+}
+
+void
+a2p_blit_c(uint8_t *dst, int dst_pitch, const uint8_t *src, int src_pitch,
+           int row_size, int height)
+{
+    int y;
+    
+    // unpadded planes are one long row
+    if(dst_pitch == row_size && src_pitch == row_size) {
+        memcpy(dst, src, (size_t) row_size * height);
+        return;
+    }
+    for(y = 0; y < height; y++) {
+        memcpy(dst, src, row_size);
+        dst += dst_pitch;
+        src += src_pitch;
+    }
+}
@@ -0,0 +1,63 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Strided plane copy, a replacement for avs_bit_blt with simd kernels
+// picked at runtime. The stream variants use non-temporal stores for
+// buffers too big to stay in the last level cache anyway.
+
+#ifndef BLIT_H
+#define BLIT_H
+
+#include <stdint.h>
+
+typedef void (*A2pBlitFunc)(uint8_t *dst, int dst_pitch,
+                            const uint8_t *src, int src_pitch,
+                            int row_size, int height);
+
+void
+a2p_blit(uint8_t *dst, int dst_pitch, const uint8_t *src, int src_pitch,
+         int row_size, int height);
+
+void
+a2p_blit_stream(uint8_t *dst, int dst_pitch, const uint8_t *src,
+                int src_pitch, int row_size, int height);
+
+// kernels, only call the simd ones when a2p_cpu_flags reports support
+void
+a2p_blit_c(uint8_t *dst, int dst_pitch, const uint8_t *src, int src_pitch,
+           int row_size, int height);
+
+void
+a2p_blit_sse2(uint8_t *dst, int dst_pitch, const uint8_t *src,
+              int src_pitch, int row_size, int height);
+
+void
+a2p_blit_stream_sse2(uint8_t *dst, int dst_pitch, const uint8_t *src,
+                     int src_pitch, int row_size, int height);
+
+void
+a2p_blit_avx2(uint8_t *dst, int dst_pitch, const uint8_t *src,
+              int src_pitch, int row_size, int height);
+
+void
+a2p_blit_stream_avx2(uint8_t *dst, int dst_pitch, const uint8_t *src,
+                     int src_pitch, int row_size, int height);
+
+#endif // BLIT_H
@@ -0,0 +1,131 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// built with -mavx2 by gcc, only called when the cpu reports avx2
+
+#include <string.h>
+#include "cpu.h"
+#include "blit.h"
+
+#ifdef A2P_HAVE_AVX2
+
+#include <immintrin.h>
+
+static void
+a2p_blit_row_avx2(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    __m256i a, b, c, d;
+    
+    for(; size >= 128; size -= 128) {
+        a = _mm256_loadu_si256((const __m256i *) (src +  0));
+        b = _mm256_loadu_si256((const __m256i *) (src + 32));
+        c = _mm256_loadu_si256((const __m256i *) (src + 64));
+        d = _mm256_loadu_si256((const __m256i *) (src + 96));
+        _mm256_storeu_si256((__m256i *) (dst +  0), a);
+        _mm256_storeu_si256((__m256i *) (dst + 32), b);
+        _mm256_storeu_si256((__m256i *) (dst + 64), c);
+        _mm256_storeu_si256((__m256i *) (dst + 96), d);
+        src += 128;
+        dst += 128;
+    }
+    for(; size >= 32; size -= 32) {
+        _mm256_storeu_si256((__m256i *) dst,
+                            _mm256_loadu_si256((const __m256i *) src));
+        src += 32;
+        dst += 32;
+    }
+    memcpy(dst, src, size);
+}
+
+static void
+a2p_blit_row_stream_avx2(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    __m256i a, b, c, d;
+    size_t head;
+    
+    // non-temporal stores need an aligned destination
+    head = (32 - ((uintptr_t) dst & 31)) & 31;
+    if(head > size) head = size;
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    size -= head;
+    
+    for(; size >= 128; size -= 128) {
+        a = _mm256_loadu_si256((const __m256i *) (src +  0));
+        b = _mm256_loadu_si256((const __m256i *) (src + 32));
+        c = _mm256_loadu_si256((const __m256i *) (src + 64));
+        d = _mm256_loadu_si256((const __m256i *) (src + 96));
+        _mm256_stream_si256((__m256i *) (dst +  0), a);
+        _mm256_stream_si256((__m256i *) (dst + 32), b);
+        _mm256_stream_si256((__m256i *) (dst + 64), c);
+        _mm256_stream_si256((__m256i *) (dst + 96), d);
+        src += 128;
+        dst += 128;
+    }
+    for(; size >= 32; size -= 32) {
+        _mm256_stream_si256((__m256i *) dst,
+                            _mm256_loadu_si256((const __m256i *) src));
+        src += 32;
+        dst += 32;
+    }
+    memcpy(dst, src, size);
+}
+
+void
+a2p_blit_avx2(uint8_t *dst, int dst_pitch, const uint8_t *src,
+              int src_pitch, int row_size, int height)
+{
+    int y;
+    
+    if(dst_pitch == row_size && src_pitch == row_size) {
+        a2p_blit_row_avx2(dst, src, (size_t) row_size * height);
+    } else {
+        for(y = 0; y < height; y++) {
+            a2p_blit_row_avx2(dst, src, row_size);
+            dst += dst_pitch;
+            src += src_pitch;
+        }
+    }
+    // avoid avx to sse transition stalls in the caller
+    _mm256_zeroupper();
+}
+
+void
+a2p_blit_stream_avx2(uint8_t *dst, int dst_pitch, const uint8_t *src,
+                     int src_pitch, int row_size, int height)
+{
+    int y;
+    
+    if(dst_pitch == row_size && src_pitch == row_size) {
+        a2p_blit_row_stream_avx2(dst, src, (size_t) row_size * height);
+    } else {
+        for(y = 0; y < height; y++) {
+            a2p_blit_row_stream_avx2(dst, src, row_size);
+            dst += dst_pitch;
+            src += src_pitch;
+        }
+    }
+    // make the streamed data visible before the buffer changes hands
+    _mm_sfence();
+    _mm256_zeroupper();
+}
+
+#endif // A2P_HAVE_AVX2
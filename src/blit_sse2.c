@@ -0,0 +1,122 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// built with -msse2 by gcc, only called when the cpu reports sse2
+
+#include <string.h>
+#include <emmintrin.h>
+#include "blit.h"
+
+static void
+a2p_blit_row_sse2(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    __m128i a, b, c, d;
+    
+    for(; size >= 64; size -= 64) {
+        a = _mm_loadu_si128((const __m128i *) (src +  0));
+        b = _mm_loadu_si128((const __m128i *) (src + 16));
+        c = _mm_loadu_si128((const __m128i *) (src + 32));
+        d = _mm_loadu_si128((const __m128i *) (src + 48));
+        _mm_storeu_si128((__m128i *) (dst +  0), a);
+        _mm_storeu_si128((__m128i *) (dst + 16), b);
+        _mm_storeu_si128((__m128i *) (dst + 32), c);
+        _mm_storeu_si128((__m128i *) (dst + 48), d);
+        src += 64;
+        dst += 64;
+    }
+    for(; size >= 16; size -= 16) {
+        _mm_storeu_si128((__m128i *) dst,
+                         _mm_loadu_si128((const __m128i *) src));
+        src += 16;
+        dst += 16;
+    }
+    memcpy(dst, src, size);
+}
+
+static void
+a2p_blit_row_stream_sse2(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    __m128i a, b, c, d;
+    size_t head;
+    
+    // non-temporal stores need an aligned destination
+    head = (16 - ((uintptr_t) dst & 15)) & 15;
+    if(head > size) head = size;
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    size -= head;
+    
+    for(; size >= 64; size -= 64) {
+        a = _mm_loadu_si128((const __m128i *) (src +  0));
+        b = _mm_loadu_si128((const __m128i *) (src + 16));
+        c = _mm_loadu_si128((const __m128i *) (src + 32));
+        d = _mm_loadu_si128((const __m128i *) (src + 48));
+        _mm_stream_si128((__m128i *) (dst +  0), a);
+        _mm_stream_si128((__m128i *) (dst + 16), b);
+        _mm_stream_si128((__m128i *) (dst + 32), c);
+        _mm_stream_si128((__m128i *) (dst + 48), d);
+        src += 64;
+        dst += 64;
+    }
+    for(; size >= 16; size -= 16) {
+        _mm_stream_si128((__m128i *) dst,
+                         _mm_loadu_si128((const __m128i *) src));
+        src += 16;
+        dst += 16;
+    }
+    memcpy(dst, src, size);
+}
+
+void
+a2p_blit_sse2(uint8_t *dst, int dst_pitch, const uint8_t *src,
+              int src_pitch, int row_size, int height)
+{
+    int y;
+    
+    if(dst_pitch == row_size && src_pitch == row_size) {
+        a2p_blit_row_sse2(dst, src, (size_t) row_size * height);
+        return;
+    }
+    for(y = 0; y < height; y++) {
+        a2p_blit_row_sse2(dst, src, row_size);
+        dst += dst_pitch;
+        src += src_pitch;
+    }
+}
+
+void
+a2p_blit_stream_sse2(uint8_t *dst, int dst_pitch, const uint8_t *src,
+                     int src_pitch, int row_size, int height)
+{
+    int y;
+    
+    if(dst_pitch == row_size && src_pitch == row_size) {
+        a2p_blit_row_stream_sse2(dst, src, (size_t) row_size * height);
+    } else {
+        for(y = 0; y < height; y++) {
+            a2p_blit_row_stream_sse2(dst, src, row_size);
+            dst += dst_pitch;
+            src += src_pitch;
+        }
+    }
+    // make the streamed data visible before the buffer changes hands
+    _mm_sfence();
+}
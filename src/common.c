@@ -21,12 +21,25 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <windows.h>
 #include "common.h"
 
+static A2pLogTrap *a2p_trap = NULL;
+static DWORD a2p_trap_thread = 0;
+
+void a2p_log_trap(A2pLogTrap *trap)
+{
+    a2p_trap_thread = GetCurrentThreadId();
+    a2p_trap = trap;
+}
+
 void a2p_log(int level, const char *message, ...)
 {
     char *prefix;
     va_list args;
+    A2pLogTrap *trap;
+    size_t length;
 
     va_start(args, message);
 
@@ -47,6 +60,21 @@ void a2p_log(int level, const char *message, ...)
             break;
     }
 
+    trap = a2p_trap;
+    if(level == A2P_LOG_ERROR && trap != NULL &&
+       a2p_trap_thread == GetCurrentThreadId()) {
+        _vsnprintf(trap->message, A2P_LOG_TRAP_MESSAGE, message, args);
+        va_end(args);
+        trap->message[A2P_LOG_TRAP_MESSAGE - 1] = '\0';
+        length = strlen(trap->message);
+        if(length > 0 && trap->message[length - 1] == '\n') {
+            trap->message[length - 1] = '\0';
+        }
+        a2p_trap = NULL;
+        fprintf(stderr, "avs2pipe [%s]: %s\n", prefix, trap->message);
+        longjmp(trap->jump, 1);
+    }
+
     // if(level == A2P_LOG_REPEAT) fprintf(stderr, "\r");
     fprintf(stderr, "avs2pipe [%s]: ", prefix);
     vfprintf(stderr, message, args);
@@ -21,6 +21,12 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <setjmp.h>
+
+#define A2P_LOG_TRAP_MESSAGE 1024
+
+typedef struct A2pLogTrap A2pLogTrap;
+
 enum A2pLogLevel {
     A2P_LOG_ERROR,
     A2P_LOG_WARNING,
@@ -28,6 +34,17 @@ enum A2pLogLevel {
     //A2P_LOG_REPEAT
 };
 
+// errors normally end the process, while a trap is set an error logged by
+// the thread that set it jumps back to its setjmp with the message instead,
+// so a server outlives one bad request
+struct A2pLogTrap {
+    jmp_buf     jump;
+    char        message[A2P_LOG_TRAP_MESSAGE]; // error without the newline
+};
+
 void a2p_log(int level, const char *message, ...);
 
+// traps the errors of the calling thread, NULL to clear
+void a2p_log_trap(A2pLogTrap *trap);
+
 #endif // COMMON_H
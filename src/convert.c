@@ -0,0 +1,305 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <windows.h>
+#include "common.h"
+#include "cpu.h"
+#include "deint.h"
+#include "pool.h"
+#include "convert.h"
+
+// stripes per pool thread, keeps threads busy when stripes differ in cost
+#define A2P_CONVERT_STRIPES 4
+
+struct A2pConvert {
+    A2pConvertSource    source;
+    int                 width;
+    int                 height;
+    int                 interlaced;     // chroma from rows of one field
+    A2pMatrix           matrix;
+    
+    A2pPool            *pool;
+    int                 stripe;         // luma rows per job, multiple of 4
+    int                 jobs;
+    uint8_t            *scratch;        // per job row buffers
+    size_t              scratch_size;
+    CRITICAL_SECTION    lock;
+    
+    // frame being converted
+    const uint8_t      *src[3];
+    int                 pitch[3];
+    uint8_t            *dst[3];
+};
+
+static A2pRgbToYFunc a2p_rgb_to_y;
+static A2pRgbToUvFunc a2p_rgb_to_uv420;
+static A2pChromaFunc a2p_chroma_444;
+static A2pChromaFunc a2p_chroma_422;
+
+static int
+a2p_round(double x)
+{
+    return (int) (x < 0 ? -floor(-x + 0.5) : floor(x + 0.5));
+}
+
+void
+a2p_matrix_init(A2pMatrix *m, int standard)
+{
+    double kr, kg, kb;
+    
+    if(standard == 709) {
+        kr = 0.2126;
+        kb = 0.0722;
+    } else {
+        kr = 0.299;
+        kb = 0.114;
+    }
+    kg = 1 - kr - kb;
+    
+    // limited range, luma 16-235 and chroma 16-240, rows sum exactly to
+    // the range so white and grey map without rounding drift
+    m->yr = a2p_round(kr * 219 / 255 * 16384);
+    m->yb = a2p_round(kb * 219 / 255 * 16384);
+    m->yg = a2p_round(219.0 / 255 * 16384) - m->yr - m->yb;
+    m->ur = a2p_round(-kr / (1 - kb) * 112 / 255 * 16384);
+    m->ug = a2p_round(-kg / (1 - kb) * 112 / 255 * 16384);
+    m->ub = -(m->ur + m->ug);
+    m->vg = a2p_round(-kg / (1 - kr) * 112 / 255 * 16384);
+    m->vb = a2p_round(-kb / (1 - kr) * 112 / 255 * 16384);
+    m->vr = -(m->vg + m->vb);
+}
+
+static void
+a2p_convert_select(void)
+{
+    int flags;
+    
+    flags = a2p_cpu_flags();
+    if(flags & A2P_CPU_SSE2) {
+        a2p_rgb_to_y = a2p_rgb_to_y_sse2;
+        a2p_rgb_to_uv420 = a2p_rgb_to_uv420_sse2;
+        a2p_chroma_444 = a2p_chroma_444_sse2;
+        a2p_chroma_422 = a2p_chroma_422_sse2;
+    } else {
+        a2p_rgb_to_y = a2p_rgb_to_y_c;
+        a2p_rgb_to_uv420 = a2p_rgb_to_uv420_c;
+        a2p_chroma_444 = a2p_chroma_444_c;
+        a2p_chroma_422 = a2p_chroma_422_c;
+    }
+}
+
+static void
+a2p_convert_rows(void *data, int job)
+{
+    A2pConvert *cv = data;
+    const uint8_t *src0, *src1;
+    uint8_t *a[3], *b[3], *y0, *y1, *u, *v;
+    int w, cw, cy, cy0, cy1, la, lb, p;
+    
+    w = cv->width;
+    cw = w / 2;
+    for(p = 0; p < 3; p++) {
+        a[p] = cv->scratch + job * cv->scratch_size + p * w;
+        b[p] = a[p] + 3 * w;
+    }
+    
+    cy0 = job * cv->stripe / 2;
+    cy1 = (job + 1) * cv->stripe;
+    cy1 = (cy1 < cv->height ? cy1 : cv->height) / 2;
+    for(cy = cy0; cy < cy1; cy++) {
+        // the two luma rows this chroma row is made from
+        if(cv->interlaced) {
+            la = (cy / 2) * 4 + cy % 2;
+            lb = la + 2;
+        } else {
+            la = cy * 2;
+            lb = la + 1;
+        }
+        y0 = cv->dst[0] + la * w;
+        y1 = cv->dst[0] + lb * w;
+        u = cv->dst[1] + cy * cw;
+        v = cv->dst[2] + cy * cw;
+        src0 = cv->src[0] + la * cv->pitch[0];
+        src1 = cv->src[0] + lb * cv->pitch[0];
+        
+        switch(cv->source) {
+            case A2P_CONVERT_BGR24:
+            case A2P_CONVERT_BGR32:
+                if(cv->source == A2P_CONVERT_BGR24) {
+                    a2p_deint_bgr24(a[0], a[1], a[2], src0, w);
+                    a2p_deint_bgr24(b[0], b[1], b[2], src1, w);
+                } else {
+                    a2p_deint_bgr32(a[0], a[1], a[2], src0, w);
+                    a2p_deint_bgr32(b[0], b[1], b[2], src1, w);
+                }
+                a2p_rgb_to_y(y0, a[0], a[1], a[2], w, &cv->matrix);
+                a2p_rgb_to_y(y1, b[0], b[1], b[2], w, &cv->matrix);
+                a2p_rgb_to_uv420(u, v, a[0], a[1], a[2], b[0], b[1], b[2], w,
+                                 &cv->matrix);
+                break;
+            case A2P_CONVERT_YUY2:
+                a2p_deint_yuy2(y0, a[1], a[2], src0, w);
+                a2p_deint_yuy2(y1, b[1], b[2], src1, w);
+                a2p_chroma_422(u, a[1], b[1], cw);
+                a2p_chroma_422(v, a[2], b[2], cw);
+                break;
+            case A2P_CONVERT_YV16:
+            case A2P_CONVERT_YV24:
+            default:
+                memcpy(y0, src0, w);
+                memcpy(y1, src1, w);
+                for(p = 1; p < 3; p++) {
+                    src0 = cv->src[p] + la * cv->pitch[p];
+                    src1 = cv->src[p] + lb * cv->pitch[p];
+                    if(cv->source == A2P_CONVERT_YV16) {
+                        a2p_chroma_422(p == 1 ? u : v, src0, src1, cw);
+                    } else {
+                        a2p_chroma_444(p == 1 ? u : v, src0, src1, w);
+                    }
+                }
+                break;
+        }
+    }
+}
+
+A2pConvert *
+a2p_convert_create(A2pConvertSource source, int width, int height,
+                   int interlaced, int standard, int threads)
+{
+    A2pConvert *cv;
+    int parts;
+    
+    if(width % 2 || height % (interlaced ? 4 : 2)) {
+        a2p_log(A2P_LOG_ERROR, "%dx%d %s video can not be made 4:2:0.\n",
+                width, height, interlaced ? "interlaced" : "progressive");
+    }
+    
+    a2p_convert_select();
+    
+    cv = malloc(sizeof(*cv));
+    if(cv == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate conversion state.\n");
+    }
+    cv->source = source;
+    cv->width = width;
+    cv->height = height;
+    cv->interlaced = interlaced;
+    a2p_matrix_init(&cv->matrix, standard);
+    
+    cv->pool = a2p_pool_create(threads);
+    parts = a2p_pool_threads(cv->pool) * A2P_CONVERT_STRIPES;
+    cv->stripe = ((height + parts - 1) / parts + 3) & ~3;
+    if(cv->stripe < 16) cv->stripe = 16;
+    cv->jobs = (height + cv->stripe - 1) / cv->stripe;
+    
+    // two rows of three planes for the packed sources
+    cv->scratch_size = 6 * width;
+    cv->scratch = malloc(cv->jobs * cv->scratch_size);
+    if(cv->scratch == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate conversion buffers.\n");
+    }
+    InitializeCriticalSection(&cv->lock);
+    
+    a2p_log(A2P_LOG_INFO, "converting video to 4:2:0 on %d threads.\n",
+            a2p_pool_threads(cv->pool));
+    
+    return cv;
+}
+
+void
+a2p_convert_frame(A2pConvert *cv, const uint8_t *const src[3],
+                  const int pitch[3], uint8_t *const dst[3])
+{
+    int p;
+    
+    EnterCriticalSection(&cv->lock);
+    for(p = 0; p < 3; p++) {
+        cv->src[p] = src[p];
+        cv->pitch[p] = pitch[p];
+        cv->dst[p] = dst[p];
+    }
+    a2p_pool_run(cv->pool, a2p_convert_rows, cv, cv->jobs);
+    LeaveCriticalSection(&cv->lock);
+}
+
+void
+a2p_convert_destroy(A2pConvert *cv)
+{
+    a2p_pool_destroy(cv->pool);
+    DeleteCriticalSection(&cv->lock);
+    free(cv->scratch);
+    free(cv);
+}
+
+void
+a2p_rgb_to_y_c(uint8_t *y, const uint8_t *g, const uint8_t *b,
+               const uint8_t *r, int width, const A2pMatrix *m)
+{
+    int x;
+    
+    for(x = 0; x < width; x++) {
+        y[x] = (m->yr * r[x] + m->yg * g[x] + m->yb * b[x]
+                + (16 << 14) + (1 << 13)) >> 14;
+    }
+}
+
+void
+a2p_rgb_to_uv420_c(uint8_t *u, uint8_t *v, const uint8_t *g0,
+                   const uint8_t *b0, const uint8_t *r0, const uint8_t *g1,
+                   const uint8_t *b1, const uint8_t *r1, int width,
+                   const A2pMatrix *m)
+{
+    int x, gs, bs, rs, c;
+    
+    for(x = 0; x < width / 2; x++) {
+        gs = A2P_SUM121(g0, g1, x);
+        bs = A2P_SUM121(b0, b1, x);
+        rs = A2P_SUM121(r0, r1, x);
+        c = (m->ur * rs + m->ug * gs + m->ub * bs + (128 << 17) + (1 << 16)) >> 17;
+        u[x] = A2P_CLIP_UINT8(c);
+        c = (m->vr * rs + m->vg * gs + m->vb * bs + (128 << 17) + (1 << 16)) >> 17;
+        v[x] = A2P_CLIP_UINT8(c);
+    }
+}
+
+void
+a2p_chroma_444_c(uint8_t *dst, const uint8_t *row0, const uint8_t *row1,
+                 int width)
+{
+    int x;
+    
+    for(x = 0; x < width / 2; x++) {
+        dst[x] = (A2P_SUM121(row0, row1, x) + 4) >> 3;
+    }
+}
+
+void
+a2p_chroma_422_c(uint8_t *dst, const uint8_t *row0, const uint8_t *row1,
+                 int width)
+{
+    int x;
+    
+    for(x = 0; x < width; x++) {
+        dst[x] = (row0[x] + row1[x] + 1) >> 1;
+    }
+}
@@ -0,0 +1,126 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Native colorspace conversion to 4:2:0 planar, used instead of
+// ConvertToYV12. Frames are split into row stripes run on a thread pool.
+// RGB uses a limited range BT.601 or BT.709 matrix, chroma is filtered
+// [1 2 1] horizontally (MPEG-2 siting) and averaged within each field.
+
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#include <stdint.h>
+
+typedef enum A2pConvertSource A2pConvertSource;
+typedef struct A2pMatrix A2pMatrix;
+typedef struct A2pConvert A2pConvert;
+
+enum A2pConvertSource {
+    A2P_CONVERT_NONE = -1,
+    A2P_CONVERT_BGR24,              // packed, pass top row, negative pitch
+    A2P_CONVERT_BGR32,
+    A2P_CONVERT_YUY2,
+    A2P_CONVERT_YV16,               // planar Y, U, V
+    A2P_CONVERT_YV24
+};
+
+// 14 bit fixed point coefficients, see a2p_matrix_init
+struct A2pMatrix {
+    int16_t yr, yg, yb;
+    int16_t ur, ug, ub;
+    int16_t vr, vg, vb;
+};
+
+void
+a2p_matrix_init(A2pMatrix *matrix, int standard);
+
+A2pConvert *
+a2p_convert_create(A2pConvertSource source, int width, int height,
+                   int interlaced, int standard, int threads);
+
+// dst is 4:2:0 planar Y, U, V without padding, safe to call from several
+// threads but frames are converted one at a time
+void
+a2p_convert_frame(A2pConvert *convert, const uint8_t *const src[3],
+                  const int pitch[3], uint8_t *const dst[3]);
+
+void
+a2p_convert_destroy(A2pConvert *convert);
+
+// [1 2 1] around even sample 2x of both rows, 8 times the average,
+// the left edge repeats the first sample
+#define A2P_SUM121(c0, c1, x) \
+    ((c0)[(x) ? 2 * (x) - 1 : 0] + 2 * (c0)[2 * (x)] + (c0)[2 * (x) + 1] + \
+     (c1)[(x) ? 2 * (x) - 1 : 0] + 2 * (c1)[2 * (x)] + (c1)[2 * (x) + 1])
+
+#define A2P_CLIP_UINT8(x) ((x) < 0 ? 0 : (x) > 255 ? 255 : (x))
+
+// row kernels, only call the simd ones when a2p_cpu_flags reports support
+typedef void (*A2pRgbToYFunc)(uint8_t *y, const uint8_t *g, const uint8_t *b,
+                              const uint8_t *r, int width,
+                              const A2pMatrix *m);
+typedef void (*A2pRgbToUvFunc)(uint8_t *u, uint8_t *v,
+                               const uint8_t *g0, const uint8_t *b0,
+                               const uint8_t *r0, const uint8_t *g1,
+                               const uint8_t *b1, const uint8_t *r1,
+                               int width, const A2pMatrix *m);
+typedef void (*A2pChromaFunc)(uint8_t *dst, const uint8_t *row0,
+                              const uint8_t *row1, int width);
+
+void
+a2p_rgb_to_y_c(uint8_t *y, const uint8_t *g, const uint8_t *b,
+               const uint8_t *r, int width, const A2pMatrix *m);
+
+void
+a2p_rgb_to_y_sse2(uint8_t *y, const uint8_t *g, const uint8_t *b,
+                  const uint8_t *r, int width, const A2pMatrix *m);
+
+// width is the luma width, width / 2 samples are written
+void
+a2p_rgb_to_uv420_c(uint8_t *u, uint8_t *v, const uint8_t *g0,
+                   const uint8_t *b0, const uint8_t *r0, const uint8_t *g1,
+                   const uint8_t *b1, const uint8_t *r1, int width,
+                   const A2pMatrix *m);
+
+void
+a2p_rgb_to_uv420_sse2(uint8_t *u, uint8_t *v, const uint8_t *g0,
+                      const uint8_t *b0, const uint8_t *r0,
+                      const uint8_t *g1, const uint8_t *b1,
+                      const uint8_t *r1, int width, const A2pMatrix *m);
+
+// 4:4:4 chroma rows to one 4:2:0 row, width is the source width
+void
+a2p_chroma_444_c(uint8_t *dst, const uint8_t *row0, const uint8_t *row1,
+                 int width);
+
+void
+a2p_chroma_444_sse2(uint8_t *dst, const uint8_t *row0, const uint8_t *row1,
+                    int width);
+
+// 4:2:2 chroma rows to one 4:2:0 row, width is the chroma width
+void
+a2p_chroma_422_c(uint8_t *dst, const uint8_t *row0, const uint8_t *row1,
+                 int width);
+
+void
+a2p_chroma_422_sse2(uint8_t *dst, const uint8_t *row0, const uint8_t *row1,
+                    int width);
+
+#endif // CONVERT_H
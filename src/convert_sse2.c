@@ -0,0 +1,168 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// built with -msse2 by gcc, only called when the cpu reports sse2
+
+#include <emmintrin.h>
+#include "convert.h"
+
+void
+a2p_rgb_to_y_sse2(uint8_t *y, const uint8_t *g, const uint8_t *b,
+                  const uint8_t *r, int width, const A2pMatrix *m)
+{
+    __m128i zero, crg, cb, off, gv, bv, rv, lo, hi, res[4], rg, b1;
+    int x, i;
+    
+    zero = _mm_setzero_si128();
+    crg = _mm_setr_epi16(m->yr, m->yg, m->yr, m->yg,
+                         m->yr, m->yg, m->yr, m->yg);
+    cb = _mm_setr_epi16(m->yb, 0, m->yb, 0, m->yb, 0, m->yb, 0);
+    off = _mm_set1_epi32((16 << 14) + (1 << 13));
+    
+    // 16 pixels per loop, 4 groups of 4 in 32 bit lanes
+    for(x = 0; x + 16 <= width; x += 16) {
+        gv = _mm_loadu_si128((const __m128i *) (g + x));
+        bv = _mm_loadu_si128((const __m128i *) (b + x));
+        rv = _mm_loadu_si128((const __m128i *) (r + x));
+        for(i = 0; i < 2; i++) {
+            lo = i ? _mm_unpackhi_epi8(rv, zero) : _mm_unpacklo_epi8(rv, zero);
+            hi = i ? _mm_unpackhi_epi8(gv, zero) : _mm_unpacklo_epi8(gv, zero);
+            b1 = i ? _mm_unpackhi_epi8(bv, zero) : _mm_unpacklo_epi8(bv, zero);
+            
+            rg = _mm_unpacklo_epi16(lo, hi);
+            res[2 * i] = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg, crg),
+                _mm_madd_epi16(_mm_unpacklo_epi16(b1, zero), cb)), off);
+            rg = _mm_unpackhi_epi16(lo, hi);
+            res[2 * i + 1] = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg, crg),
+                _mm_madd_epi16(_mm_unpackhi_epi16(b1, zero), cb)), off);
+        }
+        for(i = 0; i < 4; i++) {
+            res[i] = _mm_srai_epi32(res[i], 14);
+        }
+        _mm_storeu_si128((__m128i *) (y + x), _mm_packus_epi16(
+            _mm_packs_epi32(res[0], res[1]), _mm_packs_epi32(res[2], res[3])));
+    }
+    a2p_rgb_to_y_c(y + x, g + x, b + x, r + x, width - x, m);
+}
+
+// 8 sums of [1 2 1] around even samples 2x .. 2x + 14 of both rows
+static __m128i
+a2p_sum121_sse2(const uint8_t *row0, const uint8_t *row1, int x)
+{
+    __m128i mask, a, b, even, odd, left;
+    int edge;
+    
+    mask = _mm_set1_epi16(0x00ff);
+    a = _mm_loadu_si128((const __m128i *) (row0 + 2 * x));
+    b = _mm_loadu_si128((const __m128i *) (row1 + 2 * x));
+    even = _mm_add_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+    odd = _mm_add_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+    // left neighbours are the odd samples one lane down
+    edge = x ? row0[2 * x - 1] + row1[2 * x - 1] : row0[0] + row1[0];
+    left = _mm_or_si128(_mm_slli_si128(odd, 2), _mm_cvtsi32_si128(edge));
+    
+    return _mm_add_epi16(_mm_add_epi16(left, odd), _mm_slli_epi16(even, 1));
+}
+
+static __m128i
+a2p_uv_sse2(__m128i rs, __m128i gs, __m128i bs, __m128i crg, __m128i cb,
+            __m128i off)
+{
+    __m128i zero, lo, hi;
+    
+    zero = _mm_setzero_si128();
+    lo = _mm_add_epi32(_mm_add_epi32(
+        _mm_madd_epi16(_mm_unpacklo_epi16(rs, gs), crg),
+        _mm_madd_epi16(_mm_unpacklo_epi16(bs, zero), cb)), off);
+    hi = _mm_add_epi32(_mm_add_epi32(
+        _mm_madd_epi16(_mm_unpackhi_epi16(rs, gs), crg),
+        _mm_madd_epi16(_mm_unpackhi_epi16(bs, zero), cb)), off);
+    
+    return _mm_packs_epi32(_mm_srai_epi32(lo, 17), _mm_srai_epi32(hi, 17));
+}
+
+void
+a2p_rgb_to_uv420_sse2(uint8_t *u, uint8_t *v, const uint8_t *g0,
+                      const uint8_t *b0, const uint8_t *r0,
+                      const uint8_t *g1, const uint8_t *b1,
+                      const uint8_t *r1, int width, const A2pMatrix *m)
+{
+    __m128i urg, ub, vrg, vb, off, gs, bs, rs, cu, cv;
+    int x, c;
+    
+    urg = _mm_setr_epi16(m->ur, m->ug, m->ur, m->ug,
+                         m->ur, m->ug, m->ur, m->ug);
+    ub = _mm_setr_epi16(m->ub, 0, m->ub, 0, m->ub, 0, m->ub, 0);
+    vrg = _mm_setr_epi16(m->vr, m->vg, m->vr, m->vg,
+                         m->vr, m->vg, m->vr, m->vg);
+    vb = _mm_setr_epi16(m->vb, 0, m->vb, 0, m->vb, 0, m->vb, 0);
+    off = _mm_set1_epi32((128 << 17) + (1 << 16));
+    
+    // 8 chroma samples from 16 pixels of each row per loop
+    for(x = 0; 2 * x + 16 <= width; x += 8) {
+        gs = a2p_sum121_sse2(g0, g1, x);
+        bs = a2p_sum121_sse2(b0, b1, x);
+        rs = a2p_sum121_sse2(r0, r1, x);
+        cu = a2p_uv_sse2(rs, gs, bs, urg, ub, off);
+        cv = a2p_uv_sse2(rs, gs, bs, vrg, vb, off);
+        _mm_storel_epi64((__m128i *) (u + x), _mm_packus_epi16(cu, cu));
+        _mm_storel_epi64((__m128i *) (v + x), _mm_packus_epi16(cv, cv));
+    }
+    for(; x < width / 2; x++) {
+        c = (m->ur * A2P_SUM121(r0, r1, x) + m->ug * A2P_SUM121(g0, g1, x)
+             + m->ub * A2P_SUM121(b0, b1, x) + (128 << 17) + (1 << 16)) >> 17;
+        u[x] = A2P_CLIP_UINT8(c);
+        c = (m->vr * A2P_SUM121(r0, r1, x) + m->vg * A2P_SUM121(g0, g1, x)
+             + m->vb * A2P_SUM121(b0, b1, x) + (128 << 17) + (1 << 16)) >> 17;
+        v[x] = A2P_CLIP_UINT8(c);
+    }
+}
+
+void
+a2p_chroma_444_sse2(uint8_t *dst, const uint8_t *row0, const uint8_t *row1,
+                    int width)
+{
+    __m128i round, sum;
+    int x;
+    
+    round = _mm_set1_epi16(4);
+    for(x = 0; 2 * x + 16 <= width; x += 8) {
+        sum = _mm_srli_epi16(_mm_add_epi16(a2p_sum121_sse2(row0, row1, x),
+                                           round), 3);
+        _mm_storel_epi64((__m128i *) (dst + x), _mm_packus_epi16(sum, sum));
+    }
+    for(; x < width / 2; x++) {
+        dst[x] = (A2P_SUM121(row0, row1, x) + 4) >> 3;
+    }
+}
+
+void
+a2p_chroma_422_sse2(uint8_t *dst, const uint8_t *row0, const uint8_t *row1,
+                    int width)
+{
+    int x;
+    
+    for(x = 0; x + 16 <= width; x += 16) {
+        _mm_storeu_si128((__m128i *) (dst + x), _mm_avg_epu8(
+            _mm_loadu_si128((const __m128i *) (row0 + x)),
+            _mm_loadu_si128((const __m128i *) (row1 + x))));
+    }
+    a2p_chroma_422_c(dst + x, row0 + x, row1 + x, width - x);
+}
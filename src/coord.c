@@ -0,0 +1,534 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include <process.h>
+#include "avs2pipe.h"
+#include "common.h"
+#include "lz4.h"
+#include "net.h"
+#include "writer.h"
+#include "coord.h"
+
+#define A2P_COORD_WAIT      100     // ms between looks at idle state
+
+typedef enum A2pCoordState A2pCoordState;
+typedef struct A2pCoordChunk A2pCoordChunk;
+typedef struct A2pCoord A2pCoord;
+typedef struct A2pCoordWorker A2pCoordWorker;
+
+enum A2pCoordState {
+    A2P_CHUNK_PENDING,
+    A2P_CHUNK_RUNNING,
+    A2P_CHUNK_DONE
+};
+
+struct A2pCoordChunk {
+    int64_t             start;      // frames or samples of the script
+    int64_t             count;
+    int64_t             received;   // only its worker moves it on
+    int64_t             flushed;    // written to the in order output
+    A2pCoordState       state;
+    int                 tries;
+    BYTE               *data;       // in order output, the whole chunk
+    FILE               *file;       // file per chunk output
+};
+
+struct A2pCoord {
+    const A2pCoordTask *task;
+    char                path[MAX_PATH]; // script, as the workers load it
+    CRITICAL_SECTION    lock;
+    A2pCoordChunk      *chunks;
+    int                 chunks_num;
+    int                 head;       // first chunk not completely written
+    int                 done;       // chunks completely received
+    int                 workers;    // connected
+    int                 respawn;    // local workers to start again
+    int64_t             written;
+    int                 failed;     // writing the output failed
+    HANDLE              finished;   // every chunk written, or failed
+};
+
+struct A2pCoordWorker {
+    A2pCoord           *coord;
+    A2pNet             *net;
+    int                 id;
+};
+
+// writes what has arrived of the chunks at the head, in order
+static void
+a2p_coord_flush(A2pCoord *c)
+{
+    A2pCoordChunk *chunk;
+    size_t bytes;
+    
+    while(c->head < c->chunks_num && !c->failed) {
+        chunk = &c->chunks[c->head];
+        if(chunk->received > chunk->flushed) {
+            bytes = (size_t) (chunk->received - chunk->flushed) * c->task->size;
+            if(fwrite(chunk->data + chunk->flushed * c->task->size, 1, bytes,
+                      c->task->out) != bytes) {
+                c->failed = 1;
+                break;
+            }
+            c->written += chunk->received - chunk->flushed;
+            chunk->flushed = chunk->received;
+        }
+        if(chunk->flushed < chunk->count) return;
+        free(chunk->data);
+        chunk->data = NULL;
+        c->head++;
+    }
+    SetEvent(c->finished);
+}
+
+// next chunk for a worker, chunks are only started a few past the head
+// so that a slow worker does not leave the others buffering everything
+static A2pCoordChunk *
+a2p_coord_claim(A2pCoord *c)
+{
+    A2pCoordChunk *chunk;
+    char path[MAX_PATH];
+    void *header;
+    size_t header_size;
+    int i, first, last;
+    
+    first = c->task->pattern != NULL ? 0 : c->head;
+    last = c->task->pattern != NULL ? c->chunks_num :
+           c->head + c->workers + 1;
+    for(i = first; i < c->chunks_num && i < last; i++) {
+        chunk = &c->chunks[i];
+        if(chunk->state != A2P_CHUNK_PENDING) continue;
+        if(++chunk->tries > A2P_COORD_TRIES) {
+            a2p_log(A2P_LOG_ERROR, "%d workers died on %I64d to %I64d, "
+                    "giving up.\n", A2P_COORD_TRIES, chunk->start,
+                    chunk->start + chunk->count - 1);
+        }
+        chunk->state = A2P_CHUNK_RUNNING;
+        if(chunk->tries > 1) return chunk;
+        
+        // a retry carries on where the chunk stopped
+        if(c->task->pattern != NULL) {
+            // units keep the name within an int, samples would not
+            _snprintf(path, MAX_PATH, c->task->pattern,
+                      (int) (chunk->start / c->task->unit));
+            path[MAX_PATH - 1] = '\0';
+            chunk->file = fopen(path, "wb");
+            if(chunk->file == NULL) {
+                a2p_log(A2P_LOG_ERROR, "cannot open %s for writing.\n", path);
+            }
+            if(c->task->file_header != NULL) {
+                // sized for this chunk, not the whole stream
+                header = c->task->file_header(c->task->file_header_data,
+                                              chunk->count, &header_size);
+                fwrite(header, 1, header_size, chunk->file);
+                free(header);
+            } else {
+                fwrite(c->task->header, 1, c->task->header_size, chunk->file);
+            }
+        } else {
+            chunk->data = malloc((size_t) chunk->count * c->task->size);
+            if(chunk->data == NULL) {
+                a2p_log(A2P_LOG_ERROR, "could not allocate chunk buffer.\n");
+            }
+        }
+        return chunk;
+    }
+    
+    return NULL;
+}
+
+static unsigned __stdcall
+a2p_coord_serve(void *data)
+{
+    A2pCoordWorker *w = data;
+    A2pCoord *c = w->coord;
+    const A2pCoordTask *task = c->task;
+    A2pCoordChunk *chunk;
+    A2pNetHello hello;
+    A2pNetPacket packet;
+    A2pCoordJob job;
+    BYTE *payload, *scratch, *dst;
+    int64_t count;
+    size_t size;
+    
+    chunk = NULL;
+    payload = malloc(a2p_net_bound((size_t) task->unit * task->size));
+    scratch = malloc((size_t) task->unit * task->size);
+    if(payload == NULL || scratch == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate packet buffer.\n");
+    }
+    if(!a2p_net_recv(w->net, &hello, sizeof(hello)) ||
+       hello.magic != A2P_NET_MAGIC || hello.version != A2P_NET_VERSION) {
+        a2p_log(A2P_LOG_WARNING, "worker %d is not an avs2pipe worker.\n",
+                w->id);
+        goto gone;
+    }
+    
+    memset(&job, 0, sizeof(job));
+    job.op = task->op;
+    job.path_size = (uint32_t) strlen(c->path);
+    job.unit = task->unit;
+    job.lz4 = task->lz4;
+    job.options = *task->options;
+    for(;;) {
+        // an idle worker stays, a running chunk may yet need it
+        EnterCriticalSection(&c->lock);
+        while((chunk = a2p_coord_claim(c)) == NULL &&
+              c->done < c->chunks_num && !c->failed) {
+            LeaveCriticalSection(&c->lock);
+            Sleep(A2P_COORD_WAIT);
+            EnterCriticalSection(&c->lock);
+        }
+        LeaveCriticalSection(&c->lock);
+        if(chunk == NULL) break;
+        
+        job.start = chunk->start + chunk->received;
+        job.count = chunk->count - chunk->received;
+        if(!a2p_net_send(w->net, &job, sizeof(job)) ||
+           !a2p_net_send(w->net, c->path, job.path_size)) {
+            goto died;
+        }
+        while(chunk->received < chunk->count && !c->failed) {
+            count = chunk->count - chunk->received;
+            if(count > task->unit) count = task->unit;
+            size = (size_t) count * task->size;
+            if(!a2p_net_recv(w->net, &packet, sizeof(packet))) goto died;
+            if(packet.size != size || packet.packed > a2p_net_bound(size)) {
+                a2p_log(A2P_LOG_ERROR, "worker %d sent %u bytes instead of "
+                        "%u, is it the same build?\n", w->id, packet.size,
+                        (unsigned) size);
+            }
+            dst = task->pattern != NULL ? scratch :
+                  chunk->data + chunk->received * task->size;
+            if(!a2p_net_recv(w->net, payload, packet.packed)) goto died;
+            if(!a2p_net_unpack(dst, &packet, payload)) {
+                a2p_log(A2P_LOG_WARNING, "worker %d sent a corrupt packet.\n",
+                        w->id);
+                goto died;
+            }
+            
+            EnterCriticalSection(&c->lock);
+            if(task->pattern != NULL &&
+               fwrite(scratch, 1, size, chunk->file) != size) {
+                c->failed = 1;
+                SetEvent(c->finished);
+            }
+            chunk->received += count;
+            if(task->pattern == NULL) a2p_coord_flush(c);
+            if(chunk->received == chunk->count) {
+                chunk->state = A2P_CHUNK_DONE;
+                c->done++;
+                if(task->pattern != NULL) {
+                    if(fclose(chunk->file) != 0) c->failed = 1;
+                    chunk->file = NULL;
+                    c->written += chunk->count;
+                    if(c->done == c->chunks_num || c->failed) {
+                        SetEvent(c->finished);
+                    }
+                }
+            }
+            LeaveCriticalSection(&c->lock);
+        }
+    }
+    job.op = A2P_COORD_END;
+    job.path_size = 0;
+    a2p_net_send(w->net, &job, sizeof(job));
+    goto gone;
+    
+died:
+    // the frames received so far are kept, the rest go to another worker
+    a2p_log(A2P_LOG_WARNING, "worker %d died, %I64d to %I64d go to the next "
+            "worker.\n", w->id, chunk->start + chunk->received,
+            chunk->start + chunk->count - 1);
+    EnterCriticalSection(&c->lock);
+    chunk->state = A2P_CHUNK_PENDING;
+    if(task->spawn > 0) c->respawn++;
+    LeaveCriticalSection(&c->lock);
+    
+gone:
+    EnterCriticalSection(&c->lock);
+    c->workers--;
+    LeaveCriticalSection(&c->lock);
+    a2p_net_close(w->net);
+    free(scratch);
+    free(payload);
+    free(w);
+    
+    return 0;
+}
+
+// starts this executable as a worker connecting to address
+static HANDLE
+a2p_coord_spawn(const char *address)
+{
+    STARTUPINFOA startup;
+    PROCESS_INFORMATION process;
+    char exe[MAX_PATH], command[2 * MAX_PATH];
+    
+    if(GetModuleFileNameA(NULL, exe, MAX_PATH) == 0) {
+        a2p_log(A2P_LOG_ERROR, "cannot find avs2pipe to start workers.\n");
+    }
+    _snprintf(command, sizeof(command), "\"%s\" worker %s", exe, address);
+    command[sizeof(command) - 1] = '\0';
+    
+    // stdout is the stream being written, workers only get stderr
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    startup.hStdOutput = GetStdHandle(STD_ERROR_HANDLE);
+    startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    if(!CreateProcessA(NULL, command, NULL, NULL, TRUE, 0, NULL, NULL,
+                       &startup, &process)) {
+        a2p_log(A2P_LOG_ERROR, "could not start a worker process.\n");
+    }
+    CloseHandle(process.hThread);
+    
+    return process.hProcess;
+}
+
+int64_t
+a2p_coord_run(const A2pCoordTask *task)
+{
+    A2pCoord c;
+    A2pCoordWorker *w;
+    A2pNet *listener, *net;
+    HANDLE *threads, *processes;
+    char local[MAX_PATH];
+    int64_t chunk;
+    int i, threads_num, processes_num, respawn, connected;
+    
+    c.task = task;
+    if(GetFullPathNameA(task->script, MAX_PATH, c.path, NULL) == 0) {
+        a2p_log(A2P_LOG_ERROR, "cannot find the full path of %s.\n",
+                task->script);
+    }
+    InitializeCriticalSection(&c.lock);
+    chunk = task->unit * task->chunk;
+    c.chunks_num = (int) ((task->count + chunk - 1) / chunk);
+    c.chunks = calloc(c.chunks_num, sizeof(*c.chunks));
+    threads = NULL;
+    processes = NULL;
+    if(c.chunks == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate chunk state.\n");
+    }
+    for(i = 0; i < c.chunks_num; i++) {
+        c.chunks[i].start = task->start + i * chunk;
+        c.chunks[i].count = task->count - i * chunk < chunk ?
+                            task->count - i * chunk : chunk;
+    }
+    c.head = 0;
+    c.done = 0;
+    c.workers = 0;
+    c.respawn = task->spawn;
+    c.written = 0;
+    c.failed = 0;
+    c.finished = CreateEvent(NULL, TRUE, c.chunks_num == 0, NULL);
+    if(c.finished == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not create coordinator event.\n");
+    }
+    
+    // local workers connect through loopback whatever was listened on
+    if(task->address[0] == ':') {
+        _snprintf(local, MAX_PATH, "127.0.0.1%s", task->address);
+    } else if(strncmp(task->address, "0.0.0.0:", 8) == 0) {
+        _snprintf(local, MAX_PATH, "127.0.0.1%s", task->address + 7);
+    } else {
+        _snprintf(local, MAX_PATH, "%s", task->address);
+    }
+    local[MAX_PATH - 1] = '\0';
+    
+    if(task->pattern == NULL) {
+        fwrite(task->header, 1, task->header_size, task->out);
+    }
+    listener = a2p_net_listen(task->address);
+    a2p_log(A2P_LOG_INFO, "handing out %d chunks of %d on %s.\n",
+            c.chunks_num, task->chunk, task->address);
+    threads_num = 0;
+    processes_num = 0;
+    connected = 0;
+    while(WaitForSingleObject(c.finished, 0) == WAIT_TIMEOUT) {
+        EnterCriticalSection(&c.lock);
+        respawn = c.respawn;
+        c.respawn = 0;
+        LeaveCriticalSection(&c.lock);
+        for(; respawn > 0; respawn--) {
+            processes = realloc(processes, (processes_num + 1) *
+                                           sizeof(*processes));
+            if(processes == NULL) {
+                a2p_log(A2P_LOG_ERROR, "could not allocate worker state.\n");
+            }
+            processes[processes_num++] = a2p_coord_spawn(local);
+        }
+        
+        if(!a2p_net_wait(listener, A2P_COORD_WAIT)) continue;
+        net = a2p_net_accept(listener);
+        if(net == NULL) continue;
+        w = malloc(sizeof(*w));
+        threads = realloc(threads, (threads_num + 1) * sizeof(*threads));
+        if(w == NULL || threads == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not allocate worker state.\n");
+        }
+        w->coord = &c;
+        w->net = net;
+        w->id = ++connected;
+        EnterCriticalSection(&c.lock);
+        c.workers++;
+        LeaveCriticalSection(&c.lock);
+        threads[threads_num] = (HANDLE) _beginthreadex(NULL, 0,
+                                                       a2p_coord_serve, w, 0,
+                                                       NULL);
+        if(threads[threads_num] == 0) {
+            a2p_log(A2P_LOG_ERROR, "could not start worker thread.\n");
+        }
+        threads_num++;
+        a2p_log(A2P_LOG_INFO, "worker %d connected.\n", w->id);
+    }
+    a2p_net_close(listener);
+    
+    for(i = 0; i < threads_num; i++) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+    // workers leave once told there is no more, one that hangs is stopped
+    for(i = 0; i < processes_num; i++) {
+        if(WaitForSingleObject(processes[i], 10000) == WAIT_TIMEOUT) {
+            TerminateProcess(processes[i], 1);
+        }
+        CloseHandle(processes[i]);
+    }
+    for(i = 0; i < c.chunks_num; i++) {
+        if(c.chunks[i].file != NULL) fclose(c.chunks[i].file);
+        free(c.chunks[i].data);
+    }
+    fflush(task->out);
+    
+    CloseHandle(c.finished);
+    DeleteCriticalSection(&c.lock);
+    free(processes);
+    free(threads);
+    free(c.chunks);
+    
+    return c.written;
+}
+
+void
+a2p_coord_work(const char *address)
+{
+    A2pNetHello hello;
+    A2pCoordJob job;
+    A2pNet *net;
+    A2pWriter *writer;
+    AVS_ScriptEnvironment *env;
+    AVS_Clip *clip;
+    AVS_VideoFrame *frame;
+    const AVS_VideoInfo *info;
+    A2pVideoFormat format;
+    char path[MAX_PATH], loaded[MAX_PATH];
+    uint32_t loaded_op, *table;
+    BYTE *buff, *packet;
+    int64_t i, count;
+    uint64_t packets;
+    size_t size;
+    
+    net = a2p_net_connect(address);
+    hello.magic = A2P_NET_MAGIC;
+    hello.version = A2P_NET_VERSION;
+    table = malloc(A2P_LZ4_TABLE * sizeof(*table));
+    if(table == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate compression table.\n");
+    }
+    if(!a2p_net_send(net, &hello, sizeof(hello))) {
+        a2p_log(A2P_LOG_ERROR, "lost the coordinator at %s.\n", address);
+    }
+    
+    env = NULL;
+    clip = NULL;
+    loaded_op = A2P_COORD_END;
+    while(a2p_net_recv(net, &job, sizeof(job)) && job.op != A2P_COORD_END) {
+        if(job.path_size >= MAX_PATH ||
+           !a2p_net_recv(net, path, job.path_size)) {
+            break;
+        }
+        path[job.path_size] = '\0';
+        
+        // the script stays loaded for the next chunk
+        if(env == NULL || job.op != loaded_op || strcmp(path, loaded) != 0) {
+            if(env != NULL) {
+                if(loaded_op == A2P_COORD_VIDEO) a2p_video_close(&format);
+                avs_release_clip(clip);
+                avs_delete_script_environment(env);
+            }
+            env = avs_create_script_environment(AVISYNTH_INTERFACE_VERSION);
+            clip = a2p_avs_source(env, path);
+            if(job.op == A2P_COORD_VIDEO) {
+                clip = a2p_video_setup(env, clip, &job.options, &format);
+            }
+            strcpy(loaded, path);
+            loaded_op = job.op;
+        }
+        info = avs_get_video_info(clip);
+        size = job.op == A2P_COORD_VIDEO ? format.size :
+               (size_t) avs_bytes_per_channel_sample(info) * info->nchannels;
+        a2p_log(A2P_LOG_INFO, "rendering %s %I64d to %I64d.\n",
+                job.op == A2P_COORD_VIDEO ? "frames" : "samples", job.start,
+                job.start + job.count - 1);
+        
+        // packing the next packet overlaps sending the last
+        buff = malloc((size_t) job.unit * size);
+        if(buff == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not allocate frame buffer.\n");
+        }
+        writer = a2p_writer_create_net(net, a2p_net_bound((size_t) job.unit *
+                                                          size), 2);
+        packets = 0;
+        for(i = 0; i < job.count; i += job.unit) {
+            count = job.count - i < job.unit ? job.count - i : job.unit;
+            packet = a2p_writer_acquire(writer);
+            if(packet == NULL) break;
+            if(job.op == A2P_COORD_VIDEO) {
+                frame = avs_get_frame(clip, (int) (job.start + i));
+                a2p_video_pack(env, &format, frame, buff);
+                avs_release_frame(frame);
+            } else {
+                avs_get_audio(clip, buff, job.start + i, count);
+            }
+            a2p_writer_commit(writer, a2p_net_pack(packet, buff,
+                                                   (size_t) count * size,
+                                                   job.lz4, table));
+            packets++;
+        }
+        free(buff);
+        if(a2p_writer_destroy(writer) != packets) break;
+    }
+    
+    if(env != NULL) {
+        if(loaded_op == A2P_COORD_VIDEO) a2p_video_close(&format);
+        avs_release_clip(clip);
+        avs_delete_script_environment(env);
+    }
+    a2p_net_close(net);
+    free(table);
+    a2p_log(A2P_LOG_INFO, "the coordinator let this worker go.\n");
+}
@@ -0,0 +1,95 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Splits one render across avs2pipe worker processes, on this machine or
+// others. Workers connect to the coordinator, which hands each a chunk of
+// frames, or of audio samples, at a time. A worker loads the script
+// itself and sends back a packet, as in net.h, per frame or second of
+// audio. The coordinator writes them in order to one stream, or each
+// chunk to its own file, and hands the rest of a chunk whose worker died
+// to the next worker.
+//
+// A worker starts with an A2pNetHello. Each job is an A2pCoordJob
+// followed by the script path, and an A2P_COORD_END job lets it go.
+// Both ends must be the same build, the video options are sent as is.
+
+#ifndef COORD_H
+#define COORD_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "video.h"
+
+#define A2P_COORD_CHUNK     16  // default frames, or seconds, per chunk
+#define A2P_COORD_TRIES     3   // workers a chunk may die on
+
+typedef enum A2pCoordOp A2pCoordOp;
+typedef struct A2pCoordJob A2pCoordJob;
+typedef struct A2pCoordTask A2pCoordTask;
+
+// header of a file holding count frames or samples, to be freed
+typedef void *(*A2pCoordHeaderFunc)(void *data, int64_t count, size_t *size);
+
+enum A2pCoordOp {
+    A2P_COORD_VIDEO,
+    A2P_COORD_AUDIO,
+    A2P_COORD_END
+};
+
+struct A2pCoordJob {
+    uint32_t        op;
+    uint32_t        path_size;      // bytes of script path that follow
+    int64_t         start;          // first frame or sample of the script
+    int64_t         count;
+    int64_t         unit;           // frames or samples per packet
+    int32_t         lz4;            // compress the packets
+    A2pVideoOptions options;        // format the video is written in
+};
+
+struct A2pCoordTask {
+    const char     *address;        // host:port workers connect to
+    const char     *script;
+    A2pCoordOp      op;
+    const A2pVideoOptions *options;
+    int64_t         start;          // frames or samples of the script
+    int64_t         count;
+    int64_t         unit;           // frames or samples per packet
+    size_t          size;           // bytes per frame or sample
+    int             chunk;          // packets per chunk
+    int             spawn;          // local worker processes to start
+    int             lz4;
+    FILE           *out;            // everything in order, or
+    const char     *pattern;        // a file per chunk, named by its start
+                                    // in units, the frame or second
+    const char     *header;         // written first to out or each file
+    size_t          header_size;
+    A2pCoordHeaderFunc file_header; // per file header instead, or NULL
+    void           *file_header_data;
+};
+
+// runs the task and returns the frames or samples written
+int64_t
+a2p_coord_run(const A2pCoordTask *task);
+
+// renders jobs for the coordinator at address until it lets go
+void
+a2p_coord_work(const char *address);
+
+#endif // COORD_H
@@ -0,0 +1,117 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdint.h>
+#ifdef _MSC_VER
+    #include <intrin.h>
+#else
+    #include <cpuid.h>
+#endif
+#include "cpu.h"
+
+// used when the cache size can not be read from cpuid
+#define A2P_CPU_DEFAULT_CACHE (8 << 20)
+
+static void
+a2p_cpuid(uint32_t leaf, uint32_t sub, uint32_t reg[4])
+{
+    #ifdef _MSC_VER
+        __cpuidex((int *) reg, leaf, sub);
+    #else
+        __cpuid_count(leaf, sub, reg[0], reg[1], reg[2], reg[3]);
+    #endif
+}
+
+static uint32_t
+a2p_xgetbv(void)
+{
+    #ifdef _MSC_VER
+        return (uint32_t) _xgetbv(0);
+    #else
+        uint32_t eax, edx;
+        // xgetbv as bytes, older assemblers do not know the mnemonic
+        __asm__ volatile (".byte 0x0f, 0x01, 0xd0"
+                          : "=a" (eax), "=d" (edx) : "c" (0));
+        return eax;
+    #endif
+}
+
+int
+a2p_cpu_flags(void)
+{
+    static int flags = -1;
+    uint32_t reg[4], max;
+    int result;
+    
+    if(flags != -1) return flags;
+    
+    result = 0;
+    a2p_cpuid(0, 0, reg);
+    max = reg[0];
+    if(max >= 1) {
+        a2p_cpuid(1, 0, reg);
+        if(reg[3] & (1 << 26)) result |= A2P_CPU_SSE2;
+        if(reg[2] & (1 << 9))  result |= A2P_CPU_SSSE3;
+        if(reg[2] & (1 << 19)) result |= A2P_CPU_SSE41;
+        // avx state must be enabled by the os (osxsave, xcr0 ymm|xmm)
+        if((reg[2] & (1 << 27)) && (a2p_xgetbv() & 6) == 6 && max >= 7) {
+            a2p_cpuid(7, 0, reg);
+            if(reg[1] & (1 << 5)) result |= A2P_CPU_AVX2;
+        }
+    }
+    
+    flags = result;
+    return flags;
+}
+
+size_t
+a2p_cpu_cache_size(void)
+{
+    static size_t cache = 0;
+    uint32_t reg[4], sub, size;
+    
+    if(cache != 0) return cache;
+    
+    // deterministic cache parameters, intel and recent amd
+    a2p_cpuid(0, 0, reg);
+    if(reg[0] >= 4) {
+        for(sub = 0; sub < 16; sub++) {
+            a2p_cpuid(4, sub, reg);
+            if((reg[0] & 0x1f) == 0) break; // no more caches
+            size = (((reg[1] >> 22) & 0x3ff) + 1)   // ways
+                 * (((reg[1] >> 12) & 0x3ff) + 1)   // partitions
+                 * ((reg[1] & 0xfff) + 1)           // line size
+                 * (reg[2] + 1);                    // sets
+            if(size > cache) cache = size;
+        }
+    }
+    // amd extended leaf, l3 in 512KB units then l2 in KB
+    if(cache == 0) {
+        a2p_cpuid(0x80000000, 0, reg);
+        if(reg[0] >= 0x80000006) {
+            a2p_cpuid(0x80000006, 0, reg);
+            cache = (size_t) (reg[3] >> 18) * (512 << 10);
+            if(cache == 0) cache = (size_t) (reg[2] >> 16) << 10;
+        }
+    }
+    if(cache == 0) cache = A2P_CPU_DEFAULT_CACHE;
+    
+    return cache;
+}
@@ -0,0 +1,47 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Runtime cpu feature detection used to pick simd kernels
+
+#ifndef CPU_H
+#define CPU_H
+
+#include <stddef.h>
+
+// gcc builds every kernel with per file flags, msvc only has avx2 from 2013
+#if defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1800)
+    #define A2P_HAVE_AVX2
+#endif
+
+enum A2pCpuFlag {
+    A2P_CPU_SSE2    = 1 << 0,
+    A2P_CPU_SSSE3   = 1 << 1,
+    A2P_CPU_SSE41   = 1 << 2,
+    A2P_CPU_AVX2    = 1 << 3
+};
+
+int
+a2p_cpu_flags(void);
+
+// size in bytes of the largest (last level) cache
+size_t
+a2p_cpu_cache_size(void);
+
+#endif // CPU_H
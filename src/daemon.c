@@ -0,0 +1,481 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include <process.h>
+#include "common.h"
+#include "lz4.h"
+#include "net.h"
+#include "daemon.h"
+
+#define A2P_DAEMON_MESSAGE  1024
+#define A2P_DAEMON_AUDIO_MAX (64 * 1024 * 1024) // largest AUDIO reply
+
+typedef struct A2pDaemonEntry A2pDaemonEntry;
+typedef struct A2pDaemonServer A2pDaemonServer;
+typedef struct A2pDaemonConnection A2pDaemonConnection;
+
+// one loaded script
+struct A2pDaemonEntry {
+    char                    path[MAX_PATH];
+    FILETIME                written;        // last write time when loaded
+    uint64_t                used;           // request it was last used for
+    AVS_ScriptEnvironment  *env;            // NULL for a free entry
+    AVS_Clip               *source;
+    AVS_Clip               *clip;           // as written, NULL without video
+    A2pVideoFormat          format;
+    A2pDaemonInfo           info;
+};
+
+struct A2pDaemonServer {
+    CRITICAL_SECTION        lock;           // the cache and all of AviSynth
+    const A2pVideoOptions  *options;
+    A2pDaemonEntry         *entries;
+    int                     entries_num;
+    uint64_t                requests;
+};
+
+struct A2pDaemonConnection {
+    A2pDaemonServer        *server;
+    A2pNet                 *net;
+    BYTE                   *data;           // unpacked reply
+    size_t                  data_size;
+    BYTE                   *packet;
+    size_t                  packet_size;
+    uint32_t               *table;
+    char                    message[A2P_DAEMON_MESSAGE];
+};
+
+struct A2pDaemon {
+    A2pNet                 *net;
+    char                    path[MAX_PATH];
+    int                     lz4;
+    BYTE                   *payload;
+    size_t                  payload_size;
+};
+
+static void
+a2p_daemon_unload(A2pDaemonEntry *entry)
+{
+    if(entry->env == NULL) return;
+    a2p_log(A2P_LOG_INFO, "closing %s.\n", entry->path);
+    if(entry->clip != NULL) {
+        avs_release_clip(entry->clip);
+        a2p_video_close(&entry->format);
+    }
+    avs_release_clip(entry->source);
+    avs_delete_script_environment(entry->env);
+    entry->env = NULL;
+}
+
+// loads path into entry, 0 with message set when the script fails, which
+// unlike a2p_avs_source leaves the daemon running
+static int
+a2p_daemon_load(A2pDaemonServer *server, A2pDaemonEntry *entry,
+                const char *path, FILETIME written, char *message)
+{
+    const AVS_VideoInfo *info;
+    AVS_Value val_string, val_array, val_return;
+    const char *ext, *import;
+    A2pLogTrap trap;
+    
+    entry->env = avs_create_script_environment(AVISYNTH_INTERFACE_VERSION);
+    if(entry->env == NULL) {
+        sprintf(message, "could not create a script environment.");
+        return 0;
+    }
+    import = "Import";
+    ext = strrchr(path, '.');
+    if(ext != NULL && _stricmp(ext, ".avsg") == 0 &&
+       avs_function_exists(entry->env, "GImport")) {
+        import = "GImport";
+    }
+    val_string = avs_new_value_string(path);
+    val_array = avs_new_value_array(&val_string, 1);
+    val_return = avs_invoke(entry->env, import, val_array, 0);
+    avs_release_value(val_array);
+    avs_release_value(val_string);
+    if(avs_is_error(val_return) || !avs_is_clip(val_return)) {
+        _snprintf(message, A2P_DAEMON_MESSAGE, "%s", avs_is_error(val_return) ?
+                  avs_as_string(val_return) : "the script returns no clip.");
+        message[A2P_DAEMON_MESSAGE - 1] = '\0';
+        avs_release_value(val_return);
+        avs_delete_script_environment(entry->env);
+        entry->env = NULL;
+        return 0;
+    }
+    entry->source = avs_take_clip(val_return, entry->env);
+    avs_release_value(val_return);
+    
+    strcpy(entry->path, path);
+    entry->written = written;
+    memset(&entry->info, 0, sizeof(entry->info));
+    info = avs_get_video_info(entry->source);
+    entry->info.source = *info;
+    entry->clip = NULL;
+    if(avs_has_video(info)) {
+        // a clip the options can not write, or a conversion AviSynth
+        // refuses, fails this request rather than ending the daemon
+        memset(&entry->format, 0, sizeof(entry->format));
+        if(setjmp(trap.jump)) {
+            _snprintf(message, A2P_DAEMON_MESSAGE, "%s", trap.message);
+            message[A2P_DAEMON_MESSAGE - 1] = '\0';
+            a2p_video_close(&entry->format);
+            avs_release_clip(entry->source);
+            avs_delete_script_environment(entry->env);
+            entry->env = NULL;
+            return 0;
+        }
+        a2p_log_trap(&trap);
+        // the conversions take their own reference, the source stays for
+        // audio and info
+        entry->clip = a2p_video_setup(entry->env,
+                                      avs_copy_clip(entry->source),
+                                      server->options, &entry->format);
+        a2p_log_trap(NULL);
+        entry->info.frame_size = (uint32_t) entry->format.size;
+        a2p_video_y4m_header(entry->info.stream,
+                             avs_get_video_info(entry->clip),
+                             &entry->format, server->options);
+    }
+    a2p_log(A2P_LOG_INFO, "loaded %s.\n", path);
+    
+    return 1;
+}
+
+// the loaded script for path, loading it into the least recently used
+// entry if it is not open or has changed since
+static A2pDaemonEntry *
+a2p_daemon_entry(A2pDaemonServer *server, const char *path, char *message)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    A2pDaemonEntry *entry, *e;
+    int i;
+    
+    if(!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) {
+        _snprintf(message, A2P_DAEMON_MESSAGE, "cannot read %s.", path);
+        message[A2P_DAEMON_MESSAGE - 1] = '\0';
+        return NULL;
+    }
+    
+    entry = NULL;
+    for(i = 0; i < server->entries_num; i++) {
+        e = &server->entries[i];
+        if(e->env != NULL && _stricmp(e->path, path) == 0) {
+            if(CompareFileTime(&e->written, &data.ftLastWriteTime) == 0) {
+                e->used = server->requests;
+                return e;
+            }
+            entry = e; // edited since, reloaded in place
+            break;
+        }
+        if(entry == NULL || e->env == NULL ||
+           (entry->env != NULL && e->used < entry->used)) {
+            entry = e;
+        }
+    }
+    a2p_daemon_unload(entry);
+    if(!a2p_daemon_load(server, entry, path, data.ftLastWriteTime, message)) {
+        return NULL;
+    }
+    entry->used = server->requests;
+    
+    return entry;
+}
+
+static int
+a2p_daemon_reserve(BYTE **buff, size_t *buff_size, size_t size)
+{
+    BYTE *grown;
+    
+    if(size <= *buff_size) return 1;
+    grown = realloc(*buff, size);
+    if(grown == NULL) return 0;
+    *buff = grown;
+    *buff_size = size;
+    
+    return 1;
+}
+
+// fills the connection's data with the reply, the message on failure
+static size_t
+a2p_daemon_handle(A2pDaemonConnection *c, const A2pDaemonRequest *request,
+                  const char *path, int *failed)
+{
+    A2pDaemonEntry *entry;
+    const AVS_VideoInfo *info;
+    AVS_VideoFrame *frame;
+    const char *error;
+    size_t size;
+    
+    *failed = 1;
+    c->server->requests++;
+    entry = a2p_daemon_entry(c->server, path, c->message);
+    if(entry == NULL) return 0;
+    info = &entry->info.source;
+    
+    switch(request->op) {
+        case A2P_DAEMON_INFO:
+            size = sizeof(entry->info);
+            if(!a2p_daemon_reserve(&c->data, &c->data_size, size)) break;
+            memcpy(c->data, &entry->info, size);
+            *failed = 0;
+            return size;
+        case A2P_DAEMON_FRAME:
+            if(entry->clip == NULL || request->start < 0 ||
+               request->start >= info->num_frames) {
+                sprintf(c->message, "no frame %I64d.", request->start);
+                return 0;
+            }
+            size = entry->format.size;
+            if(!a2p_daemon_reserve(&c->data, &c->data_size, size)) break;
+            frame = avs_get_frame(entry->clip, (int) request->start);
+            error = avs_clip_get_error(entry->clip);
+            if(error != NULL) {
+                _snprintf(c->message, A2P_DAEMON_MESSAGE, "%s", error);
+                c->message[A2P_DAEMON_MESSAGE - 1] = '\0';
+                if(frame != NULL) avs_release_frame(frame);
+                return 0;
+            }
+            a2p_video_pack(entry->env, &entry->format, frame, c->data);
+            avs_release_frame(frame);
+            *failed = 0;
+            return size;
+        case A2P_DAEMON_AUDIO:
+            size = avs_bytes_per_channel_sample(info) * info->nchannels;
+            if(!avs_has_audio(info) || request->start < 0 ||
+               request->count < 0 ||
+               request->start + request->count > info->num_audio_samples ||
+               request->count > A2P_DAEMON_AUDIO_MAX / size) {
+                sprintf(c->message, "no samples %I64d to %I64d.",
+                        request->start, request->start + request->count);
+                return 0;
+            }
+            size *= (size_t) request->count;
+            if(!a2p_daemon_reserve(&c->data, &c->data_size, size)) break;
+            avs_get_audio(entry->source, c->data, request->start,
+                          request->count);
+            *failed = 0;
+            return size;
+        default:
+            sprintf(c->message, "unknown request %u.", request->op);
+            return 0;
+    }
+    sprintf(c->message, "could not allocate the reply.");
+    
+    return 0;
+}
+
+static unsigned __stdcall
+a2p_daemon_thread(void *data)
+{
+    A2pDaemonConnection *c = data;
+    A2pDaemonRequest request;
+    A2pDaemonReply reply;
+    char path[MAX_PATH];
+    const void *payload;
+    size_t size, packet;
+    int failed;
+    
+    while(a2p_net_recv(c->net, &request, sizeof(request))) {
+        if(request.path_size >= MAX_PATH ||
+           !a2p_net_recv(c->net, path, request.path_size)) {
+            break;
+        }
+        path[request.path_size] = '\0';
+        
+        // AviSynth is used by one request at a time, only sending and
+        // compressing run alongside other connections
+        EnterCriticalSection(&c->server->lock);
+        size = a2p_daemon_handle(c, &request, path, &failed);
+        LeaveCriticalSection(&c->server->lock);
+        
+        payload = failed ? (const void *) c->message : c->data;
+        if(failed) size = strlen(c->message) + 1;
+        if(!a2p_daemon_reserve(&c->packet, &c->packet_size,
+                               a2p_net_bound(size))) {
+            break;
+        }
+        packet = a2p_net_pack(c->packet, payload, size,
+                              request.lz4 && !failed, c->table);
+        reply.failed = failed;
+        if(!a2p_net_send(c->net, &reply, sizeof(reply)) ||
+           !a2p_net_send(c->net, c->packet, packet)) {
+            break;
+        }
+    }
+    
+    a2p_net_close(c->net);
+    free(c->packet);
+    free(c->data);
+    free(c->table);
+    free(c);
+    
+    return 0;
+}
+
+void
+a2p_daemon_run(const char *address, const A2pVideoOptions *options,
+               int cache)
+{
+    A2pDaemonServer server;
+    A2pDaemonConnection *c;
+    A2pNet *listener, *net;
+    HANDLE thread;
+    
+    InitializeCriticalSection(&server.lock);
+    server.options = options;
+    server.entries_num = cache;
+    server.requests = 0;
+    server.entries = calloc(cache, sizeof(*server.entries));
+    if(server.entries == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate the script cache.\n");
+    }
+    
+    // clients name any script path to load, so only local ones are served
+    listener = a2p_net_listen_local(address);
+    a2p_log(A2P_LOG_INFO, "serving scripts on %s, keeping %d loaded.\n",
+            address, cache);
+    for(;;) {
+        net = a2p_net_accept(listener);
+        if(net == NULL) {
+            a2p_log(A2P_LOG_WARNING, "could not accept a client.\n");
+            continue;
+        }
+        if(!a2p_net_peer_local(net)) {
+            a2p_log(A2P_LOG_WARNING, "refused a client from another "
+                    "machine.\n");
+            a2p_net_close(net);
+            continue;
+        }
+        c = calloc(1, sizeof(*c));
+        if(c == NULL || (c->table = malloc(A2P_LZ4_TABLE *
+                                           sizeof(*c->table))) == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not allocate connection state.\n");
+        }
+        c->server = &server;
+        c->net = net;
+        thread = (HANDLE) _beginthreadex(NULL, 0, a2p_daemon_thread, c, 0,
+                                         NULL);
+        if(thread == 0) {
+            a2p_log(A2P_LOG_ERROR, "could not start connection thread.\n");
+        }
+        CloseHandle(thread);
+    }
+}
+
+A2pDaemon *
+a2p_daemon_connect(const char *address, const char *script, int lz4)
+{
+    A2pDaemon *daemon;
+    
+    daemon = calloc(1, sizeof(*daemon));
+    if(daemon == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate daemon state.\n");
+    }
+    // the daemon may run elsewhere, so it is given the whole path
+    if(GetFullPathNameA(script, MAX_PATH, daemon->path, NULL) == 0) {
+        a2p_log(A2P_LOG_ERROR, "cannot find the full path of %s.\n", script);
+    }
+    daemon->lz4 = lz4;
+    daemon->net = a2p_net_connect(address);
+    
+    return daemon;
+}
+
+// sends a request and unpacks the size byte reply into buff
+static void
+a2p_daemon_request(A2pDaemon *daemon, A2pDaemonOp op, int64_t start,
+                   int64_t count, void *buff, size_t size)
+{
+    A2pDaemonRequest request;
+    A2pDaemonReply reply;
+    A2pNetPacket packet;
+    char message[A2P_DAEMON_MESSAGE];
+    
+    request.op = op;
+    request.path_size = (uint32_t) strlen(daemon->path);
+    request.start = start;
+    request.count = count;
+    request.lz4 = daemon->lz4;
+    if(!a2p_net_send(daemon->net, &request, sizeof(request)) ||
+       !a2p_net_send(daemon->net, daemon->path, request.path_size) ||
+       !a2p_net_recv(daemon->net, &reply, sizeof(reply)) ||
+       !a2p_net_recv(daemon->net, &packet, sizeof(packet))) {
+        a2p_log(A2P_LOG_ERROR, "lost the connection to the daemon.\n");
+    }
+    if(packet.packed > daemon->payload_size) {
+        daemon->payload_size = packet.packed;
+        daemon->payload = realloc(daemon->payload, daemon->payload_size);
+        if(daemon->payload == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not allocate packet buffer.\n");
+        }
+    }
+    if(!a2p_net_recv(daemon->net, daemon->payload, packet.packed)) {
+        a2p_log(A2P_LOG_ERROR, "lost the connection to the daemon.\n");
+    }
+    
+    if(reply.failed) {
+        if(packet.size > sizeof(message) ||
+           !a2p_net_unpack(message, &packet, daemon->payload)) {
+            a2p_log(A2P_LOG_ERROR, "the daemon failed with a corrupt "
+                    "message.\n");
+        }
+        message[sizeof(message) - 1] = '\0';
+        a2p_log(A2P_LOG_ERROR, "daemon: %s\n", message);
+    }
+    if(packet.size != size) {
+        a2p_log(A2P_LOG_ERROR, "the daemon sent %u bytes instead of %u.\n",
+                packet.size, (unsigned) size);
+    }
+    if(!a2p_net_unpack(buff, &packet, daemon->payload)) {
+        a2p_log(A2P_LOG_ERROR, "the daemon sent a corrupt packet.\n");
+    }
+}
+
+void
+a2p_daemon_info(A2pDaemon *daemon, A2pDaemonInfo *info)
+{
+    a2p_daemon_request(daemon, A2P_DAEMON_INFO, 0, 0, info, sizeof(*info));
+}
+
+void
+a2p_daemon_frame(A2pDaemon *daemon, int n, void *buff, size_t size)
+{
+    a2p_daemon_request(daemon, A2P_DAEMON_FRAME, n, 0, buff, size);
+}
+
+void
+a2p_daemon_audio(A2pDaemon *daemon, int64_t start, int64_t count,
+                 void *buff, size_t size)
+{
+    a2p_daemon_request(daemon, A2P_DAEMON_AUDIO, start, count, buff, size);
+}
+
+void
+a2p_daemon_close(A2pDaemon *daemon)
+{
+    a2p_net_close(daemon->net);
+    free(daemon->payload);
+    free(daemon);
+}
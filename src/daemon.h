@@ -0,0 +1,97 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Long lived frame server for tools that ask for single frames. Loaded
+// scripts stay open between requests, keyed by full path and last write
+// time, and the least recently used one is closed once --cache scripts
+// are open, so repeat requests skip loading AviSynth, its plugins and the
+// script.
+//
+// A client sends an A2pDaemonRequest followed by the script path and gets
+// back an A2pDaemonReply followed by one packet as in net.h. INFO replies
+// hold an A2pDaemonInfo, FRAME replies one frame as avs2pipe video packs
+// it and AUDIO replies the samples asked for. A failed request gets the
+// error message instead, the connection stays usable.
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stdint.h>
+#include "avs2pipe.h"
+#include "video.h"
+
+#define A2P_DAEMON_ADDRESS  "127.0.0.1:7778"
+#define A2P_DAEMON_CACHE    4
+
+typedef enum A2pDaemonOp A2pDaemonOp;
+typedef struct A2pDaemonRequest A2pDaemonRequest;
+typedef struct A2pDaemonReply A2pDaemonReply;
+typedef struct A2pDaemonInfo A2pDaemonInfo;
+typedef struct A2pDaemon A2pDaemon;
+
+enum A2pDaemonOp {
+    A2P_DAEMON_INFO,
+    A2P_DAEMON_FRAME,
+    A2P_DAEMON_AUDIO
+};
+
+struct A2pDaemonRequest {
+    uint32_t        op;
+    uint32_t        path_size;      // bytes of script path that follow
+    int64_t         start;          // frame, or first sample
+    int64_t         count;          // samples
+    int32_t         lz4;            // compress the reply packet
+};
+
+struct A2pDaemonReply {
+    int32_t         failed;         // the packet holds the error message
+};
+
+struct A2pDaemonInfo {
+    AVS_VideoInfo   source;         // clip the script returns
+    uint32_t        frame_size;     // bytes of each FRAME reply
+    char            stream[A2P_Y4M_HEADER_MAX]; // empty for raw video
+};
+
+// serves requests on address, a loopback address or :port for 127.0.0.1,
+// until the process is stopped, every script is written with options
+void
+a2p_daemon_run(const char *address, const A2pVideoOptions *options,
+               int cache);
+
+A2pDaemon *
+a2p_daemon_connect(const char *address, const char *script, int lz4);
+
+void
+a2p_daemon_info(A2pDaemon *daemon, A2pDaemonInfo *info);
+
+// size bytes of frame n into buff
+void
+a2p_daemon_frame(A2pDaemon *daemon, int n, void *buff, size_t size);
+
+// count samples from start into buff, size bytes
+void
+a2p_daemon_audio(A2pDaemon *daemon, int64_t start, int64_t count,
+                 void *buff, size_t size);
+
+void
+a2p_daemon_close(A2pDaemon *daemon);
+
+#endif // DAEMON_H
@@ -0,0 +1,135 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cpu.h"
+#include "deint.h"
+
+static void a2p_deint_yuy2_detect(uint8_t *, uint8_t *, uint8_t *,
+                                  const uint8_t *, int);
+static void a2p_deint_bgr24_detect(uint8_t *, uint8_t *, uint8_t *,
+                                   const uint8_t *, int);
+static void a2p_deint_bgr32_detect(uint8_t *, uint8_t *, uint8_t *,
+                                   const uint8_t *, int);
+
+static A2pDeintFunc a2p_deint_yuy2_func = a2p_deint_yuy2_detect;
+static A2pDeintFunc a2p_deint_bgr24_func = a2p_deint_bgr24_detect;
+static A2pDeintFunc a2p_deint_bgr32_func = a2p_deint_bgr32_detect;
+
+// first call picks the kernels, racing threads all pick the same ones
+static void
+a2p_deint_select(void)
+{
+    int flags;
+    
+    flags = a2p_cpu_flags();
+    a2p_deint_yuy2_func = flags & A2P_CPU_SSE2 ?
+                          a2p_deint_yuy2_sse2 : a2p_deint_yuy2_c;
+    a2p_deint_bgr24_func = flags & A2P_CPU_SSSE3 ?
+                           a2p_deint_bgr24_ssse3 : a2p_deint_bgr24_c;
+    a2p_deint_bgr32_func = flags & A2P_CPU_SSE2 ?
+                           a2p_deint_bgr32_sse2 : a2p_deint_bgr32_c;
+}
+
+static void
+a2p_deint_yuy2_detect(uint8_t *y, uint8_t *u, uint8_t *v, const uint8_t *src,
+                      int width)
+{
+    a2p_deint_select();
+    a2p_deint_yuy2_func(y, u, v, src, width);
+}
+
+static void
+a2p_deint_bgr24_detect(uint8_t *g, uint8_t *b, uint8_t *r,
+                       const uint8_t *src, int width)
+{
+    a2p_deint_select();
+    a2p_deint_bgr24_func(g, b, r, src, width);
+}
+
+static void
+a2p_deint_bgr32_detect(uint8_t *g, uint8_t *b, uint8_t *r,
+                       const uint8_t *src, int width)
+{
+    a2p_deint_select();
+    a2p_deint_bgr32_func(g, b, r, src, width);
+}
+
+void
+a2p_deint_yuy2(uint8_t *y, uint8_t *u, uint8_t *v, const uint8_t *src,
+               int width)
+{
+    a2p_deint_yuy2_func(y, u, v, src, width);
+}
+
+void
+a2p_deint_bgr24(uint8_t *g, uint8_t *b, uint8_t *r, const uint8_t *src,
+                int width)
+{
+    a2p_deint_bgr24_func(g, b, r, src, width);
+}
+
+void
+a2p_deint_bgr32(uint8_t *g, uint8_t *b, uint8_t *r, const uint8_t *src,
+                int width)
+{
+    a2p_deint_bgr32_func(g, b, r, src, width);
+}
+
+void
+a2p_deint_yuy2_c(uint8_t *y, uint8_t *u, uint8_t *v, const uint8_t *src,
+                 int width)
+{
+    int x;
+    
+    // Y0 U0 Y1 V0
+    for(x = 0; x < width / 2; x++) {
+        y[2 * x]     = src[4 * x];
+        u[x]         = src[4 * x + 1];
+        y[2 * x + 1] = src[4 * x + 2];
+        v[x]         = src[4 * x + 3];
+    }
+}
+
+void
+a2p_deint_bgr24_c(uint8_t *g, uint8_t *b, uint8_t *r, const uint8_t *src,
+                  int width)
+{
+    int x;
+    
+    for(x = 0; x < width; x++) {
+        b[x] = src[3 * x];
+        g[x] = src[3 * x + 1];
+        r[x] = src[3 * x + 2];
+    }
+}
+
+void
+a2p_deint_bgr32_c(uint8_t *g, uint8_t *b, uint8_t *r, const uint8_t *src,
+                  int width)
+{
+    int x;
+    
+    // alpha is dropped
+    for(x = 0; x < width; x++) {
+        b[x] = src[4 * x];
+        g[x] = src[4 * x + 1];
+        r[x] = src[4 * x + 2];
+    }
+}
@@ -0,0 +1,71 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Packed to planar row kernels for YUY2 and BGR24/32 sources, so these
+// need no ConvertTo* filter before y4m output. RGB rows come out in the
+// G, B, R plane order used for RGB in 4:4:4 video codecs.
+
+#ifndef DEINT_H
+#define DEINT_H
+
+#include <stdint.h>
+
+typedef void (*A2pDeintFunc)(uint8_t *dst0, uint8_t *dst1, uint8_t *dst2,
+                             const uint8_t *src, int width);
+
+// width is in pixels, yuy2 writes width / 2 chroma samples
+void
+a2p_deint_yuy2(uint8_t *y, uint8_t *u, uint8_t *v, const uint8_t *src,
+               int width);
+
+void
+a2p_deint_bgr24(uint8_t *g, uint8_t *b, uint8_t *r, const uint8_t *src,
+                int width);
+
+void
+a2p_deint_bgr32(uint8_t *g, uint8_t *b, uint8_t *r, const uint8_t *src,
+                int width);
+
+// kernels, only call the simd ones when a2p_cpu_flags reports support
+void
+a2p_deint_yuy2_c(uint8_t *y, uint8_t *u, uint8_t *v, const uint8_t *src,
+                 int width);
+
+void
+a2p_deint_yuy2_sse2(uint8_t *y, uint8_t *u, uint8_t *v, const uint8_t *src,
+                    int width);
+
+void
+a2p_deint_bgr24_c(uint8_t *g, uint8_t *b, uint8_t *r, const uint8_t *src,
+                  int width);
+
+void
+a2p_deint_bgr24_ssse3(uint8_t *g, uint8_t *b, uint8_t *r,
+                      const uint8_t *src, int width);
+
+void
+a2p_deint_bgr32_c(uint8_t *g, uint8_t *b, uint8_t *r, const uint8_t *src,
+                  int width);
+
+void
+a2p_deint_bgr32_sse2(uint8_t *g, uint8_t *b, uint8_t *r,
+                     const uint8_t *src, int width);
+
+#endif // DEINT_H
@@ -0,0 +1,88 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// built with -msse2 by gcc, only called when the cpu reports sse2
+
+#include <emmintrin.h>
+#include "deint.h"
+
+void
+a2p_deint_yuy2_sse2(uint8_t *y, uint8_t *u, uint8_t *v, const uint8_t *src,
+                    int width)
+{
+    __m128i mask, a, b, c, d, uv0, uv1;
+    int x;
+    
+    mask = _mm_set1_epi16(0x00ff);
+    // 32 pixels, 64 bytes of Y0 U0 Y1 V0 per loop
+    for(x = 0; x + 32 <= width; x += 32) {
+        a = _mm_loadu_si128((const __m128i *) (src +  0));
+        b = _mm_loadu_si128((const __m128i *) (src + 16));
+        c = _mm_loadu_si128((const __m128i *) (src + 32));
+        d = _mm_loadu_si128((const __m128i *) (src + 48));
+        _mm_storeu_si128((__m128i *) (y +  0),
+            _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        _mm_storeu_si128((__m128i *) (y + 16),
+            _mm_packus_epi16(_mm_and_si128(c, mask), _mm_and_si128(d, mask)));
+        // U0 V0 U1 V1 ... then split again by byte parity
+        uv0 = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        uv1 = _mm_packus_epi16(_mm_srli_epi16(c, 8), _mm_srli_epi16(d, 8));
+        _mm_storeu_si128((__m128i *) u,
+            _mm_packus_epi16(_mm_and_si128(uv0, mask),
+                             _mm_and_si128(uv1, mask)));
+        _mm_storeu_si128((__m128i *) v,
+            _mm_packus_epi16(_mm_srli_epi16(uv0, 8), _mm_srli_epi16(uv1, 8)));
+        src += 64;
+        y += 32;
+        u += 16;
+        v += 16;
+    }
+    a2p_deint_yuy2_c(y, u, v, src, width - x);
+}
+
+void
+a2p_deint_bgr32_sse2(uint8_t *g, uint8_t *b, uint8_t *r,
+                     const uint8_t *src, int width)
+{
+    __m128i mask, p[4], c[4];
+    int x, i, shift;
+    uint8_t *dst[3];
+    
+    mask = _mm_set1_epi32(0xff);
+    dst[0] = b;
+    dst[1] = g;
+    dst[2] = r;
+    // 16 pixels, 64 bytes of B G R A per loop
+    for(x = 0; x + 16 <= width; x += 16) {
+        for(i = 0; i < 4; i++) {
+            p[i] = _mm_loadu_si128((const __m128i *) (src + 16 * i));
+        }
+        for(shift = 0; shift < 3; shift++) {
+            for(i = 0; i < 4; i++) {
+                c[i] = _mm_and_si128(_mm_srli_epi32(p[i], 8 * shift), mask);
+            }
+            _mm_storeu_si128((__m128i *) (dst[shift] + x),
+                _mm_packus_epi16(_mm_packs_epi32(c[0], c[1]),
+                                 _mm_packs_epi32(c[2], c[3])));
+        }
+        src += 64;
+    }
+    a2p_deint_bgr32_c(g + x, b + x, r + x, src, width - x);
+}
@@ -0,0 +1,63 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// built with -mssse3 by gcc, only called when the cpu reports ssse3
+
+#include <tmmintrin.h>
+#include "deint.h"
+
+void
+a2p_deint_bgr24_ssse3(uint8_t *g, uint8_t *b, uint8_t *r,
+                      const uint8_t *src, int width)
+{
+    __m128i p0, p1, p2;
+    __m128i b0, b1, b2, g0, g1, g2, r0, r1, r2;
+    int x;
+    
+    // gather every third byte from the three source registers,
+    // -1 lanes are zeroed by pshufb so the parts can be or'ed together
+    b0 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    b1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+    b2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+    g0 = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    g1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+    g2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+    r0 = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    r1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+    r2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+    
+    // 16 pixels, 48 bytes of B G R per loop
+    for(x = 0; x + 16 <= width; x += 16) {
+        p0 = _mm_loadu_si128((const __m128i *) (src +  0));
+        p1 = _mm_loadu_si128((const __m128i *) (src + 16));
+        p2 = _mm_loadu_si128((const __m128i *) (src + 32));
+        _mm_storeu_si128((__m128i *) (b + x), _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(p0, b0), _mm_shuffle_epi8(p1, b1)),
+            _mm_shuffle_epi8(p2, b2)));
+        _mm_storeu_si128((__m128i *) (g + x), _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(p0, g0), _mm_shuffle_epi8(p1, g1)),
+            _mm_shuffle_epi8(p2, g2)));
+        _mm_storeu_si128((__m128i *) (r + x), _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(p0, r0), _mm_shuffle_epi8(p1, r1)),
+            _mm_shuffle_epi8(p2, r2)));
+        src += 48;
+    }
+    a2p_deint_bgr24_c(g + x, b + x, r + x, src, width - x);
+}
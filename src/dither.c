@@ -0,0 +1,186 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "cpu.h"
+#include "dither.h"
+
+static void a2p_dither_8_detect(void *, const uint16_t *, int, int, int,
+                                const uint16_t *);
+static void a2p_dither_16_detect(void *, const uint16_t *, int, int, int,
+                                 const uint16_t *);
+
+static A2pDitherFunc a2p_dither_8_func = a2p_dither_8_detect;
+static A2pDitherFunc a2p_dither_16_func = a2p_dither_16_detect;
+
+static const uint8_t a2p_bayer[8][8] = {
+    { 0, 32,  8, 40,  2, 34, 10, 42},
+    {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44,  4, 36, 14, 46,  6, 38},
+    {60, 28, 52, 20, 62, 30, 54, 22},
+    { 3, 35, 11, 43,  1, 33,  9, 41},
+    {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47,  7, 39, 13, 45,  5, 37},
+    {63, 31, 55, 23, 61, 29, 53, 21}
+};
+
+// first call picks the kernels, racing threads all pick the same ones
+static void
+a2p_dither_select(void)
+{
+    int flags;
+    
+    flags = a2p_cpu_flags();
+    a2p_dither_8_func = flags & A2P_CPU_SSE2 ?
+                        a2p_dither_8_sse2 : a2p_dither_8_c;
+    a2p_dither_16_func = flags & A2P_CPU_SSE2 ?
+                         a2p_dither_16_sse2 : a2p_dither_16_c;
+}
+
+static void
+a2p_dither_8_detect(void *dst, const uint16_t *src, int width, int shift,
+                    int max, const uint16_t *bias)
+{
+    a2p_dither_select();
+    a2p_dither_8_func(dst, src, width, shift, max, bias);
+}
+
+static void
+a2p_dither_16_detect(void *dst, const uint16_t *src, int width, int shift,
+                     int max, const uint16_t *bias)
+{
+    a2p_dither_select();
+    a2p_dither_16_func(dst, src, width, shift, max, bias);
+}
+
+static void
+a2p_dither_fs(uint8_t *dst, int dst_pitch, const uint8_t *src,
+              int src_pitch, int width, int height, int shift, int max)
+{
+    const uint16_t *in;
+    int *err, *cur, *next, *swap;
+    int x, y, v, q, e;
+    
+    // errors in 16ths for this row and the next, padded for both edges
+    err = calloc(2 * (width + 2), sizeof(*err));
+    if(err == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate dither buffer.\n");
+    }
+    cur = err;
+    next = err + width + 2;
+    
+    for(y = 0; y < height; y++) {
+        in = (const uint16_t *) (src + y * src_pitch);
+        for(x = 0; x < width; x++) {
+            v = in[x] + (cur[x + 1] + 8) / 16;
+            q = (v + (1 << (shift - 1))) >> shift;
+            q = q < 0 ? 0 : q > max ? max : q;
+            e = v - (q << shift);
+            cur[x + 2] += e * 7;
+            next[x] += e * 3;
+            next[x + 1] += e * 5;
+            next[x + 2] += e;
+            if(max > 255) {
+                ((uint16_t *) dst)[x] = (uint16_t) q;
+            } else {
+                dst[x] = (uint8_t) q;
+            }
+        }
+        swap = cur;
+        cur = next;
+        next = swap;
+        memset(next, 0, (width + 2) * sizeof(*next));
+        dst += dst_pitch;
+    }
+    
+    free(err);
+}
+
+void
+a2p_dither_plane(A2pDitherMode mode, uint8_t *dst, int dst_pitch,
+                 const uint8_t *src, int src_pitch, int width, int height,
+                 int src_depth, int dst_depth)
+{
+    int y;
+    
+    if(mode == A2P_DITHER_FS) {
+        a2p_dither_fs(dst, dst_pitch, src, src_pitch, width, height,
+                      src_depth - dst_depth, (1 << dst_depth) - 1);
+        return;
+    }
+    
+    for(y = 0; y < height; y++) {
+        a2p_dither_row(mode, dst, (const uint16_t *) src, width, y,
+                       src_depth, dst_depth);
+        dst += dst_pitch;
+        src += src_pitch;
+    }
+}
+
+void
+a2p_dither_row(A2pDitherMode mode, void *dst, const uint16_t *src,
+               int width, int y, int src_depth, int dst_depth)
+{
+    uint16_t bias[8];
+    int shift, x;
+    
+    shift = src_depth - dst_depth;
+    for(x = 0; x < 8; x++) {
+        if(mode == A2P_DITHER_ORDERED) {
+            // thresholds spread evenly over the bits shifted out
+            bias[x] = ((2 * a2p_bayer[y & 7][x] + 1) << shift) >> 7;
+        } else {
+            bias[x] = 1 << (shift - 1);
+        }
+    }
+    if(dst_depth > 8) {
+        a2p_dither_16_func(dst, src, width, shift, (1 << dst_depth) - 1, bias);
+    } else {
+        a2p_dither_8_func(dst, src, width, shift, (1 << dst_depth) - 1, bias);
+    }
+}
+
+void
+a2p_dither_8_c(void *dst, const uint16_t *src, int width, int shift,
+               int max, const uint16_t *bias)
+{
+    uint8_t *out = dst;
+    int x, v;
+    
+    for(x = 0; x < width; x++) {
+        v = (src[x] + bias[x & 7]) >> shift;
+        out[x] = v > max ? max : v;
+    }
+}
+
+void
+a2p_dither_16_c(void *dst, const uint16_t *src, int width, int shift,
+                int max, const uint16_t *bias)
+{
+    uint16_t *out = dst;
+    int x, v;
+    
+    for(x = 0; x < width; x++) {
+        v = (src[x] + bias[x & 7]) >> shift;
+        out[x] = v > max ? max : v;
+    }
+}
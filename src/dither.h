@@ -0,0 +1,72 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Bit depth reduction of 16 bit planar samples while packing frames.
+// Rounding and ordered dither use simd row kernels, Floyd-Steinberg
+// carries its error along each row so it stays scalar.
+
+#ifndef DITHER_H
+#define DITHER_H
+
+#include <stdint.h>
+
+typedef enum A2pDitherMode A2pDitherMode;
+
+enum A2pDitherMode {
+    A2P_DITHER_NONE,                // round to nearest
+    A2P_DITHER_ORDERED,             // 8x8 bayer
+    A2P_DITHER_FS                   // floyd-steinberg error diffusion
+};
+
+// bias holds the 8 values added to samples x & 7 before shifting
+typedef void (*A2pDitherFunc)(void *dst, const uint16_t *src, int width,
+                              int shift, int max, const uint16_t *bias);
+
+// src has 16 bit samples with src_depth bits used, dst gets 8 bit samples
+// when dst_depth is 8 or 16 bit samples otherwise, width is in samples and
+// pitches in bytes
+void
+a2p_dither_plane(A2pDitherMode mode, uint8_t *dst, int dst_pitch,
+                 const uint8_t *src, int src_pitch, int width, int height,
+                 int src_depth, int dst_depth);
+
+// one row of a plane, y picks the ordered pattern, not for A2P_DITHER_FS
+void
+a2p_dither_row(A2pDitherMode mode, void *dst, const uint16_t *src,
+               int width, int y, int src_depth, int dst_depth);
+
+// kernels, only call the simd ones when a2p_cpu_flags reports support
+void
+a2p_dither_8_c(void *dst, const uint16_t *src, int width, int shift,
+               int max, const uint16_t *bias);
+
+void
+a2p_dither_8_sse2(void *dst, const uint16_t *src, int width, int shift,
+                  int max, const uint16_t *bias);
+
+void
+a2p_dither_16_c(void *dst, const uint16_t *src, int width, int shift,
+                int max, const uint16_t *bias);
+
+void
+a2p_dither_16_sse2(void *dst, const uint16_t *src, int width, int shift,
+                   int max, const uint16_t *bias);
+
+#endif // DITHER_H
@@ -0,0 +1,68 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// built with -msse2 by gcc, only called when the cpu reports sse2
+
+#include <emmintrin.h>
+#include "dither.h"
+
+// adds saturate at 0xffff, which shifts down to max for 16 bit sources
+// exactly like the unsaturated sum does in the c kernels
+
+void
+a2p_dither_8_sse2(void *dst, const uint16_t *src, int width, int shift,
+                  int max, const uint16_t *bias)
+{
+    __m128i b, sft, lo, hi;
+    uint8_t *out = dst;
+    int x;
+    
+    b = _mm_loadu_si128((const __m128i *) bias);
+    sft = _mm_cvtsi32_si128(shift);
+    for(x = 0; x + 16 <= width; x += 16) {
+        lo = _mm_loadu_si128((const __m128i *) (src + x));
+        hi = _mm_loadu_si128((const __m128i *) (src + x + 8));
+        lo = _mm_srl_epi16(_mm_adds_epu16(lo, b), sft);
+        hi = _mm_srl_epi16(_mm_adds_epu16(hi, b), sft);
+        _mm_storeu_si128((__m128i *) (out + x), _mm_packus_epi16(lo, hi));
+    }
+    // bias is periodic in 8 so the tail starts in phase
+    a2p_dither_8_c(out + x, src + x, width - x, shift, max, bias);
+}
+
+void
+a2p_dither_16_sse2(void *dst, const uint16_t *src, int width, int shift,
+                   int max, const uint16_t *bias)
+{
+    __m128i b, sft, m, v;
+    uint16_t *out = dst;
+    int x;
+    
+    b = _mm_loadu_si128((const __m128i *) bias);
+    sft = _mm_cvtsi32_si128(shift);
+    m = _mm_set1_epi16((short) max);
+    for(x = 0; x + 8 <= width; x += 8) {
+        v = _mm_loadu_si128((const __m128i *) (src + x));
+        v = _mm_srl_epi16(_mm_adds_epu16(v, b), sft);
+        // max is at most 15 bits so the signed min is safe
+        _mm_storeu_si128((__m128i *) (out + x), _mm_min_epi16(v, m));
+    }
+    a2p_dither_16_c(out + x, src + x, width - x, shift, max, bias);
+}
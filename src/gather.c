@@ -0,0 +1,92 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <io.h>
+#include <string.h>
+#include "gather.h"
+
+// _write takes an unsigned int count, keep each call well inside it
+#define A2P_GATHER_MAX_WRITE (1 << 30)
+
+int
+a2p_iovec_add(A2pIoVec *vec, int count, const void *base, size_t len)
+{
+    if(count > 0 && (const char *) vec[count - 1].base + vec[count - 1].len
+                     == (const char *) base) {
+        vec[count - 1].len += len;
+        return count;
+    }
+    vec[count].base = base;
+    vec[count].len = len;
+    
+    return count + 1;
+}
+
+static size_t
+a2p_write_all(int fd, const char *ptr, size_t left)
+{
+    size_t wrote;
+    int step;
+    
+    wrote = 0;
+    while(left > 0) {
+        step = _write(fd, ptr, left < A2P_GATHER_MAX_WRITE ?
+                               (unsigned int) left : A2P_GATHER_MAX_WRITE);
+        if(step <= 0) break;
+        ptr += step;
+        left -= step;
+        wrote += step;
+    }
+    
+    return wrote;
+}
+
+size_t
+a2p_write_gather(int fd, const A2pIoVec *vec, int count, void *chunk)
+{
+    size_t fill, step, wrote;
+    int i;
+    
+    // windows has no writev for pipes, but unbuffered _write calls still
+    // skip both the packing copy and the stdio buffer copy for whole
+    // planes, while padded rows are batched so each call stays large
+    fill = 0;
+    wrote = 0;
+    for(i = 0; i < count; i++) {
+        // the chunk is flushed before it overflows or a long segment
+        if(fill > 0 && fill + vec[i].len > A2P_GATHER_CHUNK) {
+            step = a2p_write_all(fd, chunk, fill);
+            wrote += step;
+            if(step != fill) return wrote;
+            fill = 0;
+        }
+        if(vec[i].len < A2P_GATHER_CHUNK) {
+            memcpy((char *) chunk + fill, vec[i].base, vec[i].len);
+            fill += vec[i].len;
+        } else {
+            step = a2p_write_all(fd, vec[i].base, vec[i].len);
+            wrote += step;
+            if(step != vec[i].len) return wrote;
+        }
+    }
+    if(fill > 0) wrote += a2p_write_all(fd, chunk, fill);
+    
+    return wrote;
+}
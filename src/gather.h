@@ -0,0 +1,49 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Gather writes, a list of memory segments written to a file descriptor
+// without first copying them into one buffer.
+
+#ifndef GATHER_H
+#define GATHER_H
+
+#include <stddef.h>
+
+// segments shorter than this are copied into a chunk of this size and
+// written together, a _write per padded row costs far more than the copy
+#define A2P_GATHER_CHUNK (256 * 1024)
+
+typedef struct A2pIoVec A2pIoVec;
+
+struct A2pIoVec {
+    const void *base;
+    size_t      len;
+};
+
+// appends a segment, merging it with the last when they are adjacent
+int
+a2p_iovec_add(A2pIoVec *vec, int count, const void *base, size_t len);
+
+// writes every segment in order, returns bytes written, chunk is
+// A2P_GATHER_CHUNK bytes of scratch for the short segments
+size_t
+a2p_write_gather(int fd, const A2pIoVec *vec, int count, void *chunk);
+
+#endif // GATHER_H
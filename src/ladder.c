@@ -0,0 +1,186 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "pool.h"
+#include "writer.h"
+#include "ladder.h"
+
+// stripes per pool thread for each plane of each rung
+#define A2P_LADDER_STRIPES 2
+
+typedef struct A2pLadderRung A2pLadderRung;
+typedef struct A2pLadderJob A2pLadderJob;
+
+struct A2pLadderRung {
+    A2pVideoFormat      format;
+    A2pScale           *scales[A2P_MAX_PLANES];
+    A2pWriter          *writer;
+    BYTE               *buff;           // frame being scaled
+};
+
+struct A2pLadderJob {
+    int                 rung;
+    int                 plane;
+    int                 y0;
+    int                 y1;
+};
+
+struct A2pLadder {
+    const A2pVideoFormat *base;
+    int                 rungs_num;
+    A2pLadderRung      *rungs;
+    
+    A2pPool            *pool;
+    int                 jobs_num;
+    A2pLadderJob       *jobs;
+    uint8_t            *scratch;        // per job scale scratch
+    size_t              scratch_size;
+    
+    const BYTE         *frame;          // base frame being scaled
+};
+
+static void
+a2p_ladder_job(void *data, int job)
+{
+    A2pLadder *l = data;
+    A2pLadderJob *j = &l->jobs[job];
+    A2pLadderRung *r = &l->rungs[j->rung];
+    int p = j->plane;
+    
+    a2p_scale_rows(r->scales[p], r->buff + r->format.offset[p],
+                   r->format.width[p], l->frame + l->base->offset[p],
+                   l->base->width[p], j->y0, j->y1,
+                   l->scratch + job * l->scratch_size);
+}
+
+A2pLadder *
+a2p_ladder_create(const A2pVideoFormat *base, const A2pVideoFormat *rungs,
+                  FILE *const *files, int rungs_num, A2pScaleKernel kernel,
+                  int threads, int buffers)
+{
+    A2pLadder *l;
+    A2pLadderRung *r;
+    size_t size;
+    int i, p, s, stripes, rows, height;
+    
+    l = malloc(sizeof(*l));
+    if(l == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate ladder state.\n");
+    }
+    l->base = base;
+    l->rungs_num = rungs_num;
+    l->rungs = malloc(rungs_num * sizeof(*l->rungs));
+    if(l->rungs == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate ladder state.\n");
+    }
+    l->pool = a2p_pool_create(threads);
+    stripes = a2p_pool_threads(l->pool) * A2P_LADDER_STRIPES;
+    
+    l->scratch_size = 0;
+    for(i = 0; i < rungs_num; i++) {
+        r = &l->rungs[i];
+        r->format = rungs[i];
+        for(p = 0; p < base->planes_num; p++) {
+            r->scales[p] = a2p_scale_create(base->width[p], base->height[p],
+                                            r->format.width[p],
+                                            r->format.height[p], kernel);
+            // keep each job's scratch on its own cache lines
+            size = a2p_scale_scratch_size(r->scales[p]);
+            size = (size + 63) & ~(size_t) 63;
+            if(size > l->scratch_size) l->scratch_size = size;
+        }
+        r->writer = a2p_writer_create(files[i], r->format.size, buffers);
+    }
+    
+    l->jobs_num = rungs_num * base->planes_num * stripes;
+    l->jobs = malloc(l->jobs_num * sizeof(*l->jobs));
+    l->scratch = malloc(l->jobs_num * l->scratch_size);
+    if(l->jobs == NULL || l->scratch == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate ladder state.\n");
+    }
+    l->jobs_num = 0;
+    for(i = 0; i < rungs_num; i++) {
+        for(p = 0; p < base->planes_num; p++) {
+            height = rungs[i].height[p];
+            rows = (height + stripes - 1) / stripes;
+            for(s = 0; s * rows < height; s++) {
+                l->jobs[l->jobs_num].rung = i;
+                l->jobs[l->jobs_num].plane = p;
+                l->jobs[l->jobs_num].y0 = s * rows;
+                l->jobs[l->jobs_num].y1 = (s + 1) * rows < height ?
+                                          (s + 1) * rows : height;
+                l->jobs_num++;
+            }
+        }
+    }
+    
+    return l;
+}
+
+int
+a2p_ladder_write(A2pLadder *l, const BYTE *frame)
+{
+    A2pLadderRung *r;
+    int i;
+    
+    for(i = 0; i < l->rungs_num; i++) {
+        r = &l->rungs[i];
+        r->buff = a2p_writer_acquire(r->writer);
+        if(r->buff == NULL) return 0;
+        memcpy(r->buff, A2P_FRAME_HEADER, r->format.header);
+    }
+    
+    l->frame = frame;
+    a2p_pool_run(l->pool, a2p_ladder_job, l, l->jobs_num);
+    
+    for(i = 0; i < l->rungs_num; i++) {
+        a2p_writer_commit(l->rungs[i].writer, l->rungs[i].format.size);
+    }
+    
+    return 1;
+}
+
+uint64_t
+a2p_ladder_destroy(A2pLadder *l)
+{
+    A2pLadderRung *r;
+    uint64_t wrote, rung_wrote;
+    int i, p;
+    
+    wrote = 0;
+    for(i = 0; i < l->rungs_num; i++) {
+        r = &l->rungs[i];
+        rung_wrote = a2p_writer_destroy(r->writer);
+        if(i == 0 || rung_wrote < wrote) wrote = rung_wrote;
+        for(p = 0; p < l->base->planes_num; p++) {
+            a2p_scale_destroy(r->scales[p]);
+        }
+    }
+    a2p_pool_destroy(l->pool);
+    free(l->scratch);
+    free(l->jobs);
+    free(l->rungs);
+    free(l);
+    
+    return wrote;
+}
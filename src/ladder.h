@@ -0,0 +1,50 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Lower resolution copies of the rendered video for adaptive streaming.
+// Each packed frame is scaled once per rung on a thread pool, and every
+// rung is queued to its own writer thread.
+
+#ifndef LADDER_H
+#define LADDER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "video.h"
+#include "scale.h"
+
+typedef struct A2pLadder A2pLadder;
+
+// rung i is written to files[i], formats come from a2p_video_rung and the
+// headers are left to the caller
+A2pLadder *
+a2p_ladder_create(const A2pVideoFormat *base, const A2pVideoFormat *rungs,
+                  FILE *const *files, int rungs_num, A2pScaleKernel kernel,
+                  int threads, int buffers);
+
+// scales one packed base frame to every rung, 0 once a rung has failed
+int
+a2p_ladder_write(A2pLadder *ladder, const BYTE *frame);
+
+// returns the fewest frames completely written to any rung
+uint64_t
+a2p_ladder_destroy(A2pLadder *ladder);
+
+#endif // LADDER_H
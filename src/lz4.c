@@ -0,0 +1,176 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include "lz4.h"
+
+#define A2P_LZ4_MIN_MATCH   4
+#define A2P_LZ4_LAST_LITS   5   // the block always ends in literals
+#define A2P_LZ4_MF_LIMIT    12  // and no match starts in its last bytes
+#define A2P_LZ4_MAX_OFFSET  65535
+
+static uint32_t
+a2p_lz4_read32(const uint8_t *p)
+{
+    uint32_t v;
+    
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t
+a2p_lz4_hash(uint32_t seq)
+{
+    return (seq * 2654435761U) >> (32 - A2P_LZ4_TABLE_BITS);
+}
+
+// a length of 15 or more is continued in bytes of 255 and a remainder
+static uint8_t *
+a2p_lz4_length(uint8_t *op, size_t length)
+{
+    for(length -= 15; length >= 255; length -= 255) {
+        *op++ = 255;
+    }
+    *op++ = (uint8_t) length;
+    
+    return op;
+}
+
+// one sequence, match is 0 for the closing literals
+static uint8_t *
+a2p_lz4_sequence(uint8_t *op, const uint8_t *literals, size_t literals_num,
+                 size_t offset, size_t match)
+{
+    uint8_t *token;
+    size_t code;
+    
+    token = op++;
+    *token = (uint8_t) ((literals_num < 15 ? literals_num : 15) << 4);
+    if(literals_num >= 15) op = a2p_lz4_length(op, literals_num);
+    memcpy(op, literals, literals_num);
+    op += literals_num;
+    if(match == 0) return op;
+    
+    *op++ = (uint8_t) offset;
+    *op++ = (uint8_t) (offset >> 8);
+    code = match - A2P_LZ4_MIN_MATCH;
+    *token |= (uint8_t) (code < 15 ? code : 15);
+    if(code >= 15) op = a2p_lz4_length(op, code);
+    
+    return op;
+}
+
+size_t
+a2p_lz4_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t
+a2p_lz4_compress(uint8_t *dst, const uint8_t *src, size_t size,
+                 uint32_t *table)
+{
+    uint8_t *op;
+    uint32_t seq, h;
+    size_t ip, anchor, ref, match;
+    
+    op = dst;
+    ip = 0;
+    anchor = 0;
+    // stale entries only cost a failed compare, positions are all from
+    // this block
+    memset(table, 0, A2P_LZ4_TABLE * sizeof(*table));
+    while(size > A2P_LZ4_MF_LIMIT && ip < size - A2P_LZ4_MF_LIMIT) {
+        seq = a2p_lz4_read32(src + ip);
+        h = a2p_lz4_hash(seq);
+        ref = table[h];
+        table[h] = (uint32_t) ip;
+        if(ref >= ip || ip - ref > A2P_LZ4_MAX_OFFSET ||
+           a2p_lz4_read32(src + ref) != seq) {
+            ip++;
+            continue;
+        }
+        match = A2P_LZ4_MIN_MATCH;
+        while(ip + match < size - A2P_LZ4_LAST_LITS &&
+              src[ref + match] == src[ip + match]) {
+            match++;
+        }
+        op = a2p_lz4_sequence(op, src + anchor, ip - anchor, ip - ref, match);
+        ip += match;
+        anchor = ip;
+    }
+    op = a2p_lz4_sequence(op, src + anchor, size - anchor, 0, 0);
+    
+    return op - dst;
+}
+
+int64_t
+a2p_lz4_decompress(uint8_t *dst, size_t dst_size, const uint8_t *src,
+                   size_t src_size)
+{
+    const uint8_t *ip, *ip_end, *ref;
+    uint8_t *op, *op_end;
+    size_t length, offset;
+    uint8_t token, b;
+    
+    ip = src;
+    ip_end = src + src_size;
+    op = dst;
+    op_end = dst + dst_size;
+    while(ip < ip_end) {
+        token = *ip++;
+        length = token >> 4;
+        if(length == 15) {
+            do {
+                if(ip == ip_end) return -1;
+                b = *ip++;
+                length += b;
+            } while(b == 255);
+        }
+        if(length > (size_t) (ip_end - ip) || length > (size_t) (op_end - op)) {
+            return -1;
+        }
+        memcpy(op, ip, length);
+        op += length;
+        ip += length;
+        if(ip == ip_end) break; // closing literals
+        
+        if(ip_end - ip < 2) return -1;
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if(offset == 0 || offset > (size_t) (op - dst)) return -1;
+        length = token & 15;
+        if(length == 15) {
+            do {
+                if(ip == ip_end) return -1;
+                b = *ip++;
+                length += b;
+            } while(b == 255);
+        }
+        length += A2P_LZ4_MIN_MATCH;
+        if(length > (size_t) (op_end - op)) return -1;
+        // matches may overlap what they copy, so bytewise
+        for(ref = op - offset; length > 0; length--) {
+            *op++ = *ref++;
+        }
+    }
+    
+    return op - dst;
+}
@@ -0,0 +1,52 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// LZ4 block format compression for frames sent over slow links, written
+// for this rather than linked so the build stays one library. Any LZ4
+// block decoder reads the output. A greedy single probe match finder
+// trades ratio for speed, video planes compress mostly through runs.
+
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// entries in the match finder table passed to a2p_lz4_compress
+#define A2P_LZ4_TABLE_BITS 14
+#define A2P_LZ4_TABLE (1 << A2P_LZ4_TABLE_BITS)
+
+// largest output for size bytes of input
+size_t
+a2p_lz4_bound(size_t size);
+
+// compresses size bytes of src into dst, which must hold
+// a2p_lz4_bound(size) bytes, and returns the compressed size
+size_t
+a2p_lz4_compress(uint8_t *dst, const uint8_t *src, size_t size,
+                 uint32_t *table);
+
+// decompresses a whole block, returns the bytes written or -1 for a
+// block that is corrupt or does not fit in dst_size bytes
+int64_t
+a2p_lz4_decompress(uint8_t *dst, size_t dst_size, const uint8_t *src,
+                   size_t src_size);
+
+#endif // LZ4_H
@@ -0,0 +1,105 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <windows.h>
+#include "common.h"
+#include "mapfile.h"
+
+struct A2pMapFile {
+    HANDLE              file;
+    HANDLE              mapping;
+    uint64_t            size;
+    DWORD               granularity;    // view offsets must be multiples
+};
+
+A2pMapFile *
+a2p_map_create(const char *path, uint64_t size)
+{
+    A2pMapFile *map;
+    SYSTEM_INFO info;
+    LARGE_INTEGER end;
+    
+    map = malloc(sizeof(*map));
+    if(map == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate mapped file state.\n");
+    }
+    GetSystemInfo(&info);
+    map->granularity = info.dwAllocationGranularity;
+    map->size = size;
+    
+    map->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(map->file == INVALID_HANDLE_VALUE) {
+        a2p_log(A2P_LOG_ERROR, "cannot open %s for writing.\n", path);
+    }
+    if(GetFileType(map->file) != FILE_TYPE_DISK) {
+        a2p_log(A2P_LOG_ERROR, "%s is not a file on disk.\n", path);
+    }
+    // allocating the whole file up front finds a full disk before the
+    // render starts rather than in the middle of it
+    end.QuadPart = (LONGLONG) size;
+    if(!SetFilePointerEx(map->file, end, NULL, FILE_BEGIN) ||
+       !SetEndOfFile(map->file)) {
+        a2p_log(A2P_LOG_ERROR, "cannot allocate %I64u bytes for %s.\n",
+                size, path);
+    }
+    map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READWRITE,
+                                      (DWORD) (size >> 32), (DWORD) size, NULL);
+    if(map->mapping == NULL) {
+        a2p_log(A2P_LOG_ERROR, "cannot map %s.\n", path);
+    }
+    
+    return map;
+}
+
+void *
+a2p_map_view(A2pMapFile *map, uint64_t offset, size_t size)
+{
+    uint64_t base;
+    BYTE *view;
+    
+    // whole file views do not fit a 32 bit address space, so only the
+    // pages around the piece being written are mapped
+    base = offset - offset % map->granularity;
+    view = MapViewOfFile(map->mapping, FILE_MAP_WRITE, (DWORD) (base >> 32),
+                         (DWORD) base, (SIZE_T) (offset - base + size));
+    if(view == NULL) {
+        a2p_log(A2P_LOG_ERROR, "cannot map %d bytes at %I64u.\n", size,
+                offset);
+    }
+    
+    return view + (offset - base);
+}
+
+void
+a2p_map_unview(A2pMapFile *map, void *view, uint64_t offset)
+{
+    UnmapViewOfFile((BYTE *) view - offset % map->granularity);
+}
+
+void
+a2p_map_destroy(A2pMapFile *map)
+{
+    // dirty pages are written back by the system once the views are gone
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+    free(map);
+}
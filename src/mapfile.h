@@ -0,0 +1,49 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Output files created at their final size and written through mapped
+// views, frames of a fixed size have a known offset so any thread can
+// write any frame straight into its place in the file.
+
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct A2pMapFile A2pMapFile;
+
+// creates path with size bytes, it has to be a file on disk, not a pipe
+A2pMapFile *
+a2p_map_create(const char *path, uint64_t size);
+
+// maps size bytes at offset for writing, views are independent so
+// threads can each map their own
+void *
+a2p_map_view(A2pMapFile *map, uint64_t offset, size_t size);
+
+// unmaps a view returned by a2p_map_view for the same offset
+void
+a2p_map_unview(A2pMapFile *map, void *view, uint64_t offset);
+
+void
+a2p_map_destroy(A2pMapFile *map);
+
+#endif // MAPFILE_H
@@ -0,0 +1,193 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include "mkv.h"
+
+// unknown size, the segment ends with the stream
+#define A2P_MKV_UNKNOWN 0x01ffffffffffffffULL
+
+static uint8_t *
+a2p_mkv_id(uint8_t *p, uint32_t id)
+{
+    // ids keep their length marker, so leading zero bytes are not part
+    if(id > 0xffffff) *p++ = (uint8_t) (id >> 24);
+    if(id > 0xffff) *p++ = (uint8_t) (id >> 16);
+    if(id > 0xff) *p++ = (uint8_t) (id >> 8);
+    *p++ = (uint8_t) id;
+    
+    return p;
+}
+
+// 8 byte vint whatever the value
+static uint8_t *
+a2p_mkv_size(uint8_t *p, uint64_t size)
+{
+    int i;
+    
+    if(size != A2P_MKV_UNKNOWN) size |= 1ULL << 56;
+    for(i = 7; i >= 0; i--) {
+        *p++ = (uint8_t) (size >> (8 * i));
+    }
+    
+    return p;
+}
+
+static uint8_t *
+a2p_mkv_uint(uint8_t *p, uint32_t id, uint64_t value)
+{
+    int i;
+    
+    p = a2p_mkv_id(p, id);
+    *p++ = 0x88;
+    for(i = 7; i >= 0; i--) {
+        *p++ = (uint8_t) (value >> (8 * i));
+    }
+    
+    return p;
+}
+
+static uint8_t *
+a2p_mkv_float(uint8_t *p, uint32_t id, double value)
+{
+    uint64_t bits;
+    
+    memcpy(&bits, &value, sizeof(bits));
+    
+    return a2p_mkv_uint(p, id, bits);
+}
+
+// strings and binary, at most 126 bytes
+static uint8_t *
+a2p_mkv_data(uint8_t *p, uint32_t id, const void *data, size_t size)
+{
+    p = a2p_mkv_id(p, id);
+    *p++ = (uint8_t) (0x80 | size);
+    memcpy(p, data, size);
+    
+    return p + size;
+}
+
+// master elements are opened with room for their size and closed once
+// their children are written
+static uint8_t *
+a2p_mkv_open(uint8_t *p, uint32_t id, uint8_t **size)
+{
+    p = a2p_mkv_id(p, id);
+    *size = p;
+    
+    return p + 8;
+}
+
+static void
+a2p_mkv_close(uint8_t *size, uint8_t *end)
+{
+    a2p_mkv_size(size, end - size - 8);
+}
+
+size_t
+a2p_mkv_header(uint8_t *dst, const A2pMkvInfo *info)
+{
+    uint8_t *p, *ebml, *tracks, *track, *media;
+    const char *codec;
+    
+    p = a2p_mkv_open(dst, 0x1a45dfa3, &ebml);
+    p = a2p_mkv_uint(p, 0x4286, 1);                 // EBMLVersion
+    p = a2p_mkv_uint(p, 0x42f7, 1);                 // EBMLReadVersion
+    p = a2p_mkv_uint(p, 0x42f2, 4);                 // EBMLMaxIDLength
+    p = a2p_mkv_uint(p, 0x42f3, 8);                 // EBMLMaxSizeLength
+    p = a2p_mkv_data(p, 0x4282, "matroska", 8);     // DocType
+    p = a2p_mkv_uint(p, 0x4287, 2);                 // DocTypeVersion
+    p = a2p_mkv_uint(p, 0x4285, 2);                 // DocTypeReadVersion
+    a2p_mkv_close(ebml, p);
+    
+    p = a2p_mkv_id(p, 0x18538067);                  // Segment
+    p = a2p_mkv_size(p, A2P_MKV_UNKNOWN);
+    
+    p = a2p_mkv_open(p, 0x1549a966, &media);        // Info
+    p = a2p_mkv_uint(p, 0x2ad7b1, 1000000);         // TimecodeScale, 1ms
+    p = a2p_mkv_float(p, 0x4489, (double) info->frames * 1000 * // Duration
+                      info->fps_denominator / info->fps_numerator);
+    p = a2p_mkv_data(p, 0x4d80, "avs2pipe", 8);     // MuxingApp
+    p = a2p_mkv_data(p, 0x5741, "avs2pipe", 8);     // WritingApp
+    a2p_mkv_close(media, p);
+    
+    p = a2p_mkv_open(p, 0x1654ae6b, &tracks);       // Tracks
+    p = a2p_mkv_open(p, 0xae, &track);              // TrackEntry
+    p = a2p_mkv_uint(p, 0xd7, A2P_MKV_VIDEO_TRACK); // TrackNumber
+    p = a2p_mkv_uint(p, 0x73c5, A2P_MKV_VIDEO_TRACK); // TrackUID
+    p = a2p_mkv_uint(p, 0x83, 1);                   // TrackType video
+    p = a2p_mkv_uint(p, 0x9c, 0);                   // FlagLacing
+    p = a2p_mkv_data(p, 0x86, "V_UNCOMPRESSED", 14); // CodecID
+    p = a2p_mkv_uint(p, 0x23e383, (uint64_t) 1000000000 * // DefaultDuration
+                     info->fps_denominator / info->fps_numerator);
+    p = a2p_mkv_open(p, 0xe0, &media);              // Video
+    p = a2p_mkv_uint(p, 0xb0, info->width);         // PixelWidth
+    p = a2p_mkv_uint(p, 0xba, info->height);        // PixelHeight
+    p = a2p_mkv_data(p, 0x2eb524, info->fourcc, 4); // ColourSpace
+    a2p_mkv_close(media, p);
+    a2p_mkv_close(track, p);
+    
+    if(info->channels > 0) {
+        codec = info->sample_float ? "A_PCM/FLOAT/IEEE" : "A_PCM/INT/LIT";
+        p = a2p_mkv_open(p, 0xae, &track);
+        p = a2p_mkv_uint(p, 0xd7, A2P_MKV_AUDIO_TRACK);
+        p = a2p_mkv_uint(p, 0x73c5, A2P_MKV_AUDIO_TRACK);
+        p = a2p_mkv_uint(p, 0x83, 2);               // TrackType audio
+        p = a2p_mkv_uint(p, 0x9c, 0);
+        p = a2p_mkv_data(p, 0x86, codec, strlen(codec));
+        p = a2p_mkv_open(p, 0xe1, &media);          // Audio
+        p = a2p_mkv_float(p, 0xb5, info->sample_rate); // SamplingFrequency
+        p = a2p_mkv_uint(p, 0x9f, info->channels);  // Channels
+        p = a2p_mkv_uint(p, 0x6264, info->sample_bits); // BitDepth
+        a2p_mkv_close(media, p);
+        a2p_mkv_close(track, p);
+    }
+    a2p_mkv_close(tracks, p);
+    
+    return p - dst;
+}
+
+size_t
+a2p_mkv_cluster(uint8_t *dst, uint64_t timecode, uint64_t size)
+{
+    uint8_t *p;
+    
+    p = a2p_mkv_id(dst, 0x1f43b675);
+    p = a2p_mkv_size(p, size + 10);
+    p = a2p_mkv_uint(p, 0xe7, timecode);            // Timecode
+    
+    return p - dst;
+}
+
+size_t
+a2p_mkv_block(uint8_t *dst, int track, int timecode, uint64_t size)
+{
+    uint8_t *p;
+    
+    p = a2p_mkv_id(dst, 0xa3);                      // SimpleBlock
+    p = a2p_mkv_size(p, size + 4);
+    *p++ = (uint8_t) (0x80 | track);
+    *p++ = (uint8_t) (timecode >> 8);
+    *p++ = (uint8_t) timecode;
+    *p++ = 0x80;                                    // keyframe
+    
+    return p - dst;
+}
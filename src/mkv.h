@@ -0,0 +1,70 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Minimal Matroska output, a raw video track and an optional pcm audio
+// track in one stream. Each cluster holds one frame and the audio up to
+// the next frame, or a second of the audio left after the last frame, so
+// the streams never drift apart by more than a frame. Element sizes are
+// fixed 8 byte vints so a header can be written before what it holds,
+// the segment has an unknown size so nothing is rewritten at the end.
+// Timecodes are in milliseconds.
+// http://www.matroska.org/technical/specs/index.html
+
+#ifndef MKV_H
+#define MKV_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define A2P_MKV_HEADER_MAX      512 // EBML header, Info and Tracks
+#define A2P_MKV_CLUSTER_HEADER  22  // Cluster id and size, Timecode
+#define A2P_MKV_BLOCK_HEADER    13  // SimpleBlock id and size, track,
+                                    // timecode and flags
+#define A2P_MKV_VIDEO_TRACK     1
+#define A2P_MKV_AUDIO_TRACK     2
+
+typedef struct A2pMkvInfo A2pMkvInfo;
+
+struct A2pMkvInfo {
+    int         width;
+    int         height;
+    char        fourcc[4];          // a2p_video_fourcc of the frames
+    unsigned    fps_numerator;
+    unsigned    fps_denominator;
+    int         frames;
+    int         channels;           // 0 for no audio track
+    int         sample_rate;
+    int         sample_bits;
+    int         sample_float;       // ieee float rather than integer
+};
+
+// writes everything before the first cluster and returns its length
+size_t
+a2p_mkv_header(uint8_t *dst, const A2pMkvInfo *info);
+
+// cluster starting at timecode holding size bytes of blocks
+size_t
+a2p_mkv_cluster(uint8_t *dst, uint64_t timecode, uint64_t size);
+
+// block of size bytes of track, timecode is relative to its cluster
+size_t
+a2p_mkv_block(uint8_t *dst, int track, int timecode, uint64_t size);
+
+#endif // MKV_H
@@ -0,0 +1,344 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <winsock2.h>
+#include <windows.h>
+#include "common.h"
+#include "lz4.h"
+#include "xxh32.h"
+#include "net.h"
+
+// socket buffer for each side, large enough that a frame is sent while
+// the next one is rendered without waiting on acks
+#define A2P_NET_BUFFER (4 * 1024 * 1024)
+
+struct A2pNet {
+    SOCKET      socket;
+};
+
+static void
+a2p_net_startup(void)
+{
+    WSADATA data;
+    
+    // counted by winsock, each a2p_net_close cleans up once
+    if(WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+        a2p_log(A2P_LOG_ERROR, "could not start winsock.\n");
+    }
+}
+
+// host:port into an IPv4 address, an empty host is every interface
+static void
+a2p_net_address(const char *address, struct sockaddr_in *addr)
+{
+    char host[256];
+    const char *colon;
+    struct hostent *entry;
+    int port;
+    
+    colon = strrchr(address, ':');
+    if(colon == NULL || colon - address >= (int) sizeof(host) ||
+       sscanf(colon + 1, "%d", &port) != 1 || port < 1 || port > 65535) {
+        a2p_log(A2P_LOG_ERROR, "invalid address '%s', use host:port.\n",
+                address);
+    }
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+    
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((u_short) port);
+    if(host[0] == '\0') {
+        addr->sin_addr.s_addr = htonl(INADDR_ANY);
+    } else if((addr->sin_addr.s_addr = inet_addr(host)) == INADDR_NONE) {
+        entry = gethostbyname(host);
+        if(entry == NULL || entry->h_addrtype != AF_INET) {
+            a2p_log(A2P_LOG_ERROR, "cannot resolve %s.\n", host);
+        }
+        memcpy(&addr->sin_addr, entry->h_addr_list[0], entry->h_length);
+    }
+}
+
+static A2pNet *
+a2p_net_open(SOCKET s)
+{
+    A2pNet *net;
+    int size;
+    
+    net = malloc(sizeof(*net));
+    if(net == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate connection state.\n");
+    }
+    net->socket = s;
+    size = A2P_NET_BUFFER;
+    setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char *) &size, sizeof(size));
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char *) &size, sizeof(size));
+    
+    return net;
+}
+
+// 1 for an address in 127.0.0.0/8
+static int
+a2p_net_loopback(const struct sockaddr_in *addr)
+{
+    return (ntohl(addr->sin_addr.s_addr) >> 24) == 127;
+}
+
+static A2pNet *
+a2p_net_bind(const char *address, const struct sockaddr_in *addr)
+{
+    SOCKET listener;
+    int reuse;
+    
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(listener == INVALID_SOCKET) {
+        a2p_log(A2P_LOG_ERROR, "could not create socket.\n");
+    }
+    reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char *) &reuse,
+               sizeof(reuse));
+    if(bind(listener, (const struct sockaddr *) addr, sizeof(*addr)) != 0 ||
+       listen(listener, SOMAXCONN) != 0) {
+        a2p_log(A2P_LOG_ERROR, "cannot listen on %s.\n", address);
+    }
+    
+    return a2p_net_open(listener);
+}
+
+A2pNet *
+a2p_net_listen(const char *address)
+{
+    struct sockaddr_in addr;
+    
+    a2p_net_startup();
+    a2p_net_address(address, &addr);
+    
+    return a2p_net_bind(address, &addr);
+}
+
+A2pNet *
+a2p_net_listen_local(const char *address)
+{
+    struct sockaddr_in addr;
+    
+    a2p_net_startup();
+    a2p_net_address(address, &addr);
+    if(addr.sin_addr.s_addr == htonl(INADDR_ANY)) {
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    } else if(!a2p_net_loopback(&addr)) {
+        a2p_log(A2P_LOG_ERROR, "%s is not a loopback address.\n", address);
+    }
+    
+    return a2p_net_bind(address, &addr);
+}
+
+int
+a2p_net_peer_local(A2pNet *net)
+{
+    struct sockaddr_in addr;
+    int size;
+    
+    size = sizeof(addr);
+    if(getpeername(net->socket, (struct sockaddr *) &addr, &size) != 0 ||
+       addr.sin_family != AF_INET) {
+        return 0;
+    }
+    
+    return a2p_net_loopback(&addr);
+}
+
+A2pNet *
+a2p_net_accept(A2pNet *listener)
+{
+    SOCKET s;
+    
+    s = accept(listener->socket, NULL, NULL);
+    if(s == INVALID_SOCKET) return NULL;
+    a2p_net_startup();
+    
+    return a2p_net_open(s);
+}
+
+int
+a2p_net_wait(A2pNet *net, unsigned timeout)
+{
+    fd_set set;
+    struct timeval tv;
+    
+    FD_ZERO(&set);
+    FD_SET(net->socket, &set);
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    
+    return select((int) net->socket + 1, &set, NULL, NULL, &tv) > 0;
+}
+
+A2pNet *
+a2p_net_serve(const char *address)
+{
+    A2pNet *listener, *net;
+    
+    listener = a2p_net_listen(address);
+    a2p_log(A2P_LOG_INFO, "waiting for a client on %s.\n", address);
+    net = a2p_net_accept(listener);
+    a2p_net_close(listener);
+    if(net == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not accept a client on %s.\n", address);
+    }
+    
+    return net;
+}
+
+A2pNet *
+a2p_net_connect(const char *address)
+{
+    struct sockaddr_in addr;
+    SOCKET s;
+    
+    a2p_net_startup();
+    a2p_net_address(address, &addr);
+    s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(s == INVALID_SOCKET) {
+        a2p_log(A2P_LOG_ERROR, "could not create socket.\n");
+    }
+    if(connect(s, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        a2p_log(A2P_LOG_ERROR, "cannot connect to %s.\n", address);
+    }
+    
+    return a2p_net_open(s);
+}
+
+int
+a2p_net_send(A2pNet *net, const void *data, size_t size)
+{
+    const char *p = data;
+    int step;
+    
+    while(size > 0) {
+        step = send(net->socket, p, size < INT_MAX ? (int) size : INT_MAX, 0);
+        if(step <= 0) return 0;
+        p += step;
+        size -= step;
+    }
+    
+    return 1;
+}
+
+int
+a2p_net_recv(A2pNet *net, void *data, size_t size)
+{
+    char *p = data;
+    int step;
+    
+    while(size > 0) {
+        step = recv(net->socket, p, size < INT_MAX ? (int) size : INT_MAX, 0);
+        if(step <= 0) return 0;
+        p += step;
+        size -= step;
+    }
+    
+    return 1;
+}
+
+int
+a2p_net_start(A2pNet *net, const void *header, size_t size)
+{
+    A2pNetHello hello;
+    A2pNetPacket packet;
+    
+    hello.magic = A2P_NET_MAGIC;
+    hello.version = A2P_NET_VERSION;
+    packet.size = (uint32_t) size;
+    packet.packed = (uint32_t) size;
+    packet.hash = a2p_xxh32(header, size, 0);
+    
+    return a2p_net_send(net, &hello, sizeof(hello)) &&
+           a2p_net_send(net, &packet, sizeof(packet)) &&
+           a2p_net_send(net, header, size);
+}
+
+int
+a2p_net_finish(A2pNet *net)
+{
+    A2pNetPacket packet;
+    
+    packet.size = 0;
+    packet.packed = 0;
+    packet.hash = a2p_xxh32(&packet, 0, 0);
+    
+    return a2p_net_send(net, &packet, sizeof(packet));
+}
+
+void
+a2p_net_close(A2pNet *net)
+{
+    // the peer reads everything sent before it sees the close
+    shutdown(net->socket, SD_SEND);
+    closesocket(net->socket);
+    free(net);
+    WSACleanup();
+}
+
+size_t
+a2p_net_bound(size_t size)
+{
+    return sizeof(A2pNetPacket) + a2p_lz4_bound(size);
+}
+
+size_t
+a2p_net_pack(void *dst, const void *src, size_t size, int lz4,
+             uint32_t *table)
+{
+    A2pNetPacket packet;
+    uint8_t *payload;
+    size_t packed;
+    
+    payload = (uint8_t *) dst + sizeof(packet);
+    packet.size = (uint32_t) size;
+    packet.hash = a2p_xxh32(src, size, 0);
+    packed = lz4 ? a2p_lz4_compress(payload, src, size, table) : size;
+    // noise does not compress, it is sent as it is
+    if(packed >= size) {
+        memcpy(payload, src, size);
+        packed = size;
+    }
+    packet.packed = (uint32_t) packed;
+    memcpy(dst, &packet, sizeof(packet));
+    
+    return sizeof(packet) + packed;
+}
+
+int
+a2p_net_unpack(void *dst, const A2pNetPacket *packet, const void *payload)
+{
+    if(packet->packed == packet->size) {
+        memcpy(dst, payload, packet->size);
+    } else if(packet->packed > packet->size ||
+              a2p_lz4_decompress(dst, packet->size, payload,
+                                 packet->packed) != packet->size) {
+        return 0;
+    }
+    
+    return a2p_xxh32(dst, packet->size, 0) == packet->hash;
+}
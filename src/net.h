@@ -0,0 +1,115 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Streams avs2pipe output to another machine over TCP. A connection
+// starts with an A2pNetHello from the server, then a packet holding the
+// y4m or wav stream header, empty for raw video, then a packet per plane
+// of each frame or per second of audio, and ends with an empty packet. Every packet carries
+// the xxh32 of its unpacked bytes and may be LZ4 compressed. Fields are
+// little endian.
+
+#ifndef NET_H
+#define NET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define A2P_NET_MAGIC       0x4E503241  // "A2PN"
+#define A2P_NET_VERSION     1
+
+typedef struct A2pNetHello A2pNetHello;
+typedef struct A2pNetPacket A2pNetPacket;
+typedef struct A2pNet A2pNet;
+
+struct A2pNetHello {
+    uint32_t    magic;
+    uint32_t    version;
+};
+
+struct A2pNetPacket {
+    uint32_t    size;       // unpacked bytes, 0 ends the stream
+    uint32_t    packed;     // bytes that follow, size when stored as is
+    uint32_t    hash;       // xxh32 of the unpacked bytes, seed 0
+};
+
+// listens on address, host:port or :port for every interface
+A2pNet *
+a2p_net_listen(const char *address);
+
+// listens on a loopback address only, :port for 127.0.0.1, so only this
+// machine can connect
+A2pNet *
+a2p_net_listen_local(const char *address);
+
+// 1 when the other end of a connection is on this machine
+int
+a2p_net_peer_local(A2pNet *net);
+
+// waits for the next client of a listener, NULL if that failed
+A2pNet *
+a2p_net_accept(A2pNet *listener);
+
+// 1 once a listener has a client waiting or a connection has data to
+// read, 0 after timeout ms
+int
+a2p_net_wait(A2pNet *net, unsigned timeout);
+
+// listens on address and waits for one client
+A2pNet *
+a2p_net_serve(const char *address);
+
+A2pNet *
+a2p_net_connect(const char *address);
+
+// sends or receives all size bytes, 0 if the connection failed first
+int
+a2p_net_send(A2pNet *net, const void *data, size_t size);
+
+int
+a2p_net_recv(A2pNet *net, void *data, size_t size);
+
+// sends the hello and the stream header packet
+int
+a2p_net_start(A2pNet *net, const void *header, size_t size);
+
+// sends the empty packet that ends the stream
+int
+a2p_net_finish(A2pNet *net);
+
+void
+a2p_net_close(A2pNet *net);
+
+// largest packet a2p_net_pack makes of size bytes
+size_t
+a2p_net_bound(size_t size);
+
+// writes size bytes of src as a packet at dst and returns its length,
+// compressed when lz4 is set and it saves space, table is the
+// A2P_LZ4_TABLE scratch of the compressor
+size_t
+a2p_net_pack(void *dst, const void *src, size_t size, int lz4,
+             uint32_t *table);
+
+// unpacks a received payload into dst, which holds packet->size bytes,
+// 0 if it is corrupt
+int
+a2p_net_unpack(void *dst, const A2pNetPacket *packet, const void *payload);
+
+#endif // NET_H
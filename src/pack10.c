@@ -0,0 +1,159 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cpu.h"
+#include "pack10.h"
+
+static void a2p_p010_luma_detect(uint16_t *, const uint16_t *, int);
+static void a2p_p010_chroma_detect(uint16_t *, const uint16_t *,
+                                   const uint16_t *, int);
+static void a2p_v210_row_detect(uint8_t *, const uint16_t *,
+                                const uint16_t *, const uint16_t *, int);
+
+static A2pP010LumaFunc a2p_p010_luma_func = a2p_p010_luma_detect;
+static A2pP010ChromaFunc a2p_p010_chroma_func = a2p_p010_chroma_detect;
+static A2pV210Func a2p_v210_row_func = a2p_v210_row_detect;
+
+// first call picks the kernels, racing threads all pick the same ones
+static void
+a2p_pack10_select(void)
+{
+    int flags;
+    
+    flags = a2p_cpu_flags();
+    a2p_p010_luma_func = flags & A2P_CPU_SSE2 ?
+                         a2p_p010_luma_sse2 : a2p_p010_luma_c;
+    a2p_p010_chroma_func = flags & A2P_CPU_SSE2 ?
+                           a2p_p010_chroma_sse2 : a2p_p010_chroma_c;
+    a2p_v210_row_func = flags & A2P_CPU_SSSE3 ?
+                        a2p_v210_row_ssse3 : a2p_v210_row_c;
+}
+
+static void
+a2p_p010_luma_detect(uint16_t *dst, const uint16_t *y, int width)
+{
+    a2p_pack10_select();
+    a2p_p010_luma_func(dst, y, width);
+}
+
+static void
+a2p_p010_chroma_detect(uint16_t *dst, const uint16_t *u, const uint16_t *v,
+                       int width)
+{
+    a2p_pack10_select();
+    a2p_p010_chroma_func(dst, u, v, width);
+}
+
+static void
+a2p_v210_row_detect(uint8_t *dst, const uint16_t *y, const uint16_t *u,
+                    const uint16_t *v, int width)
+{
+    a2p_pack10_select();
+    a2p_v210_row_func(dst, y, u, v, width);
+}
+
+void
+a2p_widen_10(uint16_t *dst, const void *src, int width, int depth)
+{
+    const uint8_t *in8 = src;
+    const uint16_t *in16 = src;
+    int x;
+    
+    if(depth == 8) {
+        for(x = 0; x < width; x++) {
+            dst[x] = (uint16_t) (in8[x] << 2);
+        }
+    } else {
+        for(x = 0; x < width; x++) {
+            dst[x] = (uint16_t) (in16[x] << (10 - depth));
+        }
+    }
+}
+
+void
+a2p_p010_luma(uint16_t *dst, const uint16_t *y, int width)
+{
+    a2p_p010_luma_func(dst, y, width);
+}
+
+void
+a2p_p010_chroma(uint16_t *dst, const uint16_t *u, const uint16_t *v,
+                int width)
+{
+    a2p_p010_chroma_func(dst, u, v, width);
+}
+
+void
+a2p_v210_row(uint8_t *dst, const uint16_t *y, const uint16_t *u,
+             const uint16_t *v, int width)
+{
+    a2p_v210_row_func(dst, y, u, v, width);
+}
+
+void
+a2p_p010_luma_c(uint16_t *dst, const uint16_t *y, int width)
+{
+    int x;
+    
+    for(x = 0; x < width; x++) {
+        dst[x] = (uint16_t) (y[x] << 6);
+    }
+}
+
+void
+a2p_p010_chroma_c(uint16_t *dst, const uint16_t *u, const uint16_t *v,
+                  int width)
+{
+    int x;
+    
+    for(x = 0; x < width; x++) {
+        dst[2 * x]     = (uint16_t) (u[x] << 6);
+        dst[2 * x + 1] = (uint16_t) (v[x] << 6);
+    }
+}
+
+void
+a2p_v210_row_c(uint8_t *dst, const uint16_t *y, const uint16_t *u,
+               const uint16_t *v, int width)
+{
+    uint32_t s[12], word;
+    int x, i, c;
+    
+    for(x = 0; x < width; x += 6) {
+        // Cb0 Y0 Cr0 Y1 Cb1 Y2 Cr1 Y3 Cb2 Y4 Cr2 Y5, missing samples are 0
+        for(i = 0; i < 6; i++) {
+            s[2 * i + 1] = x + i < width ? y[x + i] & 0x3ff : 0;
+        }
+        for(i = 0; i < 3; i++) {
+            c = x / 2 + i;
+            s[4 * i] = 2 * c < width ? u[c] & 0x3ff : 0;
+            s[4 * i + 2] = 2 * c < width ? v[c] & 0x3ff : 0;
+        }
+        // three samples per little endian word
+        for(i = 0; i < 4; i++) {
+            word = s[3 * i] | s[3 * i + 1] << 10 | s[3 * i + 2] << 20;
+            dst[4 * i]     = (uint8_t) word;
+            dst[4 * i + 1] = (uint8_t) (word >> 8);
+            dst[4 * i + 2] = (uint8_t) (word >> 16);
+            dst[4 * i + 3] = (uint8_t) (word >> 24);
+        }
+        dst += 16;
+    }
+}
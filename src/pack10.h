@@ -0,0 +1,81 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Row kernels for the packed 10 bit raw outputs. Input rows hold 10 bit
+// samples in 16 bits. P010 is a Y plane and an interleaved UV plane of
+// samples in the top 10 bits, v210 packs 4:2:2 as three samples per 32 bit
+// word with rows padded to 128 bytes.
+
+#ifndef PACK10_H
+#define PACK10_H
+
+#include <stdint.h>
+
+#define A2P_V210_STRIDE(width) ((((width) + 47) / 48) * 128)
+
+typedef void (*A2pP010LumaFunc)(uint16_t *dst, const uint16_t *y,
+                                int width);
+typedef void (*A2pP010ChromaFunc)(uint16_t *dst, const uint16_t *u,
+                                  const uint16_t *v, int width);
+typedef void (*A2pV210Func)(uint8_t *dst, const uint16_t *y,
+                            const uint16_t *u, const uint16_t *v, int width);
+
+// 8 or 9 bit samples to 10 bit, src holds bytes when depth is 8
+void
+a2p_widen_10(uint16_t *dst, const void *src, int width, int depth);
+
+void
+a2p_p010_luma(uint16_t *dst, const uint16_t *y, int width);
+
+// width is the chroma width, 2 * width samples are written
+void
+a2p_p010_chroma(uint16_t *dst, const uint16_t *u, const uint16_t *v,
+                int width);
+
+// width is the luma width, the last group of 6 is zero filled, the row
+// padding up to A2P_V210_STRIDE is left to the caller
+void
+a2p_v210_row(uint8_t *dst, const uint16_t *y, const uint16_t *u,
+             const uint16_t *v, int width);
+
+// kernels, only call the simd ones when a2p_cpu_flags reports support
+void
+a2p_p010_luma_c(uint16_t *dst, const uint16_t *y, int width);
+
+void
+a2p_p010_luma_sse2(uint16_t *dst, const uint16_t *y, int width);
+
+void
+a2p_p010_chroma_c(uint16_t *dst, const uint16_t *u, const uint16_t *v,
+                  int width);
+
+void
+a2p_p010_chroma_sse2(uint16_t *dst, const uint16_t *u, const uint16_t *v,
+                     int width);
+
+void
+a2p_v210_row_c(uint8_t *dst, const uint16_t *y, const uint16_t *u,
+               const uint16_t *v, int width);
+
+void
+a2p_v210_row_ssse3(uint8_t *dst, const uint16_t *y, const uint16_t *u,
+                   const uint16_t *v, int width);
+
+#endif // PACK10_H
@@ -0,0 +1,56 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// built with -msse2 by gcc, only called when the cpu reports sse2
+
+#include <emmintrin.h>
+#include "pack10.h"
+
+void
+a2p_p010_luma_sse2(uint16_t *dst, const uint16_t *y, int width)
+{
+    __m128i a, b;
+    int x;
+    
+    for(x = 0; x + 16 <= width; x += 16) {
+        a = _mm_loadu_si128((const __m128i *) (y + x));
+        b = _mm_loadu_si128((const __m128i *) (y + x + 8));
+        _mm_storeu_si128((__m128i *) (dst + x), _mm_slli_epi16(a, 6));
+        _mm_storeu_si128((__m128i *) (dst + x + 8), _mm_slli_epi16(b, 6));
+    }
+    a2p_p010_luma_c(dst + x, y + x, width - x);
+}
+
+void
+a2p_p010_chroma_sse2(uint16_t *dst, const uint16_t *u, const uint16_t *v,
+                     int width)
+{
+    __m128i a, b;
+    int x;
+    
+    for(x = 0; x + 8 <= width; x += 8) {
+        a = _mm_slli_epi16(_mm_loadu_si128((const __m128i *) (u + x)), 6);
+        b = _mm_slli_epi16(_mm_loadu_si128((const __m128i *) (v + x)), 6);
+        _mm_storeu_si128((__m128i *) (dst + 2 * x), _mm_unpacklo_epi16(a, b));
+        _mm_storeu_si128((__m128i *) (dst + 2 * x + 8),
+                         _mm_unpackhi_epi16(a, b));
+    }
+    a2p_p010_chroma_c(dst + 2 * x, u + x, v + x, width - x);
+}
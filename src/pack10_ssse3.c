@@ -0,0 +1,67 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// built with -mssse3 by gcc, only called when the cpu reports ssse3
+
+#include <tmmintrin.h>
+#include "pack10.h"
+
+// each group of 6 pixels is 4 words of three samples, word k is
+// a[k] | b[k] << 10 | c[k] << 20 with
+//   a = Cb0 Y1 Cr1 Y4, b = Y0 Cb1 Y3 Cr2, c = Cr0 Y2 Cb2 Y5
+// gathered from 8 luma samples and the interleaved Cb Cr pairs
+
+void
+a2p_v210_row_ssse3(uint8_t *dst, const uint16_t *y, const uint16_t *u,
+                   const uint16_t *v, int width)
+{
+    __m128i ya, yb, yc, ca, cb, cc, mask, ys, uv, a, b, c;
+    int x;
+    
+    ya = _mm_setr_epi8(-1, -1, -1, -1, 2, 3, -1, -1,
+                       -1, -1, -1, -1, 8, 9, -1, -1);
+    yb = _mm_setr_epi8(0, 1, -1, -1, -1, -1, -1, -1,
+                       6, 7, -1, -1, -1, -1, -1, -1);
+    yc = _mm_setr_epi8(-1, -1, -1, -1, 4, 5, -1, -1,
+                       -1, -1, -1, -1, 10, 11, -1, -1);
+    ca = _mm_setr_epi8(0, 1, -1, -1, -1, -1, -1, -1,
+                       6, 7, -1, -1, -1, -1, -1, -1);
+    cb = _mm_setr_epi8(-1, -1, -1, -1, 4, 5, -1, -1,
+                       -1, -1, -1, -1, 10, 11, -1, -1);
+    cc = _mm_setr_epi8(2, 3, -1, -1, -1, -1, -1, -1,
+                       8, 9, -1, -1, -1, -1, -1, -1);
+    mask = _mm_set1_epi32(0x3ff);
+    
+    // loads read 8 luma and 4 chroma samples for the 6 pixels used
+    for(x = 0; x + 8 <= width; x += 6) {
+        ys = _mm_loadu_si128((const __m128i *) (y + x));
+        uv = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) (u + x / 2)),
+                                _mm_loadl_epi64((const __m128i *) (v + x / 2)));
+        a = _mm_or_si128(_mm_shuffle_epi8(ys, ya), _mm_shuffle_epi8(uv, ca));
+        b = _mm_or_si128(_mm_shuffle_epi8(ys, yb), _mm_shuffle_epi8(uv, cb));
+        c = _mm_or_si128(_mm_shuffle_epi8(ys, yc), _mm_shuffle_epi8(uv, cc));
+        a = _mm_and_si128(a, mask);
+        b = _mm_slli_epi32(_mm_and_si128(b, mask), 10);
+        c = _mm_slli_epi32(_mm_and_si128(c, mask), 20);
+        _mm_storeu_si128((__m128i *) dst, _mm_or_si128(a, _mm_or_si128(b, c)));
+        dst += 16;
+    }
+    a2p_v210_row_c(dst, y + x, u + x / 2, v + x / 2, width - x);
+}
@@ -0,0 +1,141 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "common.h"
+#include "cpu.h"
+#include "pcm.h"
+
+static void a2p_pcm_16_detect(void *, const float *, size_t, uint32_t *,
+                              float);
+static void a2p_pcm_24_detect(void *, const float *, size_t, uint32_t *,
+                              float);
+
+static A2pPcmFunc a2p_pcm_16_func = a2p_pcm_16_detect;
+static A2pPcmFunc a2p_pcm_24_func = a2p_pcm_24_detect;
+
+// first call picks the kernels, racing threads all pick the same ones
+static void
+a2p_pcm_select(void)
+{
+    int flags;
+    
+    flags = a2p_cpu_flags();
+    a2p_pcm_16_func = flags & A2P_CPU_SSE2 ? a2p_pcm_16_sse2 : a2p_pcm_16_c;
+    a2p_pcm_24_func = flags & A2P_CPU_SSE2 ? a2p_pcm_24_sse2 : a2p_pcm_24_c;
+}
+
+static void
+a2p_pcm_16_detect(void *dst, const float *src, size_t count, uint32_t *seed,
+                  float noise)
+{
+    a2p_pcm_select();
+    a2p_pcm_16_func(dst, src, count, seed, noise);
+}
+
+static void
+a2p_pcm_24_detect(void *dst, const float *src, size_t count, uint32_t *seed,
+                  float noise)
+{
+    a2p_pcm_select();
+    a2p_pcm_24_func(dst, src, count, seed, noise);
+}
+
+void
+a2p_pcm_init(A2pPcm *pcm, int bits, int dither)
+{
+    pcm->bits = bits;
+    // the difference of two 16 bit uniform values is triangular over
+    // +-1 lsb once scaled by 1 / 65536
+    pcm->noise = dither ? 1.0f / 65536 : 0.0f;
+    pcm->seed[0] = 0x2545f491;
+    pcm->seed[1] = 0x9e3779b9;
+    pcm->seed[2] = 0x6a09e667;
+    pcm->seed[3] = 0xbb67ae85;
+}
+
+void
+a2p_pcm_convert(A2pPcm *pcm, void *dst, const float *src, size_t count)
+{
+    if(pcm->bits == 16) {
+        a2p_pcm_16_func(dst, src, count, pcm->seed, pcm->noise);
+    } else {
+        a2p_pcm_24_func(dst, src, count, pcm->seed, pcm->noise);
+    }
+}
+
+// scaled sample plus noise, clipped to the output range and rounded
+// half to even like the simd conversions, halves are common in 24 bit
+static int32_t
+a2p_pcm_sample(float v, float scale, uint32_t *seed, float noise)
+{
+    volatile float sum;
+    uint32_t s;
+    int32_t r;
+    
+    s = *seed;
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    *seed = s;
+    // scale and noise are powers of two so both products are exact, but
+    // x87 keeps the sum in extended precision where sse2 rounds it to
+    // float, the store rounds it the same way
+    sum = v * scale + (float) ((int32_t) (s & 0xffff) -
+                               (int32_t) (s >> 16)) * noise;
+    v = sum;
+    if(v < -scale) v = -scale;
+    if(v > scale - 1) v = scale - 1;
+    r = (int32_t) floor((double) v + 0.5);
+    if(r - (double) v == 0.5 && (r & 1)) r--;
+    
+    return r;
+}
+
+void
+a2p_pcm_16_c(void *dst, const float *src, size_t count, uint32_t *seed,
+             float noise)
+{
+    int16_t *out = dst;
+    size_t i;
+    
+    for(i = 0; i < count; i++) {
+        out[i] = (int16_t) a2p_pcm_sample(src[i], 32768.0f, &seed[i & 3],
+                                          noise);
+    }
+}
+
+void
+a2p_pcm_24_c(void *dst, const float *src, size_t count, uint32_t *seed,
+             float noise)
+{
+    uint8_t *out = dst;
+    int32_t v;
+    size_t i;
+    
+    for(i = 0; i < count; i++) {
+        v = a2p_pcm_sample(src[i], 8388608.0f, &seed[i & 3], noise);
+        out[3 * i] = (uint8_t) v;
+        out[3 * i + 1] = (uint8_t) (v >> 8);
+        out[3 * i + 2] = (uint8_t) (v >> 16);
+    }
+}
@@ -0,0 +1,69 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Float audio written as 16 or 24 bit pcm. Samples are scaled, TPDF
+// dithered, clipped and rounded while being copied into the write buffer,
+// so scripts can skip ConvertAudioTo16bit. The dither noise comes from one
+// xorshift generator per simd lane, sample i of a call uses lane i & 3,
+// so every kernel writes the same samples.
+
+#ifndef PCM_H
+#define PCM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct A2pPcm A2pPcm;
+
+typedef void (*A2pPcmFunc)(void *dst, const float *src, size_t count,
+                           uint32_t *seed, float noise);
+
+struct A2pPcm {
+    int         bits;                   // 16 or 24
+    float       noise;                  // tpdf scale, 0 for no dither
+    uint32_t    seed[4];                // noise generator of each lane
+};
+
+void
+a2p_pcm_init(A2pPcm *pcm, int bits, int dither);
+
+// count is samples times channels, dst gets bits / 8 bytes for each
+void
+a2p_pcm_convert(A2pPcm *pcm, void *dst, const float *src, size_t count);
+
+// kernels, only call the simd ones when a2p_cpu_flags reports support,
+// noise is the step between dither levels in output lsbs
+void
+a2p_pcm_16_c(void *dst, const float *src, size_t count, uint32_t *seed,
+             float noise);
+
+void
+a2p_pcm_16_sse2(void *dst, const float *src, size_t count, uint32_t *seed,
+                float noise);
+
+void
+a2p_pcm_24_c(void *dst, const float *src, size_t count, uint32_t *seed,
+             float noise);
+
+void
+a2p_pcm_24_sse2(void *dst, const float *src, size_t count, uint32_t *seed,
+                float noise);
+
+#endif // PCM_H
@@ -0,0 +1,114 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// built with -msse2 by gcc, only called when the cpu reports sse2
+
+#include <string.h>
+#include <emmintrin.h>
+#include "pcm.h"
+
+// next noise of each lane, as a2p_pcm_sample
+static __m128i
+a2p_pcm_next(__m128i s)
+{
+    s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+    s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+    
+    return _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+}
+
+// 4 samples scaled, dithered and clipped, converted with rounding
+static __m128i
+a2p_pcm_scale(const float *src, __m128 scale, __m128 lo, __m128 hi,
+              __m128i s, __m128 noise)
+{
+    __m128i tri;
+    __m128 v;
+    
+    tri = _mm_sub_epi32(_mm_and_si128(s, _mm_set1_epi32(0xffff)),
+                        _mm_srli_epi32(s, 16));
+    v = _mm_mul_ps(_mm_loadu_ps(src), scale);
+    v = _mm_add_ps(v, _mm_mul_ps(_mm_cvtepi32_ps(tri), noise));
+    v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+    
+    return _mm_cvtps_epi32(v);
+}
+
+void
+a2p_pcm_16_sse2(void *dst, const float *src, size_t count, uint32_t *seed,
+                float noise)
+{
+    __m128i s, a, b;
+    __m128 scale, lo, hi, n;
+    int16_t *out = dst;
+    size_t i;
+    
+    s = _mm_loadu_si128((const __m128i *) seed);
+    scale = _mm_set1_ps(32768.0f);
+    lo = _mm_set1_ps(-32768.0f);
+    hi = _mm_set1_ps(32767.0f);
+    n = _mm_set1_ps(noise);
+    for(i = 0; i + 8 <= count; i += 8) {
+        s = a2p_pcm_next(s);
+        a = a2p_pcm_scale(src + i, scale, lo, hi, s, n);
+        s = a2p_pcm_next(s);
+        b = a2p_pcm_scale(src + i + 4, scale, lo, hi, s, n);
+        _mm_storeu_si128((__m128i *) (out + i), _mm_packs_epi32(a, b));
+    }
+    _mm_storeu_si128((__m128i *) seed, s);
+    // i is a multiple of 4 so the tail starts on lane 0
+    a2p_pcm_16_c(out + i, src + i, count - i, seed, noise);
+}
+
+void
+a2p_pcm_24_sse2(void *dst, const float *src, size_t count, uint32_t *seed,
+                float noise)
+{
+    __m128i s, v, low, even, half;
+    __m128 scale, lo, hi, n;
+    uint8_t *out = dst;
+    uint32_t last;
+    size_t i;
+    
+    s = _mm_loadu_si128((const __m128i *) seed);
+    scale = _mm_set1_ps(8388608.0f);
+    lo = _mm_set1_ps(-8388608.0f);
+    hi = _mm_set1_ps(8388607.0f);
+    n = _mm_set1_ps(noise);
+    low = _mm_set1_epi32(0x00ffffff);
+    even = _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff);
+    half = _mm_set_epi32(0, 0, 0x0000ffff, 0xffffffff);
+    for(i = 0; i + 4 <= count; i += 4) {
+        s = a2p_pcm_next(s);
+        v = _mm_and_si128(a2p_pcm_scale(src + i, scale, lo, hi, s, n), low);
+        // the odd sample of each 64 bit half moves down against the even
+        // one, then the upper 6 bytes move down against the lower 6
+        v = _mm_or_si128(_mm_and_si128(v, even),
+                         _mm_srli_epi64(_mm_andnot_si128(even, v), 8));
+        v = _mm_or_si128(_mm_and_si128(v, half),
+                         _mm_andnot_si128(half, _mm_srli_si128(v, 2)));
+        _mm_storel_epi64((__m128i *) (out + 3 * i), v);
+        last = (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+        memcpy(out + 3 * i + 8, &last, 4);
+    }
+    _mm_storeu_si128((__m128i *) seed, s);
+    // i is a multiple of 4 so the tail starts on lane 0
+    a2p_pcm_24_c(out + 3 * i, src + i, count - i, seed, noise);
+}
@@ -0,0 +1,166 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <windows.h>
+#include <process.h>
+#include "common.h"
+#include "pool.h"
+
+#define A2P_POOL_PARKED 0x3fffffff
+
+struct A2pPool {
+    int                 threads;    // workers, the caller is one more
+    HANDLE             *workers;
+    HANDLE              start;      // released once per worker per task
+    HANDLE              done;       // set when the last job finishes
+    CRITICAL_SECTION    lock;       // one task at a time
+    
+    A2pPoolFunc         func;
+    void               *data;
+    int                 jobs;
+    volatile LONG       next;       // next job to run
+    volatile LONG       left;       // jobs not yet finished
+    volatile LONG       stop;
+};
+
+static void
+a2p_pool_work(A2pPool *pool)
+{
+    LONG job;
+    
+    while((job = InterlockedIncrement(&pool->next) - 1) < pool->jobs) {
+        pool->func(pool->data, job);
+        if(InterlockedDecrement(&pool->left) == 0) SetEvent(pool->done);
+    }
+}
+
+static unsigned __stdcall
+a2p_pool_worker(void *data)
+{
+    A2pPool *pool = data;
+    
+    for(;;) {
+        WaitForSingleObject(pool->start, INFINITE);
+        if(pool->stop) break;
+        a2p_pool_work(pool);
+    }
+    
+    return 0;
+}
+
+int
+a2p_cpu_count(void)
+{
+    SYSTEM_INFO info;
+    
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int) info.dwNumberOfProcessors : 1;
+}
+
+A2pPool *
+a2p_pool_create(int threads)
+{
+    A2pPool *pool;
+    int i;
+    
+    if(threads < 1) threads = a2p_cpu_count();
+    
+    pool = malloc(sizeof(*pool));
+    if(pool == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate thread pool.\n");
+    }
+    pool->threads = threads - 1;
+    pool->stop = 0;
+    pool->jobs = 0;
+    pool->next = 0;
+    pool->left = 0;
+    InitializeCriticalSection(&pool->lock);
+    pool->start = CreateSemaphore(NULL, 0, threads, NULL);
+    pool->done = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if(pool->start == NULL || pool->done == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not create thread pool events.\n");
+    }
+    
+    pool->workers = malloc((pool->threads + 1) * sizeof(*pool->workers));
+    if(pool->workers == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate thread pool.\n");
+    }
+    for(i = 0; i < pool->threads; i++) {
+        pool->workers[i] = (HANDLE) _beginthreadex(NULL, 0, a2p_pool_worker,
+                                                   pool, 0, NULL);
+        if(pool->workers[i] == 0) {
+            a2p_log(A2P_LOG_ERROR, "could not start pool thread.\n");
+        }
+    }
+    
+    return pool;
+}
+
+int
+a2p_pool_threads(const A2pPool *pool)
+{
+    return pool->threads + 1;
+}
+
+void
+a2p_pool_run(A2pPool *pool, A2pPoolFunc func, void *data, int jobs)
+{
+    if(jobs <= 0) return;
+    
+    EnterCriticalSection(&pool->lock);
+    // a worker woken late for the last task must not claim a job before
+    // the new task is fully set up, so park next past any job count
+    InterlockedExchange(&pool->next, A2P_POOL_PARKED);
+    pool->func = func;
+    pool->data = data;
+    pool->jobs = jobs;
+    pool->left = jobs;
+    // full barrier, workers see the task before they see next reset
+    InterlockedExchange(&pool->next, 0);
+    
+    if(pool->threads > 0) {
+        ReleaseSemaphore(pool->start, jobs - 1 < pool->threads ?
+                                      jobs - 1 : pool->threads, NULL);
+    }
+    a2p_pool_work(pool);
+    WaitForSingleObject(pool->done, INFINITE);
+    LeaveCriticalSection(&pool->lock);
+}
+
+void
+a2p_pool_destroy(A2pPool *pool)
+{
+    int i;
+    
+    InterlockedExchange(&pool->stop, 1);
+    if(pool->threads > 0) {
+        ReleaseSemaphore(pool->start, pool->threads, NULL);
+    }
+    for(i = 0; i < pool->threads; i++) {
+        WaitForSingleObject(pool->workers[i], INFINITE);
+        CloseHandle(pool->workers[i]);
+    }
+    CloseHandle(pool->start);
+    CloseHandle(pool->done);
+    DeleteCriticalSection(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
@@ -0,0 +1,50 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Fixed set of worker threads that run the jobs of one task at a time,
+// used to split frame processing into row stripes.
+
+#ifndef POOL_H
+#define POOL_H
+
+typedef struct A2pPool A2pPool;
+
+typedef void (*A2pPoolFunc)(void *data, int job);
+
+// threads < 1 uses one thread per processor
+A2pPool *
+a2p_pool_create(int threads);
+
+int
+a2p_pool_threads(const A2pPool *pool);
+
+// runs func(data, job) for every job in [0, jobs) and waits for them all,
+// the calling thread works through jobs too
+void
+a2p_pool_run(A2pPool *pool, A2pPoolFunc func, void *data, int jobs);
+
+void
+a2p_pool_destroy(A2pPool *pool);
+
+// number of processors, used as a default thread count
+int
+a2p_cpu_count(void);
+
+#endif // POOL_H
@@ -0,0 +1,175 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <windows.h>
+#include <process.h>
+#include "common.h"
+#include "prefetch.h"
+
+struct A2pPrefetch {
+    AVS_ScriptEnvironment  *env;
+    AVS_Clip               *clip;
+    const A2pVideoFormat   *format;
+    
+    int                     threads;
+    int                     depth;        // slots in the reorder buffer
+    int                     next;         // next frame a worker will claim
+    int                     end;          // one past the last frame
+    int                     consumed;     // next frame handed out in order
+    volatile LONG           stop;
+    
+    BYTE                  **slots;        // frame n is packed in n % depth
+    HANDLE                 *ready;        // per slot, released when packed
+    HANDLE                  window;       // counts free slots
+    HANDLE                 *workers;
+    CRITICAL_SECTION        claim;
+};
+
+static unsigned __stdcall
+a2p_prefetch_worker(void *data)
+{
+    A2pPrefetch *pf = data;
+    AVS_VideoFrame *frame;
+    int n;
+    
+    for(;;) {
+        // at most depth frames are claimed and not yet consumed, so by the
+        // time frame n is claimed frame n - depth has left slot n % depth
+        WaitForSingleObject(pf->window, INFINITE);
+        
+        EnterCriticalSection(&pf->claim);
+        n = pf->next;
+        if(!pf->stop && n < pf->end) pf->next++;
+        LeaveCriticalSection(&pf->claim);
+        
+        if(pf->stop || n >= pf->end) {
+            // pass the wake up on so every worker sees the end
+            ReleaseSemaphore(pf->window, 1, NULL);
+            break;
+        }
+        
+        frame = avs_get_frame(pf->clip, n);
+        a2p_video_pack(pf->env, pf->format, frame, pf->slots[n % pf->depth]);
+        avs_release_frame(frame);
+        
+        ReleaseSemaphore(pf->ready[n % pf->depth], 1, NULL);
+    }
+    
+    return 0;
+}
+
+A2pPrefetch *
+a2p_prefetch_create(AVS_ScriptEnvironment *env, AVS_Clip *clip,
+                    const A2pVideoFormat *format, int threads, int depth,
+                    int start, int end)
+{
+    A2pPrefetch *pf;
+    int i;
+    
+    if(depth < threads) depth = threads; // every worker needs a slot
+    
+    pf = malloc(sizeof(*pf));
+    if(pf == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate prefetch state.\n");
+    }
+    pf->env = env;
+    pf->clip = clip;
+    pf->format = format;
+    pf->threads = threads;
+    pf->depth = depth;
+    pf->next = start;
+    pf->end = end;
+    pf->consumed = start;
+    pf->stop = 0;
+    
+    pf->slots = malloc(depth * sizeof(*pf->slots));
+    pf->ready = malloc(depth * sizeof(*pf->ready));
+    pf->workers = malloc(threads * sizeof(*pf->workers));
+    if(pf->slots == NULL || pf->ready == NULL || pf->workers == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate prefetch state.\n");
+    }
+    
+    InitializeCriticalSection(&pf->claim);
+    pf->window = CreateSemaphore(NULL, depth, depth, NULL);
+    for(i = 0; i < depth; i++) {
+        pf->slots[i] = a2p_video_alloc(format);
+        pf->ready[i] = CreateSemaphore(NULL, 0, 1, NULL);
+        if(pf->ready[i] == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not create prefetch semaphore.\n");
+        }
+    }
+    if(pf->window == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not create prefetch semaphore.\n");
+    }
+    
+    a2p_log(A2P_LOG_INFO, "prefetching %d frames with %d threads.\n",
+            depth, threads);
+    
+    for(i = 0; i < threads; i++) {
+        pf->workers[i] = (HANDLE) _beginthreadex(NULL, 0, a2p_prefetch_worker,
+                                                 pf, 0, NULL);
+        if(pf->workers[i] == 0) {
+            a2p_log(A2P_LOG_ERROR, "could not start prefetch thread.\n");
+        }
+    }
+    
+    return pf;
+}
+
+BYTE *
+a2p_prefetch_next(A2pPrefetch *pf)
+{
+    WaitForSingleObject(pf->ready[pf->consumed % pf->depth], INFINITE);
+    return pf->slots[pf->consumed % pf->depth];
+}
+
+void
+a2p_prefetch_release(A2pPrefetch *pf)
+{
+    pf->consumed++;
+    ReleaseSemaphore(pf->window, 1, NULL);
+}
+
+void
+a2p_prefetch_destroy(A2pPrefetch *pf)
+{
+    int i;
+    
+    // stop claiming frames and wake any worker waiting on a free slot
+    InterlockedExchange(&pf->stop, 1);
+    ReleaseSemaphore(pf->window, 1, NULL);
+    
+    for(i = 0; i < pf->threads; i++) {
+        WaitForSingleObject(pf->workers[i], INFINITE);
+        CloseHandle(pf->workers[i]);
+    }
+    for(i = 0; i < pf->depth; i++) {
+        CloseHandle(pf->ready[i]);
+        free(pf->slots[i]);
+    }
+    CloseHandle(pf->window);
+    DeleteCriticalSection(&pf->claim);
+    
+    free(pf->workers);
+    free(pf->ready);
+    free(pf->slots);
+    free(pf);
+}
@@ -0,0 +1,48 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Threaded frame prefetch, worker threads render up to depth frames ahead
+// of the writer into a reorder buffer which is handed out in frame order.
+// Concurrent avs_get_frame calls need a thread safe AviSynth (SetMTMode).
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include "video.h"
+
+typedef struct A2pPrefetch A2pPrefetch;
+
+A2pPrefetch *
+a2p_prefetch_create(AVS_ScriptEnvironment *env, AVS_Clip *clip,
+                    const A2pVideoFormat *format, int threads, int depth,
+                    int start, int end);
+
+// blocks until the next frame in order is packed, returns its buffer
+BYTE *
+a2p_prefetch_next(A2pPrefetch *prefetch);
+
+// returns the buffer from a2p_prefetch_next to the workers
+void
+a2p_prefetch_release(A2pPrefetch *prefetch);
+
+void
+a2p_prefetch_destroy(A2pPrefetch *prefetch);
+
+#endif // PREFETCH_H
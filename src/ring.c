@@ -0,0 +1,268 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "common.h"
+#include "ring.h"
+
+#define A2P_RING_NAME_MAX   MAX_PATH
+
+struct A2pRing {
+    HANDLE              mapping;
+    HANDLE              ready;
+    HANDLE              empty;
+    A2pRingHeader      *header;
+    BYTE               *slots;
+    int32_t             next;       // frame acquired or taken
+    int                 writer;
+    HANDLE              reader;     // writer side, process of the reader
+    DWORD               reader_pid;
+};
+
+static void
+a2p_ring_names(const char *name, char *mapping, char *ready, char *empty)
+{
+    _snprintf(mapping, A2P_RING_NAME_MAX, "Local\\avs2pipe.%s", name);
+    mapping[A2P_RING_NAME_MAX - 1] = 0;
+    _snprintf(ready, A2P_RING_NAME_MAX, "%s.ready", mapping);
+    ready[A2P_RING_NAME_MAX - 1] = 0;
+    _snprintf(empty, A2P_RING_NAME_MAX, "%s.free", mapping);
+    empty[A2P_RING_NAME_MAX - 1] = 0;
+}
+
+static BYTE *
+a2p_ring_slot(A2pRing *ring)
+{
+    return ring->slots + (size_t) ring->header->slot_size *
+                         (ring->next % ring->header->slots);
+}
+
+// 1 once the reader has closed the ring, or its process has ended
+// without doing so
+static int
+a2p_ring_reader_gone(A2pRing *ring)
+{
+    DWORD pid;
+    
+    if(ring->header->reader_done) return 1;
+    pid = ring->header->reader_pid;
+    if(pid == 0) return 0;
+    if(pid != ring->reader_pid) {
+        if(ring->reader != NULL) CloseHandle(ring->reader);
+        ring->reader = OpenProcess(SYNCHRONIZE, FALSE, pid);
+        ring->reader_pid = pid;
+        if(ring->reader == NULL) return 1;
+    }
+    
+    return ring->reader == NULL ||
+           WaitForSingleObject(ring->reader, 0) == WAIT_OBJECT_0;
+}
+
+A2pRing *
+a2p_ring_create(const char *name, const A2pRingHeader *header)
+{
+    A2pRing *ring;
+    char mapping[A2P_RING_NAME_MAX];
+    char ready[A2P_RING_NAME_MAX];
+    char empty[A2P_RING_NAME_MAX];
+    uint64_t size;
+    
+    ring = calloc(1, sizeof(*ring));
+    if(ring == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate ring state.\n");
+    }
+    ring->writer = 1;
+    a2p_ring_names(name, mapping, ready, empty);
+    
+    size = A2P_RING_ALIGN + (uint64_t) header->slot_size * header->slots;
+    ring->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL,
+                                       PAGE_READWRITE, (DWORD) (size >> 32),
+                                       (DWORD) size, mapping);
+    if(ring->mapping == NULL) {
+        a2p_log(A2P_LOG_ERROR, "cannot create ring %s.\n", mapping);
+    }
+    if(GetLastError() == ERROR_ALREADY_EXISTS) {
+        a2p_log(A2P_LOG_ERROR, "ring %s is already in use.\n", mapping);
+    }
+    ring->header = MapViewOfFile(ring->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if(ring->header == NULL) {
+        a2p_log(A2P_LOG_ERROR, "cannot map ring %s.\n", mapping);
+    }
+    ring->slots = (BYTE *) ring->header + A2P_RING_ALIGN;
+    
+    // the header is complete before the semaphores exist, a reader
+    // that finds them can trust it
+    memcpy(ring->header, header, sizeof(*header));
+    ring->header->magic = A2P_RING_MAGIC;
+    ring->header->version = A2P_RING_VERSION;
+    ring->header->header_size = sizeof(*header);
+    ring->header->written = 0;
+    ring->header->read = 0;
+    ring->header->writer_done = 0;
+    ring->header->reader_done = 0;
+    ring->header->reader_pid = 0;
+    
+    ring->ready = CreateSemaphoreA(NULL, 0, header->slots + 1, ready);
+    ring->empty = CreateSemaphoreA(NULL, header->slots, header->slots + 1,
+                                  empty);
+    if(ring->ready == NULL || ring->empty == NULL) {
+        a2p_log(A2P_LOG_ERROR, "cannot create semaphores for ring %s.\n",
+                mapping);
+    }
+    a2p_log(A2P_LOG_INFO, "ring %s has %u slots of %u bytes.\n", mapping,
+            header->slots, header->slot_size);
+    
+    return ring;
+}
+
+void *
+a2p_ring_acquire(A2pRing *ring)
+{
+    // the timeout notices a reader that left, or was killed, while the
+    // ring was full
+    while(WaitForSingleObject(ring->empty, 1000) == WAIT_TIMEOUT) {
+        if(a2p_ring_reader_gone(ring)) {
+            return NULL;
+        }
+    }
+    if(a2p_ring_reader_gone(ring)) {
+        return NULL;
+    }
+    
+    return a2p_ring_slot(ring);
+}
+
+void
+a2p_ring_commit(A2pRing *ring)
+{
+    ring->next++;
+    InterlockedExchange((volatile LONG *) &ring->header->written, ring->next);
+    ReleaseSemaphore(ring->ready, 1, NULL);
+}
+
+A2pRing *
+a2p_ring_open(const char *name, unsigned timeout)
+{
+    A2pRing *ring;
+    char mapping[A2P_RING_NAME_MAX];
+    char ready[A2P_RING_NAME_MAX];
+    char empty[A2P_RING_NAME_MAX];
+    unsigned waited;
+    
+    ring = calloc(1, sizeof(*ring));
+    if(ring == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate ring state.\n");
+    }
+    a2p_ring_names(name, mapping, ready, empty);
+    
+    // the free semaphore is created last, once it opens the rest is there
+    for(waited = 0;; waited += 100) {
+        ring->empty = OpenSemaphoreA(SEMAPHORE_ALL_ACCESS, FALSE, empty);
+        if(ring->empty != NULL) {
+            break;
+        }
+        if(waited >= timeout) {
+            a2p_log(A2P_LOG_ERROR, "no ring %s to read from.\n", mapping);
+        }
+        Sleep(100);
+    }
+    ring->ready = OpenSemaphoreA(SEMAPHORE_ALL_ACCESS, FALSE, ready);
+    ring->mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mapping);
+    if(ring->ready == NULL || ring->mapping == NULL) {
+        a2p_log(A2P_LOG_ERROR, "cannot open ring %s.\n", mapping);
+    }
+    ring->header = MapViewOfFile(ring->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if(ring->header == NULL) {
+        a2p_log(A2P_LOG_ERROR, "cannot map ring %s.\n", mapping);
+    }
+    if(ring->header->magic != A2P_RING_MAGIC ||
+       ring->header->version != A2P_RING_VERSION) {
+        a2p_log(A2P_LOG_ERROR, "%s is not an avs2pipe ring.\n", mapping);
+    }
+    ring->slots = (BYTE *) ring->header + A2P_RING_ALIGN;
+    ring->next = ring->header->read;
+    InterlockedExchange((volatile LONG *) &ring->header->reader_pid,
+                        (LONG) GetCurrentProcessId());
+    
+    return ring;
+}
+
+const A2pRingHeader *
+a2p_ring_header(const A2pRing *ring)
+{
+    return ring->header;
+}
+
+const void *
+a2p_ring_next(A2pRing *ring)
+{
+    WaitForSingleObject(ring->ready, INFINITE);
+    // the writer releases ready once more when it is done, so the wait
+    // always returns, with either a frame or the end
+    if(ring->next >= ring->header->written) {
+        return NULL;
+    }
+    
+    return a2p_ring_slot(ring);
+}
+
+void
+a2p_ring_release(A2pRing *ring)
+{
+    ring->next++;
+    InterlockedExchange((volatile LONG *) &ring->header->read, ring->next);
+    ReleaseSemaphore(ring->empty, 1, NULL);
+}
+
+void
+a2p_ring_close(A2pRing *ring)
+{
+    unsigned waited;
+    
+    if(ring->writer) {
+        InterlockedExchange((volatile LONG *) &ring->header->writer_done, 1);
+        ReleaseSemaphore(ring->ready, 1, NULL);
+        // the mapping lives only as long as a handle to it, so the
+        // reader is given the chance to drain it before it goes
+        for(waited = 0; !a2p_ring_reader_gone(ring) &&
+                        ring->header->read < ring->header->written;
+            waited += 10) {
+            if(ring->header->reader_pid == 0 &&
+               waited >= A2P_RING_ATTACH_WAIT) {
+                a2p_log(A2P_LOG_WARNING, "no reader opened the ring, "
+                        "dropping the frames left in it.\n");
+                break;
+            }
+            Sleep(10);
+        }
+        if(ring->reader != NULL) CloseHandle(ring->reader);
+    } else {
+        InterlockedExchange((volatile LONG *) &ring->header->reader_done, 1);
+        ReleaseSemaphore(ring->empty, 1, NULL);
+    }
+    UnmapViewOfFile(ring->header);
+    CloseHandle(ring->mapping);
+    CloseHandle(ring->ready);
+    CloseHandle(ring->empty);
+    free(ring);
+}
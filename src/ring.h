@@ -0,0 +1,111 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Shared memory frame ring for encoders on the same machine. avs2pipe
+// packs frames straight into the slots of a named mapping and a reader
+// takes them from there, without the two copies of a pipe. The mapping
+// starts with an A2pRingHeader describing the video, followed by the
+// slots, each aligned to A2P_RING_ALIGN bytes.
+//
+// For a ring called NAME the mapping is Local\avs2pipe.NAME, the
+// semaphore Local\avs2pipe.NAME.ready counts slots filled and
+// Local\avs2pipe.NAME.free counts slots the reader has given back.
+// Frame n is in slot n % slots. The written and read counters mirror
+// the semaphores for readers that would rather poll. A reader stores its
+// process id in reader_pid, so the writer stops when it is killed
+// without setting reader_done.
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+
+#define A2P_RING_MAGIC      0x47523241  // "A2RG"
+#define A2P_RING_VERSION    2
+#define A2P_RING_ALIGN      4096
+#define A2P_RING_PLANES     3
+#define A2P_RING_ATTACH_WAIT 30000
+
+typedef struct A2pRingHeader A2pRingHeader;
+typedef struct A2pRing A2pRing;
+
+struct A2pRingHeader {
+    uint32_t            magic;
+    uint32_t            version;
+    uint32_t            header_size;    // sizeof(A2pRingHeader), slot 0 follows
+    uint32_t            slots;
+    uint32_t            slot_size;      // bytes between slots
+    uint32_t            frame_size;     // bytes used in each slot
+    int32_t             frames;         // frames that will be written
+    int32_t             width;
+    int32_t             height;
+    uint32_t            fps_numerator;
+    uint32_t            fps_denominator;
+    int32_t             sample_size;    // bytes per sample
+    int32_t             depth;          // bits per sample
+    int32_t             planes_num;
+    uint32_t            plane_offset[A2P_RING_PLANES]; // into the slot
+    int32_t             plane_pitch[A2P_RING_PLANES];  // bytes per row
+    int32_t             plane_height[A2P_RING_PLANES];
+    char                stream[128];    // y4m stream header, empty for raw
+                                        // frames, each slot starts with
+                                        // FRAME\n when it is set
+    volatile int32_t    written;        // frames published
+    volatile int32_t    read;           // frames released by the reader
+    volatile int32_t    writer_done;    // no more frames will be written
+    volatile int32_t    reader_done;    // the reader has gone
+    volatile uint32_t   reader_pid;     // process of the reader, 0 for none
+};
+
+// creates ring name with the layout of header, its counters are reset
+A2pRing *
+a2p_ring_create(const char *name, const A2pRingHeader *header);
+
+// blocks for a free slot, NULL once the reader has gone
+void *
+a2p_ring_acquire(A2pRing *ring);
+
+// publishes the acquired slot as the next frame
+void
+a2p_ring_commit(A2pRing *ring);
+
+// opens a ring created by another process, waiting up to timeout ms for
+// it to appear
+A2pRing *
+a2p_ring_open(const char *name, unsigned timeout);
+
+const A2pRingHeader *
+a2p_ring_header(const A2pRing *ring);
+
+// blocks for the next frame, NULL at the end of the stream
+const void *
+a2p_ring_next(A2pRing *ring);
+
+// gives the slot from a2p_ring_next back to the writer
+void
+a2p_ring_release(A2pRing *ring);
+
+// ends the stream for the other side and unmaps the ring, the writer
+// first waits for the reader to take the frames left, unless it has gone
+// or none attaches within A2P_RING_ATTACH_WAIT ms
+void
+a2p_ring_close(A2pRing *ring);
+
+#endif // RING_H
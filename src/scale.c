@@ -0,0 +1,257 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "common.h"
+#include "cpu.h"
+#include "scale.h"
+
+#define A2P_PI 3.14159265358979323846
+
+// filter taps along one axis
+typedef struct A2pScaleAxis A2pScaleAxis;
+
+struct A2pScaleAxis {
+    int         taps;               // per output sample, padded with zeros
+    int        *start;              // first source sample of each output
+    int16_t    *coef;               // taps per output, sum to 1 << 14
+};
+
+struct A2pScale {
+    int             src_width;
+    int             src_height;
+    int             dst_width;
+    int             dst_height;
+    int             margin;         // edge samples repeated around src rows
+    A2pScaleAxis    h;
+    A2pScaleAxis    v;
+};
+
+static A2pScaleVFunc a2p_scale_v;
+static A2pScaleHFunc a2p_scale_h;
+
+static void
+a2p_scale_select(void)
+{
+    int flags;
+    
+    flags = a2p_cpu_flags();
+    a2p_scale_v = flags & A2P_CPU_SSE2 ? a2p_scale_v_sse2 : a2p_scale_v_c;
+    a2p_scale_h = flags & A2P_CPU_SSE2 ? a2p_scale_h_sse2 : a2p_scale_h_c;
+}
+
+static double
+a2p_sinc(double x)
+{
+    return x == 0 ? 1 : sin(A2P_PI * x) / (A2P_PI * x);
+}
+
+static double
+a2p_scale_weight(A2pScaleKernel kernel, double x)
+{
+    x = fabs(x);
+    switch(kernel) {
+        case A2P_SCALE_BILINEAR:
+            return x < 1 ? 1 - x : 0;
+        case A2P_SCALE_LANCZOS:
+            return x < 3 ? a2p_sinc(x) * a2p_sinc(x / 3) : 0;
+        case A2P_SCALE_BICUBIC:
+        default:
+            if(x < 1) return (1.5 * x - 2.5) * x * x + 1;
+            if(x < 2) return ((-0.5 * x + 2.5) * x - 4) * x + 2;
+            return 0;
+    }
+}
+
+static double
+a2p_scale_radius(A2pScaleKernel kernel)
+{
+    switch(kernel) {
+        case A2P_SCALE_BILINEAR:
+            return 1;
+        case A2P_SCALE_LANCZOS:
+            return 3;
+        case A2P_SCALE_BICUBIC:
+        default:
+            return 2;
+    }
+}
+
+// taps are rounded up to a multiple of align, downscaling stretches the
+// kernel over the source so every source sample is weighted
+static void
+a2p_scale_axis(A2pScaleAxis *axis, int src, int dst, A2pScaleKernel kernel,
+               int align)
+{
+    double ratio, support, center, weight[256], sum;
+    int i, t, taps, first, total, best;
+    
+    ratio = (double) src / dst;
+    support = a2p_scale_radius(kernel) * (ratio > 1 ? ratio : 1);
+    taps = (int) ceil(support) * 2 + 1;
+    taps = (taps + align - 1) / align * align;
+    if(taps > 256) {
+        a2p_log(A2P_LOG_ERROR, "cannot scale %d to %d.\n", src, dst);
+    }
+    
+    axis->taps = taps;
+    axis->start = malloc(dst * sizeof(*axis->start));
+    axis->coef = malloc(dst * taps * sizeof(*axis->coef));
+    if(axis->start == NULL || axis->coef == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate scaler state.\n");
+    }
+    
+    for(i = 0; i < dst; i++) {
+        // sample centres line up, as in most scalers
+        center = (i + 0.5) * ratio - 0.5;
+        first = (int) floor(center - support) + 1;
+        sum = 0;
+        for(t = 0; t < taps; t++) {
+            weight[t] = a2p_scale_weight(kernel, (first + t - center) /
+                                         (ratio > 1 ? ratio : 1));
+            sum += weight[t];
+        }
+        // normalise in fixed point, rounding error goes to the largest tap
+        total = 0;
+        best = 0;
+        for(t = 0; t < taps; t++) {
+            axis->coef[i * taps + t] = (int16_t) floor(weight[t] / sum *
+                                                       16384 + 0.5);
+            total += axis->coef[i * taps + t];
+            if(weight[t] > weight[best]) best = t;
+        }
+        axis->coef[i * taps + best] += 16384 - total;
+        axis->start[i] = first;
+    }
+}
+
+A2pScale *
+a2p_scale_create(int src_width, int src_height, int dst_width,
+                 int dst_height, A2pScaleKernel kernel)
+{
+    A2pScale *sc;
+    int i;
+    
+    a2p_scale_select();
+    
+    sc = malloc(sizeof(*sc));
+    if(sc == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate scaler state.\n");
+    }
+    sc->src_width = src_width;
+    sc->src_height = src_height;
+    sc->dst_width = dst_width;
+    sc->dst_height = dst_height;
+    a2p_scale_axis(&sc->h, src_width, dst_width, kernel, 8);
+    a2p_scale_axis(&sc->v, src_height, dst_height, kernel, 2);
+    
+    // horizontal taps read the margin instead of clamping each index
+    sc->margin = sc->h.taps;
+    for(i = 0; i < dst_width; i++) {
+        if(sc->h.start[i] < -sc->margin) {
+            sc->h.start[i] = -sc->margin;
+        }
+        if(sc->h.start[i] + sc->h.taps > src_width + sc->margin) {
+            sc->h.start[i] = src_width + sc->margin - sc->h.taps;
+        }
+    }
+    
+    return sc;
+}
+
+size_t
+a2p_scale_scratch_size(const A2pScale *sc)
+{
+    return (sc->src_width + 2 * sc->margin) * sizeof(int16_t) +
+           sc->v.taps * sizeof(uint8_t *);
+}
+
+void
+a2p_scale_rows(const A2pScale *sc, uint8_t *dst, int dst_pitch,
+               const uint8_t *src, int src_pitch, int y0, int y1,
+               void *scratch)
+{
+    const uint8_t **rows;
+    int16_t *line;
+    int y, t, r;
+    
+    rows = scratch;
+    line = (int16_t *) (rows + sc->v.taps);
+    
+    for(y = y0; y < y1; y++) {
+        for(t = 0; t < sc->v.taps; t++) {
+            r = sc->v.start[y] + t;
+            r = r < 0 ? 0 : r >= sc->src_height ? sc->src_height - 1 : r;
+            rows[t] = src + r * src_pitch;
+        }
+        a2p_scale_v(line + sc->margin, rows, sc->v.coef + y * sc->v.taps,
+                    sc->v.taps, sc->src_width);
+        for(t = 0; t < sc->margin; t++) {
+            line[t] = line[sc->margin];
+            line[sc->margin + sc->src_width + t] =
+                line[sc->margin + sc->src_width - 1];
+        }
+        a2p_scale_h(dst + y * dst_pitch, line + sc->margin, sc->h.start,
+                    sc->h.coef, sc->h.taps, sc->dst_width);
+    }
+}
+
+void
+a2p_scale_destroy(A2pScale *sc)
+{
+    free(sc->h.start);
+    free(sc->h.coef);
+    free(sc->v.start);
+    free(sc->v.coef);
+    free(sc);
+}
+
+void
+a2p_scale_v_c(int16_t *dst, const uint8_t *const *rows, const int16_t *coef,
+              int taps, int width)
+{
+    int x, t, sum;
+    
+    for(x = 0; x < width; x++) {
+        sum = 128;
+        for(t = 0; t < taps; t++) {
+            sum += coef[t] * rows[t][x];
+        }
+        dst[x] = (int16_t) (sum >> 8);
+    }
+}
+
+void
+a2p_scale_h_c(uint8_t *dst, const int16_t *src, const int *start,
+              const int16_t *coef, int taps, int width)
+{
+    int x, t, sum;
+    
+    for(x = 0; x < width; x++) {
+        sum = 1 << 19;
+        for(t = 0; t < taps; t++) {
+            sum += coef[x * taps + t] * src[start[x] + t];
+        }
+        sum >>= 20;
+        dst[x] = (uint8_t) (sum < 0 ? 0 : sum > 255 ? 255 : sum);
+    }
+}
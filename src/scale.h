@@ -0,0 +1,81 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Separable 8 bit plane scaler used for the ladder outputs. Each output
+// row is filtered vertically into a 16 bit row with 6 fraction bits, then
+// horizontally, both with 14 bit fixed point polyphase coefficients.
+
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <stdint.h>
+
+typedef enum A2pScaleKernel A2pScaleKernel;
+typedef struct A2pScale A2pScale;
+
+enum A2pScaleKernel {
+    A2P_SCALE_BILINEAR,
+    A2P_SCALE_BICUBIC,              // catmull-rom
+    A2P_SCALE_LANCZOS               // 3 lobes
+};
+
+A2pScale *
+a2p_scale_create(int src_width, int src_height, int dst_width,
+                 int dst_height, A2pScaleKernel kernel);
+
+// bytes of scratch a2p_scale_rows needs
+size_t
+a2p_scale_scratch_size(const A2pScale *scale);
+
+// scales output rows [y0, y1), threads can each run a share of the rows
+// with their own scratch
+void
+a2p_scale_rows(const A2pScale *scale, uint8_t *dst, int dst_pitch,
+               const uint8_t *src, int src_pitch, int y0, int y1,
+               void *scratch);
+
+void
+a2p_scale_destroy(A2pScale *scale);
+
+typedef void (*A2pScaleVFunc)(int16_t *dst, const uint8_t *const *rows,
+                              const int16_t *coef, int taps, int width);
+typedef void (*A2pScaleHFunc)(uint8_t *dst, const int16_t *src,
+                              const int *start, const int16_t *coef,
+                              int taps, int width);
+
+// kernels, only call the simd ones when a2p_cpu_flags reports support,
+// vertical taps are even and horizontal taps a multiple of 8
+void
+a2p_scale_v_c(int16_t *dst, const uint8_t *const *rows, const int16_t *coef,
+              int taps, int width);
+
+void
+a2p_scale_v_sse2(int16_t *dst, const uint8_t *const *rows,
+                 const int16_t *coef, int taps, int width);
+
+void
+a2p_scale_h_c(uint8_t *dst, const int16_t *src, const int *start,
+              const int16_t *coef, int taps, int width);
+
+void
+a2p_scale_h_sse2(uint8_t *dst, const int16_t *src, const int *start,
+                 const int16_t *coef, int taps, int width);
+
+#endif // SCALE_H
@@ -0,0 +1,82 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// built with -msse2 by gcc, only called when the cpu reports sse2
+
+#include <emmintrin.h>
+#include "scale.h"
+
+void
+a2p_scale_v_sse2(int16_t *dst, const uint8_t *const *rows,
+                 const int16_t *coef, int taps, int width)
+{
+    __m128i zero, round, c, a, b, lo, hi;
+    int x, t, sum;
+    
+    zero = _mm_setzero_si128();
+    round = _mm_set1_epi32(128);
+    // 8 pixels per loop, rows are taken in pairs so madd adds two taps
+    for(x = 0; x + 8 <= width; x += 8) {
+        lo = round;
+        hi = round;
+        for(t = 0; t < taps; t += 2) {
+            c = _mm_set1_epi32((uint16_t) coef[t] |
+                               ((uint32_t) (uint16_t) coef[t + 1] << 16));
+            a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)
+                                                  (rows[t] + x)), zero);
+            b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)
+                                                  (rows[t + 1] + x)), zero);
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), c));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), c));
+        }
+        _mm_storeu_si128((__m128i *) (dst + x),
+                         _mm_packs_epi32(_mm_srai_epi32(lo, 8),
+                                         _mm_srai_epi32(hi, 8)));
+    }
+    for(; x < width; x++) {
+        sum = 128;
+        for(t = 0; t < taps; t++) {
+            sum += coef[t] * rows[t][x];
+        }
+        dst[x] = (int16_t) (sum >> 8);
+    }
+}
+
+void
+a2p_scale_h_sse2(uint8_t *dst, const int16_t *src, const int *start,
+                 const int16_t *coef, int taps, int width)
+{
+    __m128i acc;
+    int x, t, sum;
+    
+    // taps are a multiple of 8, madd adds pairs and the rest are folded
+    for(x = 0; x < width; x++) {
+        acc = _mm_setzero_si128();
+        for(t = 0; t < taps; t += 8) {
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(
+                _mm_loadu_si128((const __m128i *) (src + start[x] + t)),
+                _mm_loadu_si128((const __m128i *) (coef + x * taps + t))));
+        }
+        acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 8));
+        acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 4));
+        sum = (_mm_cvtsi128_si32(acc) + (1 << 19)) >> 20;
+        dst[x] = (uint8_t) (sum < 0 ? 0 : sum > 255 ? 255 : sum);
+    }
+}
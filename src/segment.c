@@ -0,0 +1,399 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include <process.h>
+#include "common.h"
+#include "segment.h"
+
+// ranges shorter than twice this are not split, a thief has to seek and
+// warm up the filter chain before its first frame
+#define A2P_SEGMENT_STEAL_MIN 8
+
+typedef struct A2pSegmentWorker A2pSegmentWorker;
+
+struct A2pSegmentWorker {
+    A2pSegments            *seg;
+    int                     next;         // next frame of the range
+    int                     end;          // one past the range, thieves lower it
+    int                     waiting;      // frame held back by the window or -1
+    int                     written;      // frames written to segment files
+    HANDLE                  wake;         // set when the window reaches waiting
+    HANDLE                  thread;
+};
+
+struct A2pSegments {
+    const char             *script;
+    A2pVideoOptions         options;
+    const A2pVideoFormat   *format;
+    const char             *pattern;      // segment files or NULL
+    A2pMapFile             *map;          // mapped output or NULL
+    const char             *header;
+    size_t                  header_size;
+    
+    int                     envs;
+    int                     chunk;        // frames per range handed out
+    int                     start;        // first frame
+    int                     queued;       // first frame not handed out yet
+    int                     end;          // one past the last frame
+    int                     depth;        // slots in the reorder buffer
+    int                     consumed;     // next frame handed out in order
+    volatile LONG           stop;
+    int                     failed;       // a segment file could not be written
+    
+    A2pSegmentWorker       *workers;
+    BYTE                  **slots;        // frame n is packed in n % depth
+    HANDLE                 *ready;        // per slot, released when packed
+    CRITICAL_SECTION        lock;         // ranges, window and worker state
+    CRITICAL_SECTION        load;         // scripts are loaded one at a time
+};
+
+// gives w a new range, the next chunk or the back half of the largest
+// range left, called with the lock held
+static int
+a2p_segments_claim(A2pSegments *seg, A2pSegmentWorker *w)
+{
+    A2pSegmentWorker *victim;
+    int i, left, most;
+    
+    if(seg->stop) return 0;
+    if(seg->queued < seg->end) {
+        w->next = seg->queued;
+        w->end = seg->end - seg->queued > seg->chunk ?
+                 seg->queued + seg->chunk : seg->end;
+        seg->queued = w->end;
+        return 1;
+    }
+    
+    victim = NULL;
+    most = 0;
+    for(i = 0; i < seg->envs; i++) {
+        left = seg->workers[i].end - seg->workers[i].next;
+        if(left > most) {
+            victim = &seg->workers[i];
+            most = left;
+        }
+    }
+    if(victim == NULL || most < 2 * A2P_SEGMENT_STEAL_MIN) return 0;
+    
+    w->end = victim->end;
+    w->next = victim->end - most / 2;
+    victim->end = w->next;
+    
+    return 1;
+}
+
+static unsigned __stdcall
+a2p_segments_worker(void *data)
+{
+    A2pSegmentWorker *w = data;
+    A2pSegments *seg = w->seg;
+    AVS_ScriptEnvironment *env;
+    AVS_Clip *clip;
+    AVS_VideoFrame *frame;
+    A2pVideoFormat format;
+    FILE *file;
+    BYTE *buff, *view;
+    uint64_t offset;
+    char path[MAX_PATH];
+    int n, range, wait;
+    
+    // plugins are not all safe to load from several threads at once
+    EnterCriticalSection(&seg->load);
+    env = avs_create_script_environment(AVISYNTH_INTERFACE_VERSION);
+    clip = a2p_avs_source(env, (char *) seg->script);
+    clip = a2p_video_setup(env, clip, &seg->options, &format);
+    LeaveCriticalSection(&seg->load);
+    if(format.size != seg->format->size) {
+        a2p_log(A2P_LOG_ERROR, "script environment %d packs %d byte "
+                "frames instead of %d.\n", (int) (w - seg->workers),
+                format.size, seg->format->size);
+    }
+    
+    buff = seg->pattern != NULL ? a2p_video_alloc(&format) : NULL;
+    file = NULL;
+    for(;;) {
+        EnterCriticalSection(&seg->lock);
+        range = w->next >= w->end;
+        if(range && !a2p_segments_claim(seg, w)) {
+            LeaveCriticalSection(&seg->lock);
+            break;
+        }
+        n = w->next++;
+        // frame n goes in slot n % depth, so it waits for n - depth to
+        // leave, the earliest frame not consumed never waits
+        wait = seg->depth > 0 && n >= seg->consumed + seg->depth;
+        if(wait) w->waiting = n;
+        LeaveCriticalSection(&seg->lock);
+        
+        if(wait) WaitForSingleObject(w->wake, INFINITE);
+        if(seg->stop) break;
+        
+        if(range && seg->pattern != NULL) {
+            if(file != NULL && fclose(file) != 0) seg->failed = 1;
+            sprintf(path, seg->pattern, n);
+            file = fopen(path, "wb");
+            if(file == NULL) {
+                a2p_log(A2P_LOG_ERROR, "cannot open %s for writing.\n", path);
+            }
+            fputs(seg->header, file);
+        }
+        
+        frame = avs_get_frame(clip, n);
+        if(seg->map != NULL) {
+            offset = seg->header_size + (uint64_t) (n - seg->start) *
+                     format.size;
+            view = a2p_map_view(seg->map, offset, format.size);
+            a2p_video_pack(env, &format, frame, view);
+            avs_release_frame(frame);
+            a2p_map_unview(seg->map, view, offset);
+            w->written++;
+        } else if(seg->pattern == NULL) {
+            a2p_video_pack(env, &format, frame, seg->slots[n % seg->depth]);
+            avs_release_frame(frame);
+            ReleaseSemaphore(seg->ready[n % seg->depth], 1, NULL);
+        } else {
+            a2p_video_pack(env, &format, frame, buff);
+            avs_release_frame(frame);
+            if(fwrite(buff, sizeof(BYTE), format.size, file) != format.size) {
+                // fail early, the other environments stop too
+                seg->failed = 1;
+                InterlockedExchange(&seg->stop, 1);
+                break;
+            }
+            w->written++;
+        }
+    }
+    if(file != NULL && fclose(file) != 0) seg->failed = 1;
+    
+    free(buff);
+    a2p_video_close(&format);
+    avs_release_clip(clip);
+    avs_delete_script_environment(env);
+    
+    return 0;
+}
+
+A2pSegments *
+a2p_segments_create(const char *script, const A2pVideoOptions *options,
+                    const A2pVideoFormat *format, int envs, int chunk,
+                    int depth, int start, int end, const char *pattern,
+                    A2pMapFile *map, const char *header)
+{
+    A2pSegments *seg;
+    void *view;
+    int i;
+    
+    if(envs > end - start) envs = end - start;
+    if(chunk < 1) chunk = (end - start + envs - 1) / envs; // split evenly
+    if(depth < envs) depth = envs; // every environment needs a slot
+    
+    seg = malloc(sizeof(*seg));
+    if(seg == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate segment state.\n");
+    }
+    seg->script = script;
+    seg->options = *options;
+    seg->options.convert_threads = 1; // the environments fill the cpus
+    seg->format = format;
+    seg->pattern = pattern;
+    seg->map = map;
+    seg->header = header;
+    seg->header_size = header != NULL ? strlen(header) : 0;
+    seg->envs = envs;
+    seg->chunk = chunk;
+    seg->start = start;
+    seg->queued = start;
+    seg->end = end;
+    seg->depth = pattern == NULL && map == NULL ? depth : 0;
+    seg->consumed = start;
+    seg->stop = 0;
+    seg->failed = 0;
+    
+    seg->workers = malloc(envs * sizeof(*seg->workers));
+    seg->slots = malloc(seg->depth * sizeof(*seg->slots));
+    seg->ready = malloc(seg->depth * sizeof(*seg->ready));
+    if(seg->workers == NULL || (seg->depth > 0 &&
+       (seg->slots == NULL || seg->ready == NULL))) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate segment state.\n");
+    }
+    
+    InitializeCriticalSection(&seg->lock);
+    InitializeCriticalSection(&seg->load);
+    for(i = 0; i < seg->depth; i++) {
+        seg->slots[i] = a2p_video_alloc(format);
+        seg->ready[i] = CreateSemaphore(NULL, 0, 1, NULL);
+        if(seg->ready[i] == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not create segment semaphore.\n");
+        }
+    }
+    
+    if(map != NULL && seg->header_size > 0) {
+        view = a2p_map_view(map, 0, seg->header_size);
+        memcpy(view, header, seg->header_size);
+        a2p_map_unview(map, view, 0);
+    }
+    
+    if(pattern != NULL) {
+        a2p_log(A2P_LOG_INFO, "rendering frames %d to %d into %s files with "
+                "%d script environments.\n", start, end - 1, pattern, envs);
+    } else if(map != NULL) {
+        a2p_log(A2P_LOG_INFO, "rendering frames %d to %d into the mapped "
+                "file with %d script environments.\n", start, end - 1, envs);
+    } else {
+        a2p_log(A2P_LOG_INFO, "rendering frames %d to %d with %d script "
+                "environments, %d frame chunks, %d frames ahead.\n", start,
+                end - 1, envs, chunk, seg->depth);
+    }
+    
+    for(i = 0; i < envs; i++) {
+        seg->workers[i].seg = seg;
+        seg->workers[i].next = 0;
+        seg->workers[i].end = 0;
+        seg->workers[i].waiting = -1;
+        seg->workers[i].written = 0;
+        seg->workers[i].wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if(seg->workers[i].wake == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not create segment event.\n");
+        }
+    }
+    for(i = 0; i < envs; i++) {
+        seg->workers[i].thread = (HANDLE) _beginthreadex(NULL, 0,
+                                 a2p_segments_worker, &seg->workers[i], 0, NULL);
+        if(seg->workers[i].thread == 0) {
+            a2p_log(A2P_LOG_ERROR, "could not start segment thread.\n");
+        }
+    }
+    
+    return seg;
+}
+
+BYTE *
+a2p_segments_next(A2pSegments *seg)
+{
+    WaitForSingleObject(seg->ready[seg->consumed % seg->depth], INFINITE);
+    return seg->slots[seg->consumed % seg->depth];
+}
+
+void
+a2p_segments_release(A2pSegments *seg)
+{
+    A2pSegmentWorker *w;
+    int i;
+    
+    EnterCriticalSection(&seg->lock);
+    seg->consumed++;
+    for(i = 0; i < seg->envs; i++) {
+        w = &seg->workers[i];
+        if(w->waiting >= 0 && w->waiting < seg->consumed + seg->depth) {
+            w->waiting = -1;
+            SetEvent(w->wake);
+        }
+    }
+    LeaveCriticalSection(&seg->lock);
+}
+
+static void
+a2p_segments_join(A2pSegments *seg)
+{
+    int i;
+    
+    for(i = 0; i < seg->envs; i++) {
+        if(seg->workers[i].thread == NULL) continue;
+        WaitForSingleObject(seg->workers[i].thread, INFINITE);
+        CloseHandle(seg->workers[i].thread);
+        seg->workers[i].thread = NULL;
+    }
+}
+
+int
+a2p_segments_wait(A2pSegments *seg)
+{
+    int i, wrote;
+    
+    a2p_segments_join(seg);
+    
+    wrote = 0;
+    for(i = 0; i < seg->envs; i++) {
+        wrote += seg->workers[i].written;
+    }
+    if(seg->failed) {
+        a2p_log(A2P_LOG_WARNING, "a segment file could not be written.\n");
+    }
+    
+    return wrote;
+}
+
+int
+a2p_segments_pattern(const char *pattern)
+{
+    const char *p;
+    int conversions;
+    
+    conversions = 0;
+    for(p = pattern; *p != '\0'; p++) {
+        if(*p != '%') continue;
+        p++;
+        if(*p == '%') continue;
+        while(*p >= '0' && *p <= '9') p++;
+        if(*p != 'd') return 0;
+        conversions++;
+    }
+    
+    // room for the frame number
+    return conversions == 1 && strlen(pattern) + 16 < MAX_PATH;
+}
+
+void
+a2p_segments_destroy(A2pSegments *seg)
+{
+    int i;
+    
+    // stop claiming frames and wake any worker waiting on the window
+    EnterCriticalSection(&seg->lock);
+    InterlockedExchange(&seg->stop, 1);
+    for(i = 0; i < seg->envs; i++) {
+        if(seg->workers[i].waiting >= 0) {
+            seg->workers[i].waiting = -1;
+            SetEvent(seg->workers[i].wake);
+        }
+    }
+    LeaveCriticalSection(&seg->lock);
+    
+    a2p_segments_join(seg);
+    
+    for(i = 0; i < seg->envs; i++) {
+        CloseHandle(seg->workers[i].wake);
+    }
+    for(i = 0; i < seg->depth; i++) {
+        CloseHandle(seg->ready[i]);
+        free(seg->slots[i]);
+    }
+    DeleteCriticalSection(&seg->load);
+    DeleteCriticalSection(&seg->lock);
+    
+    free(seg->ready);
+    free(seg->slots);
+    free(seg->workers);
+    free(seg);
+}
@@ -0,0 +1,73 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Segmented render, the timeline is split over several script
+// environments that each load the script and render whole chunks of
+// frames on their own thread, so single threaded filter chains scale to
+// many cores. Chunks are handed out in frame order and once they run out
+// idle environments steal the back half of the largest range left.
+//
+// The frames are handed out in order through a reorder window like
+// A2pPrefetch, each range is written to its own y4m file, or every frame
+// is packed straight into its place in a mapped file.
+
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include "video.h"
+#include "mapfile.h"
+
+// frames per range handed out when the frames are written in order
+#define A2P_SEGMENT_CHUNK 16
+
+typedef struct A2pSegments A2pSegments;
+
+// renders frames [start, end) of script in envs environments, pattern
+// names the segment files after the first frame of each range, eg.
+// part%06d.y4m, each starting with header, map gets header followed by
+// every frame in its place, with both NULL the frames are handed out in
+// order through a window of depth frames
+A2pSegments *
+a2p_segments_create(const char *script, const A2pVideoOptions *options,
+                    const A2pVideoFormat *format, int envs, int chunk,
+                    int depth, int start, int end, const char *pattern,
+                    A2pMapFile *map, const char *header);
+
+// blocks until the next frame in order is packed, returns its buffer
+BYTE *
+a2p_segments_next(A2pSegments *segments);
+
+// returns the buffer from a2p_segments_next to the workers
+void
+a2p_segments_release(A2pSegments *segments);
+
+// waits for every segment file or mapped frame to be written, returns the
+// frames written
+int
+a2p_segments_wait(A2pSegments *segments);
+
+// checks pattern holds exactly one integer conversion such as %06d
+int
+a2p_segments_pattern(const char *pattern);
+
+void
+a2p_segments_destroy(A2pSegments *segments);
+
+#endif // SEGMENT_H
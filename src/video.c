@@ -0,0 +1,638 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * YUV4MPEG2 output derived from Avs2YUV by Loren Merritt
+ * AviSynth 2.6.0 Alpha 2 Color Spaces from Chikuzen @ Doom9 Forums
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "common.h"
+#include "cpu.h"
+#include "blit.h"
+#include "deint.h"
+#include "video.h"
+
+// formats the conversion pool turns into 4:2:0 instead of ConvertToYV12
+static A2pConvertSource
+a2p_video_source(int pixel_type, const A2pVideoOptions *options)
+{
+    #ifdef A2P_AVS26
+    // 2.6 writes these natively unless 4:2:0 is asked for, --rgb wins
+    if(!options->csp420) return A2P_CONVERT_NONE;
+    if(options->rgb && (pixel_type == AVS_CS_BGR24 ||
+                        pixel_type == AVS_CS_BGR32)) return A2P_CONVERT_NONE;
+    #endif
+    switch(pixel_type) {
+        case AVS_CS_BGR24:
+            return A2P_CONVERT_BGR24;
+        case AVS_CS_BGR32:
+            return A2P_CONVERT_BGR32;
+        case AVS_CS_YUY2:
+            return A2P_CONVERT_YUY2;
+        #ifdef A2P_AVS26
+        case AVS_CS_YV16:
+            return A2P_CONVERT_YV16;
+        case AVS_CS_YV24:
+            return A2P_CONVERT_YV24;
+        #endif
+        default:
+            return A2P_CONVERT_NONE;
+    }
+}
+
+// p010 and v210 replace the y4m layout, samples are read from the frame
+// planes, or split from yuy2 for v210, and brought to 10 bits per row
+static void
+a2p_video_setup_raw(const AVS_VideoInfo *info, const A2pVideoOptions *options,
+                    A2pVideoFormat *format, int width_sft, int height_sft)
+{
+    const char *name;
+    int p010, readable, p;
+    
+    p010 = options->output == A2P_OUTPUT_P010;
+    name = p010 ? "p010" : "v210";
+    readable = format->pack == A2P_PACK_PLANAR ||
+               format->pack == A2P_PACK_DITHER ||
+               (format->pack == A2P_PACK_YUY2 && !p010);
+    if(!readable || format->planes_num != A2P_MAX_PLANES ||
+       width_sft != 1 || height_sft != (p010 ? 1 : 0)) {
+        a2p_log(A2P_LOG_ERROR, "%s needs %s video.\n", name,
+                p010 ? "planar 4:2:0" : "4:2:2");
+    }
+    if(options->depth && options->depth != 10) {
+        a2p_log(A2P_LOG_WARNING, "%s is 10 bit, ignoring --depth.\n", name);
+    }
+    
+    format->dither = options->dither;
+    if(format->source_depth > 10 && format->dither == A2P_DITHER_FS) {
+        // error diffusion works on whole planes, rows are packed one by one
+        a2p_log(A2P_LOG_WARNING, "%s uses ordered dither instead of fs.\n",
+                name);
+        format->dither = A2P_DITHER_ORDERED;
+    }
+    if(format->pack == A2P_PACK_YUY2) {
+        format->source = A2P_CONVERT_YUY2;
+    }
+    
+    format->depth = 10;
+    format->sample_size = 2;
+    format->header = 0;
+    format->segments = 1;
+    // only the written planes are described, planes[] still names the
+    // source planes the rows are read from
+    for(p = 0; p < A2P_MAX_PLANES; p++) {
+        format->width[p] = 0;
+        format->height[p] = 0;
+        format->offset[p] = 0;
+    }
+    if(p010) {
+        format->pack = A2P_PACK_P010;
+        format->yuv_csp = "420p10";
+        format->planes_num = 2;
+        format->width[0] = info->width * 2;
+        format->height[0] = info->height;
+        format->width[1] = info->width * 2;         // u and v interleaved
+        format->height[1] = info->height / 2;
+        format->offset[0] = 0;
+        format->offset[1] = format->width[0] * format->height[0];
+        format->size = format->offset[1] + format->width[1] * format->height[1];
+    } else {
+        format->pack = A2P_PACK_V210;
+        format->yuv_csp = "422p10";
+        format->planes_num = 1;
+        format->width[0] = A2P_V210_STRIDE(info->width);
+        format->height[0] = info->height;
+        format->offset[0] = 0;
+        format->size = format->width[0] * format->height[0];
+    }
+    
+    a2p_log(A2P_LOG_INFO, "writing raw %s video.\n", name);
+}
+
+AVS_Clip *
+a2p_video_setup(AVS_ScriptEnvironment *env, AVS_Clip *clip,
+                const A2pVideoOptions *options, A2pVideoFormat *format)
+{
+    static const int planes[] = {AVS_PLANAR_Y, AVS_PLANAR_U, AVS_PLANAR_V};
+    
+    const AVS_VideoInfo *info;
+    int32_t width_sft, height_sft;
+    size_t count;
+    int p, pixel_type;
+    A2pConvertSource source;
+    
+    info = avs_get_video_info(clip);
+    
+    if(!avs_has_video(info)) {
+        a2p_log(A2P_LOG_ERROR, "source has no video.\n");
+    }
+    
+    // Default number of planes to A2P_MAX_PLANES
+    format->planes_num = A2P_MAX_PLANES;
+    format->pack = A2P_PACK_PLANAR;
+    format->convert = NULL;
+    format->sample_size = 1;
+    format->depth = 8;
+    pixel_type = info->pixel_type;
+    
+    #ifdef A2P_AVS26
+    // high depth planar formats are laid out like their 8 bit versions
+    // with little endian 16 bit samples
+    if(avs_is_planar(info)) {
+        switch(pixel_type & AVS_CS_SAMPLE_BITS_MASK) {
+            case AVS_CS_SAMPLE_BITS_16:
+                format->sample_size = 2;
+                format->depth = options->sample_bits;
+                break;
+            case AVS_CS_SAMPLE_BITS_32:
+                a2p_log(A2P_LOG_ERROR, "float video is not supported.\n");
+            default:
+                break;
+        }
+        pixel_type &= ~AVS_CS_SAMPLE_BITS_MASK;
+    }
+    #endif
+    format->source_depth = format->depth;
+    
+    if(options->depth && options->depth < format->depth) {
+        a2p_log(A2P_LOG_INFO, "reducing video from %d to %d bits.\n",
+                format->depth, options->depth);
+        format->pack = A2P_PACK_DITHER;
+        format->dither = options->dither;
+        format->depth = options->depth;
+        format->sample_size = format->depth > 8 ? 2 : 1;
+    } else if(options->depth && options->depth != format->depth) {
+        a2p_log(A2P_LOG_WARNING, "--depth can not raise %d bit video, "
+                "ignoring it.\n", format->depth);
+    }
+    
+    source = a2p_video_source(pixel_type, options);
+    if(source != A2P_CONVERT_NONE && format->source_depth > 8) {
+        // the conversion pool only reads 8 bit samples
+        a2p_log(A2P_LOG_ERROR, "--csp 420 needs 8 bit video.\n");
+    }
+    format->source = source;
+    if(source != A2P_CONVERT_NONE) {
+        // converted while packing, the frame is laid out as yv12
+        format->pack = A2P_PACK_CONVERT;
+        format->convert = a2p_convert_create(source, info->width,
+                                             info->height,
+                                             avs_is_field_based(info),
+                                             options->matrix,
+                                             options->convert_threads);
+        pixel_type = AVS_CS_YV12;
+    }
+    
+    // Setup correct color space handling, tnx Chikuzen
+    switch(pixel_type) {
+        #ifdef A2P_AVS26
+        case AVS_CS_BGR32:
+        case AVS_CS_BGR24:
+            if(options->rgb) {
+                // no matrix, the planes are split while packing
+                a2p_log(A2P_LOG_INFO, "writing rgb video as gbr planes.\n");
+                format->pack = info->pixel_type == AVS_CS_BGR32 ?
+                               A2P_PACK_BGR32 : A2P_PACK_BGR24;
+                format->yuv_csp = "444";
+                count = info->width * info->height * 3;
+                width_sft = 0;
+                height_sft = 0;
+                break;
+            }
+            a2p_log(A2P_LOG_INFO, "converting video to yv24.\n");
+            clip = a2p_avs_filter(env, "ConvertToYV24", clip);
+            info = avs_get_video_info(clip);
+        case AVS_CS_YV24:
+            format->yuv_csp = "444";
+            count = info->width * info->height * 3;
+            width_sft = 0;
+            height_sft = 0;
+            break;
+        case AVS_CS_YUY2:
+            // lossless shuffle to yv16 while packing, no filter needed
+            format->pack = A2P_PACK_YUY2;
+        case AVS_CS_YV16:
+            format->yuv_csp = "422";
+            count = info->width * info->height * 2;
+            width_sft = 1;
+            height_sft = 0;
+            break;
+        case AVS_CS_YV411:
+            format->yuv_csp = "411";
+            count = info->width * info->height * 3 / 2;
+            width_sft = 2;
+            height_sft = 0;
+            break;
+        case AVS_CS_Y8:
+            format->yuv_csp = "mono";
+            count = info->width * info->height;
+            width_sft = 0;
+            height_sft = 0;
+            format->planes_num = 1; // special case only one plane for mono
+            break;
+        #endif        
+        default:
+            if(format->sample_size > 1) {
+                a2p_log(A2P_LOG_ERROR, "%d bit video of type %x is not "
+                        "supported.\n", format->depth, info->pixel_type);
+            }
+            a2p_log(A2P_LOG_INFO, "converting video to yv12.\n");
+            clip = a2p_avs_filter(env, "ConvertToYV12", clip);
+            info = avs_get_video_info(clip);
+        case AVS_CS_I420:
+        case AVS_CS_YV12:
+            format->yuv_csp = "420";
+            count = info->width * info->height * 3 / 2;
+            width_sft = 1;
+            height_sft = 1;
+    }
+    
+    // y4m high depth tags as written by ffmpeg, eg. C420p10 and Cmono16
+    if(format->sample_size > 1) {
+        if(strcmp(format->yuv_csp, "411") == 0) {
+            a2p_log(A2P_LOG_ERROR, "y4m has no tag for %d bit 411 video.\n",
+                    format->depth);
+        }
+        sprintf(format->csp_tag, strcmp(format->yuv_csp, "mono") ?
+                "%sp%d" : "%s%d", format->yuv_csp, format->depth);
+        format->yuv_csp = format->csp_tag;
+        count *= format->sample_size;
+    }
+    
+    // avs2yuv method changed to c with malloc, memcpy, avs_bit_blt, more csps
+    // calculate output buffer planes pitches
+    format->header = strlen(A2P_FRAME_HEADER) * sizeof(char);
+    format->size = format->header; // space for FRAME header
+    format->segments = 1;
+    count += format->header / sizeof(BYTE); // increase count to add FRAME
+    format->width_sft = width_sft;
+    format->height_sft = height_sft;
+    for(p = 0; p < format->planes_num; p++) {
+        format->planes[p] = planes[p];
+        format->width[p] = (info->width >> (p ? width_sft : 0)) *
+                           format->sample_size;
+        format->height[p] = info->height >> (p ? height_sft : 0);
+        format->offset[p] = format->size;
+        format->size += format->width[p] * format->height[p];
+        format->segments += format->height[p];
+    }
+    // check buff size to be sure on spec
+    if(format->size / sizeof(BYTE) != count) {
+        a2p_log(A2P_LOG_ERROR, "buffer size %d does not match count %d.\n",
+                format->size / sizeof(BYTE), count);
+    }
+    if(options->output != A2P_OUTPUT_Y4M) {
+        a2p_video_setup_raw(info, options, format, width_sft, height_sft);
+    }
+    // frames bigger than the cache are evicted before they are written
+    // anyway, so bypass the cache rather than flush useful data from it
+    format->stream = format->size > a2p_cpu_cache_size();
+    
+    return clip;
+}
+
+void
+a2p_video_rung(const A2pVideoFormat *base, int width, int height,
+               A2pVideoFormat *rung)
+{
+    int p;
+    
+    if(base->sample_size != 1 || base->yuv_csp == base->csp_tag) {
+        a2p_log(A2P_LOG_ERROR, "only 8 bit y4m video can be scaled.\n");
+    }
+    if(width <= 0 || height <= 0 ||
+       width % (1 << base->width_sft) || height % (1 << base->height_sft)) {
+        a2p_log(A2P_LOG_ERROR, "%dx%d does not fit %s subsampling.\n",
+                width, height, base->yuv_csp);
+    }
+    *rung = *base;
+    rung->pack = A2P_PACK_PLANAR;
+    rung->convert = NULL;
+    rung->size = rung->header;
+    rung->segments = 1;
+    for(p = 0; p < rung->planes_num; p++) {
+        rung->width[p] = width >> (p ? rung->width_sft : 0);
+        rung->height[p] = height >> (p ? rung->height_sft : 0);
+        rung->offset[p] = rung->size;
+        rung->size += rung->width[p] * rung->height[p];
+        rung->segments += rung->height[p];
+    }
+    rung->stream = rung->size > a2p_cpu_cache_size();
+}
+
+void
+a2p_video_close(A2pVideoFormat *format)
+{
+    if(format->convert != NULL) {
+        a2p_convert_destroy(format->convert);
+        format->convert = NULL;
+    }
+}
+
+// row r of plane p as 10 bit samples, in place when it already is
+static const uint16_t *
+a2p_video_row10(const A2pVideoFormat *format, AVS_VideoFrame *frame, int p,
+                int r, int width, uint16_t *scratch)
+{
+    const BYTE *read_ptr;
+    
+    read_ptr = avs_get_read_ptr_p(frame, format->planes[p]) +
+               r * avs_get_pitch_p(frame, format->planes[p]);
+    if(format->source_depth == 10) {
+        return (const uint16_t *) read_ptr;
+    } else if(format->source_depth > 10) {
+        a2p_dither_row(format->dither, scratch, (const uint16_t *) read_ptr,
+                       width, r, format->source_depth, 10);
+    } else {
+        a2p_widen_10(scratch, read_ptr, width, format->source_depth);
+    }
+    
+    return scratch;
+}
+
+static void
+a2p_video_pack_raw(const A2pVideoFormat *format, AVS_VideoFrame *frame,
+                   BYTE *buff)
+{
+    const uint16_t *rows[A2P_MAX_PLANES];
+    const BYTE *read_ptr;
+    uint16_t *scratch;
+    uint8_t *split;
+    BYTE *dst;
+    int width, cw, used, r;
+    
+    if(format->source == A2P_CONVERT_YUY2) {
+        width = avs_get_row_size(frame) / 2;
+    } else {
+        width = avs_get_row_size_p(frame, format->planes[0]) /
+                (format->source_depth > 8 ? 2 : 1);
+    }
+    cw = width / 2;
+    
+    // per call so prefetch workers can pack at the same time
+    scratch = malloc(width * 2 * sizeof(*scratch) + width * 2);
+    if(scratch == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate row buffers.\n");
+    }
+    split = (uint8_t *) (scratch + width * 2);
+    
+    dst = buff;
+    if(format->pack == A2P_PACK_P010) {
+        for(r = 0; r < format->height[0]; r++) {
+            rows[0] = a2p_video_row10(format, frame, 0, r, width, scratch);
+            a2p_p010_luma((uint16_t *) dst, rows[0], width);
+            dst += format->width[0];
+        }
+        for(r = 0; r < format->height[1]; r++) {
+            rows[1] = a2p_video_row10(format, frame, 1, r, cw, scratch);
+            rows[2] = a2p_video_row10(format, frame, 2, r, cw, scratch + cw);
+            a2p_p010_chroma((uint16_t *) dst, rows[1], rows[2], cw);
+            dst += format->width[1];
+        }
+    } else {
+        used = (width + 5) / 6 * 16;
+        read_ptr = avs_get_read_ptr(frame);
+        for(r = 0; r < format->height[0]; r++) {
+            if(format->source == A2P_CONVERT_YUY2) {
+                a2p_deint_yuy2(split, split + width, split + width + cw,
+                               read_ptr, width);
+                a2p_widen_10(scratch, split, width, 8);
+                a2p_widen_10(scratch + width, split + width, cw, 8);
+                a2p_widen_10(scratch + width + cw, split + width + cw, cw, 8);
+                rows[0] = scratch;
+                rows[1] = scratch + width;
+                rows[2] = scratch + width + cw;
+                read_ptr += avs_get_pitch(frame);
+            } else {
+                rows[0] = a2p_video_row10(format, frame, 0, r, width, scratch);
+                rows[1] = a2p_video_row10(format, frame, 1, r, cw,
+                                          scratch + width);
+                rows[2] = a2p_video_row10(format, frame, 2, r, cw,
+                                          scratch + width + cw);
+            }
+            a2p_v210_row(dst, rows[0], rows[1], rows[2], width);
+            memset(dst + used, 0, format->width[0] - used);
+            dst += format->width[0];
+        }
+    }
+    
+    free(scratch);
+}
+
+// YUV4MPEG2 header http://wiki.multimedia.cx/index.php?title=YUV4MPEG2
+void
+a2p_video_y4m_header(char *header, const AVS_VideoInfo *info,
+                     const A2pVideoFormat *format,
+                     const A2pVideoOptions *options)
+{
+    header[0] = '\0';
+    if(options->output == A2P_OUTPUT_Y4M) {
+        sprintf(header, "YUV4MPEG2 W%d H%d F%u:%u I%s A0:0 C%s\n", info->width,
+                info->height, info->fps_numerator, info->fps_denominator,
+                !avs_is_field_based(info) ? "p" : !avs_is_bff(info) ? "t" : "b",
+                format->yuv_csp);
+    }
+}
+
+// raw pixel format tags as ffmpeg reads them, the gbr and high depth ones
+// carry the subsampling and bits in the last two bytes
+int
+a2p_video_fourcc(const A2pVideoFormat *format, char *fourcc)
+{
+    const char *csp = format->yuv_csp;
+    
+    if(format->pack == A2P_PACK_V210) return 0;
+    if(format->pack == A2P_PACK_P010) {
+        memcpy(fourcc, "P010", 4);
+        return 1;
+    }
+    if(format->sample_size == 1) {
+        if(format->pack == A2P_PACK_BGR24 || format->pack == A2P_PACK_BGR32) {
+            memcpy(fourcc, "G3", 2);
+            fourcc[2] = 0;
+            fourcc[3] = 8;
+        } else if(strcmp(csp, "420") == 0) {
+            memcpy(fourcc, "I420", 4);
+        } else if(strcmp(csp, "422") == 0) {
+            memcpy(fourcc, "Y42B", 4);
+        } else if(strcmp(csp, "444") == 0) {
+            memcpy(fourcc, "444P", 4);
+        } else if(strcmp(csp, "411") == 0) {
+            memcpy(fourcc, "Y41B", 4);
+        } else if(strcmp(csp, "mono") == 0) {
+            memcpy(fourcc, "Y800", 4);
+        } else {
+            return 0;
+        }
+        return 1;
+    }
+    
+    memcpy(fourcc, "Y3", 2);
+    if(strncmp(csp, "420", 3) == 0) {
+        fourcc[2] = 11;
+    } else if(strncmp(csp, "422", 3) == 0) {
+        fourcc[2] = 10;
+    } else if(strncmp(csp, "444", 3) == 0) {
+        fourcc[2] = 0;
+    } else if(strncmp(csp, "mono", 4) == 0) {
+        fourcc[1] = '1';
+        fourcc[2] = 0;
+    } else {
+        return 0;
+    }
+    fourcc[3] = (char) format->depth;
+    
+    return 1;
+}
+
+BYTE *
+a2p_video_alloc(const A2pVideoFormat *format)
+{
+    BYTE *buff;
+    
+    buff = (BYTE *) malloc(format->size);
+    if(buff == NULL) { // some idiot (me) forgot to check malloc return before
+        a2p_log(A2P_LOG_ERROR, "could not allocate frame buffer.\n");
+    }
+    
+    return buff;
+}
+
+void
+a2p_video_pack(AVS_ScriptEnvironment *env, const A2pVideoFormat *format,
+               AVS_VideoFrame *frame, BYTE *buff)
+{
+    A2pBlitFunc blit;
+    A2pDeintFunc deint;
+    const BYTE *read_ptr;
+    const BYTE *src[A2P_MAX_PLANES];
+    BYTE *dst[A2P_MAX_PLANES];
+    int pitches[A2P_MAX_PLANES];
+    int32_t pitch;
+    int p, r;
+    
+    // copy FRAME header to buffer, planes are packed in after it
+    memcpy(buff, A2P_FRAME_HEADER, format->header);
+    
+    if(format->pack == A2P_PACK_CONVERT) {
+        for(p = 0; p < A2P_MAX_PLANES; p++) {
+            dst[p] = buff + format->offset[p];
+            switch(format->source) {
+                case A2P_CONVERT_BGR24:
+                case A2P_CONVERT_BGR32:
+                    // rgb frames are stored bottom up
+                    pitches[p] = -avs_get_pitch(frame);
+                    src[p] = avs_get_read_ptr(frame)
+                             - (format->height[0] - 1) * pitches[p];
+                    break;
+                case A2P_CONVERT_YUY2:
+                    pitches[p] = avs_get_pitch(frame);
+                    src[p] = avs_get_read_ptr(frame);
+                    break;
+                default:
+                    pitches[p] = avs_get_pitch_p(frame, format->planes[p]);
+                    src[p] = avs_get_read_ptr_p(frame, format->planes[p]);
+                    break;
+            }
+        }
+        a2p_convert_frame(format->convert, src, pitches, dst);
+        return;
+    }
+    
+    if(format->pack == A2P_PACK_P010 || format->pack == A2P_PACK_V210) {
+        a2p_video_pack_raw(format, frame, buff);
+        return;
+    }
+    
+    if(format->pack == A2P_PACK_DITHER) {
+        for(p = 0; p < format->planes_num; p++) {
+            a2p_dither_plane(format->dither, buff + format->offset[p],
+                             format->width[p],
+                             avs_get_read_ptr_p(frame, format->planes[p]),
+                             avs_get_pitch_p(frame, format->planes[p]),
+                             avs_get_row_size_p(frame, format->planes[p]) / 2,
+                             avs_get_height_p(frame, format->planes[p]),
+                             format->source_depth, format->depth);
+        }
+        return;
+    }
+    
+    if(format->pack == A2P_PACK_PLANAR) {
+        blit = format->stream ? a2p_blit_stream : a2p_blit;
+        for(p = 0; p < format->planes_num; p++) {
+            blit(buff + format->offset[p], format->width[p],
+                 avs_get_read_ptr_p(frame, format->planes[p]),
+                 avs_get_pitch_p(frame, format->planes[p]),
+                 avs_get_row_size_p(frame, format->planes[p]),
+                 avs_get_height_p(frame, format->planes[p]));
+        }
+        return;
+    }
+    
+    read_ptr = avs_get_read_ptr(frame);
+    pitch = avs_get_pitch(frame);
+    switch(format->pack) {
+        case A2P_PACK_YUY2:
+            deint = a2p_deint_yuy2;
+            break;
+        case A2P_PACK_BGR24:
+        case A2P_PACK_BGR32:
+        default:
+            deint = format->pack == A2P_PACK_BGR32 ?
+                    a2p_deint_bgr32 : a2p_deint_bgr24;
+            // rgb frames are stored bottom up
+            read_ptr += (format->height[0] - 1) * pitch;
+            pitch = -pitch;
+            break;
+    }
+    for(p = 0; p < A2P_MAX_PLANES; p++) {
+        dst[p] = buff + format->offset[p];
+    }
+    for(r = 0; r < format->height[0]; r++) {
+        deint(dst[0], dst[1], dst[2], read_ptr, format->width[0]);
+        for(p = 0; p < A2P_MAX_PLANES; p++) {
+            dst[p] += format->width[p];
+        }
+        read_ptr += pitch;
+    }
+}
+
+int
+a2p_video_gather(const A2pVideoFormat *format, AVS_VideoFrame *frame,
+                 A2pIoVec *vec)
+{
+    const BYTE *read_ptr;
+    int32_t pitch;
+    int count, p, r;
+    
+    count = a2p_iovec_add(vec, 0, A2P_FRAME_HEADER, format->header);
+    for(p = 0; p < format->planes_num; p++) {
+        read_ptr = avs_get_read_ptr_p(frame, format->planes[p]);
+        pitch = avs_get_pitch_p(frame, format->planes[p]);
+        // unpadded planes merge into a single segment
+        for(r = 0; r < format->height[p]; r++) {
+            count = a2p_iovec_add(vec, count, read_ptr, format->width[p]);
+            read_ptr += pitch;
+        }
+    }
+    
+    return count;
+}
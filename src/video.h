@@ -0,0 +1,134 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// YUV4MPEG2 frame layout shared by the serial and threaded video paths
+
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "avs2pipe.h"
+#include "gather.h"
+#include "convert.h"
+#include "dither.h"
+#include "pack10.h"
+
+// If np > 3 is ever needed increase A2P_MAX_PLANES define
+#define A2P_MAX_PLANES 3
+#define A2P_FRAME_HEADER "FRAME\n"
+
+// longest y4m stream header
+#define A2P_Y4M_HEADER_MAX 128
+
+typedef enum A2pPackType A2pPackType;
+typedef enum A2pOutput A2pOutput;
+typedef struct A2pVideoOptions A2pVideoOptions;
+typedef struct A2pVideoFormat A2pVideoFormat;
+
+enum A2pPackType {
+    A2P_PACK_PLANAR,                        // copy planes as they are
+    A2P_PACK_YUY2,                          // split into Y, U, V
+    A2P_PACK_BGR24,                         // split into G, B, R, flip
+    A2P_PACK_BGR32,
+    A2P_PACK_CONVERT,                       // 4:2:0 by the conversion pool
+    A2P_PACK_DITHER,                        // planes reduced to depth
+    A2P_PACK_P010,                          // raw 10 bit outputs
+    A2P_PACK_V210
+};
+
+enum A2pOutput {
+    A2P_OUTPUT_Y4M,
+    A2P_OUTPUT_P010,                        // raw Y plane, interleaved UV
+    A2P_OUTPUT_V210                         // raw packed 4:2:2
+};
+
+struct A2pVideoOptions {
+    int         rgb;                        // keep rgb as G, B, R planes
+    int         csp420;                     // convert everything to 4:2:0
+    int         matrix;                     // 601 or 709 for rgb sources
+    int         convert_threads;            // 0 for one per cpu
+    int         sample_bits;                // bits used of 16 bit samples
+    int         depth;                      // output bits, 0 to keep
+    A2pDitherMode dither;                   // how depth is reduced
+    A2pOutput   output;                     // stream written
+};
+
+struct A2pVideoFormat {
+    A2pPackType pack;
+    int         planes_num;                 // number of planes written
+    int         planes[A2P_MAX_PLANES];     // AVS_PLANAR_* of each plane
+    int32_t     width[A2P_MAX_PLANES];      // bytes per packed row
+    int32_t     height[A2P_MAX_PLANES];     // rows per plane
+    size_t      offset[A2P_MAX_PLANES];     // plane offset into frame buffer
+    int         width_sft;                  // chroma subsampling shifts
+    int         height_sft;
+    size_t      header;                     // size of FRAME header
+    size_t      size;                       // FRAME header + all planes
+    int         segments;                   // most a2p_video_gather can use
+    int         stream;                     // pack with non-temporal stores
+    const char *yuv_csp;                    // y4m C tag, eg. 420 or 420p10
+    char        csp_tag[16];                // yuv_csp of high depth video
+    int         sample_size;                // bytes per sample, 1 or 2
+    int         depth;                      // bits per sample
+    int         source_depth;               // bits per sample read
+    A2pDitherMode dither;                   // set for A2P_PACK_DITHER
+    A2pConvert *convert;                    // set for A2P_PACK_CONVERT
+    A2pConvertSource source;                // packed layout read, if any
+};
+
+AVS_Clip *
+a2p_video_setup(AVS_ScriptEnvironment *env, AVS_Clip *clip,
+                const A2pVideoOptions *options, A2pVideoFormat *format);
+
+// layout of base scaled to width x height, for the ladder outputs
+void
+a2p_video_rung(const A2pVideoFormat *base, int width, int height,
+               A2pVideoFormat *rung);
+
+// frees what a2p_video_setup created, call once the frames are written
+void
+a2p_video_close(A2pVideoFormat *format);
+
+// stream header written before the frames, raw outputs are just the
+// frames back to back and get an empty header
+void
+a2p_video_y4m_header(char *header, const AVS_VideoInfo *info,
+                     const A2pVideoFormat *format,
+                     const A2pVideoOptions *options);
+
+// four bytes naming the written planes for raw video in containers such
+// as matroska, 0 when there is none
+int
+a2p_video_fourcc(const A2pVideoFormat *format, char *fourcc);
+
+BYTE *
+a2p_video_alloc(const A2pVideoFormat *format);
+
+void
+a2p_video_pack(AVS_ScriptEnvironment *env, const A2pVideoFormat *format,
+               AVS_VideoFrame *frame, BYTE *buff);
+
+// lists the frame's rows in place, the frame must outlive the write
+int
+a2p_video_gather(const A2pVideoFormat *format, AVS_VideoFrame *frame,
+                 A2pIoVec *vec);
+
+#endif // VIDEO_H
@@ -152,3 +152,37 @@ wave_create_rf64_header(WaveFormatType format,
 
     return header;
 }
+
+int
+wave_needs_rf64(uint16_t channels, uint16_t byte_depth, uint64_t samples)
+{
+    return samples * channels * byte_depth + sizeof(WaveRiffHeader)
+             - sizeof(WaveChunkHeader) > UINT32_MAX;
+}
+
+void
+wave_set_rf64_size(WaveRf64Header *header, uint64_t samples, int rf64)
+{
+    uint64_t data_size = samples * header->format.block_align;
+
+    header->ds64.riff_size      = data_size + sizeof(*header)
+                                    - sizeof(header->riff.header);
+    header->ds64.data_size      = data_size;
+    header->ds64.fact_samples   = samples;
+    header->ds64.table_size     = 0;
+
+    if(rf64 || header->ds64.riff_size > UINT32_MAX) {
+        header->riff.header.id  = WAVE_FOURCC('R', 'F', '6', '4');
+        header->riff.header.size = -1;
+        header->ds64.header.id  = WAVE_FOURCC('d', 's', '6', '4');
+        header->fact.samples    = -1;
+        header->data.header.size = -1;
+    } else {
+        // readers skip JUNK, its contents do not matter
+        header->riff.header.id  = WAVE_FOURCC('R', 'I', 'F', 'F');
+        header->riff.header.size = (uint32_t) header->ds64.riff_size;
+        header->ds64.header.id  = WAVE_FOURCC('J', 'U', 'N', 'K');
+        header->fact.samples    = (uint32_t) samples;
+        header->data.header.size = (uint32_t) data_size;
+    }
+}
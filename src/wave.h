@@ -59,6 +59,16 @@ wave_create_rf64_header (WaveFormatType format,
                            uint16_t       byte_depth,
                            uint64_t       samples);
 
+// data chunk of samples is too big for the 32 bit sizes of a RIFF header
+int
+wave_needs_rf64(uint16_t channels, uint16_t byte_depth, uint64_t samples);
+
+// sets the sizes of an RF64 header for samples, unless rf64 is set one
+// that fits becomes a RIFF header with its ds64 chunk turned into JUNK, so
+// a file can start with either and be rewritten once the data is written
+void
+wave_set_rf64_size(WaveRf64Header *header, uint64_t samples, int rf64);
+
 
 enum WaveFormatType {
     WAVE_FORMAT_PCM         = 0x0001,   // samples are ints
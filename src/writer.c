@@ -0,0 +1,395 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <io.h>
+#include <windows.h>
+#include <process.h>
+#include "common.h"
+#include "net.h"
+#include "writer.h"
+
+typedef struct A2pWriterOutput A2pWriterOutput;
+
+// ReOpenFile is looked up at run time, XP does not have it
+typedef HANDLE (WINAPI *A2pReOpenFile)(HANDLE, DWORD, DWORD, DWORD);
+
+struct A2pWriterOutput {
+    A2pWriter      *writer;
+    FILE           *file;
+    A2pNet         *net;            // set for a socket instead of file
+    volatile LONG   tail;           // buffers written
+    volatile LONG   failed;
+    HANDLE          filled;
+    HANDLE          thread;
+    uint64_t        wrote;
+    
+    // overlapped outputs have no thread, the producer issues the writes
+    // and reaps them when it needs their buffer again
+    HANDLE          async;
+    OVERLAPPED     *ovs;            // one per buffer
+    char           *issued;         // ovs[i] has a write in flight
+    uint64_t        offset;         // file position of the next write
+};
+
+struct A2pWriter {
+    int             count;          // buffers in the ring
+    size_t          size;
+    int             locked;         // buffers are VirtualAlloc'd and locked
+    void          **buffs;
+    size_t         *sizes;          // bytes committed in each buffer
+    
+    // head is only advanced by the producer and each tail by its output
+    // thread, the events just wake a side that found the ring full or empty
+    volatile LONG   head;           // buffers committed
+    volatile LONG   closing;
+    HANDLE          drained;
+    
+    int             outputs_num;
+    A2pWriterOutput *outputs;
+};
+
+static int
+a2p_writer_put(A2pWriterOutput *o, const void *buff, size_t size)
+{
+    if(o->net != NULL) return a2p_net_send(o->net, buff, size);
+    
+    return fwrite(buff, 1, size, o->file) == size;
+}
+
+static unsigned __stdcall
+a2p_writer_thread(void *data)
+{
+    A2pWriterOutput *o = data;
+    A2pWriter *w = o->writer;
+    int i;
+    
+    for(;;) {
+        while(o->tail == w->head) {
+            if(w->closing) return 0;
+            WaitForSingleObject(o->filled, INFINITE);
+        }
+        i = o->tail % w->count;
+        if(!a2p_writer_put(o, w->buffs[i], w->sizes[i])) {
+            // fail early, the producer stops waiting on this output
+            InterlockedExchange(&o->failed, 1);
+            SetEvent(w->drained);
+            return 0;
+        }
+        o->wrote++;
+        InterlockedIncrement(&o->tail);
+        SetEvent(w->drained);
+    }
+}
+
+// an overlapped handle on the open file and where writes continue, NULL
+// when the system or the file can not take overlapped writes, such as
+// the anonymous pipe of a shell redirect
+static HANDLE
+a2p_writer_reopen(FILE *file, uint64_t *offset)
+{
+    A2pReOpenFile reopen;
+    HANDLE handle, async;
+    LARGE_INTEGER zero, pos;
+    DWORD type;
+    
+    reopen = (A2pReOpenFile) GetProcAddress(GetModuleHandleA("kernel32.dll"),
+                                            "ReOpenFile");
+    if(reopen == NULL) return NULL;
+    
+    fflush(file);
+    handle = (HANDLE) _get_osfhandle(_fileno(file));
+    if(handle == INVALID_HANDLE_VALUE) return NULL;
+    type = GetFileType(handle);
+    if(type != FILE_TYPE_DISK && type != FILE_TYPE_PIPE) return NULL;
+    async = reopen(handle, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                   FILE_FLAG_OVERLAPPED);
+    if(async == INVALID_HANDLE_VALUE) return NULL;
+    
+    // pipes have no position and ignore the offset
+    zero.QuadPart = 0;
+    *offset = SetFilePointerEx(handle, zero, &pos, FILE_CURRENT) ?
+              (uint64_t) pos.QuadPart : 0;
+    
+    return async;
+}
+
+static void
+a2p_writer_issue(A2pWriterOutput *o, int i)
+{
+    A2pWriter *w = o->writer;
+    OVERLAPPED *ov = &o->ovs[i];
+    
+    ov->Internal = 0;
+    ov->InternalHigh = 0;
+    ov->Offset = (DWORD) o->offset;
+    ov->OffsetHigh = (DWORD) (o->offset >> 32);
+    if(!WriteFile(o->async, w->buffs[i], (DWORD) w->sizes[i], NULL, ov) &&
+       GetLastError() != ERROR_IO_PENDING) {
+        o->failed = 1;
+        return;
+    }
+    o->issued[i] = 1;
+    o->offset += w->sizes[i];
+}
+
+// waits for the oldest buffer of an overlapped output to be written
+static void
+a2p_writer_reap(A2pWriterOutput *o)
+{
+    A2pWriter *w = o->writer;
+    DWORD done;
+    int i;
+    
+    i = o->tail % w->count;
+    if(o->issued[i]) {
+        if(!GetOverlappedResult(o->async, &o->ovs[i], &done, TRUE) ||
+           done != w->sizes[i]) {
+            o->failed = 1;
+        } else if(!o->failed) {
+            o->wrote++;
+        }
+        o->issued[i] = 0;
+    }
+    o->tail++;
+}
+
+static A2pWriter *
+a2p_writer_open(FILE *const *files, A2pNet *net, int files_num, size_t size,
+                int count, int async)
+{
+    A2pWriter *w;
+    A2pWriterOutput *o;
+    int i, j;
+    
+    w = malloc(sizeof(*w));
+    if(w == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate writer state.\n");
+    }
+    w->count = count;
+    w->size = size;
+    w->locked = async;
+    w->head = 0;
+    w->closing = 0;
+    
+    w->buffs = malloc(count * sizeof(*w->buffs));
+    w->sizes = malloc(count * sizeof(*w->sizes));
+    w->outputs = malloc(files_num * sizeof(*w->outputs));
+    if(w->buffs == NULL || w->sizes == NULL || w->outputs == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not allocate writer state.\n");
+    }
+    for(i = 0; i < count; i++) {
+        if(w->locked) {
+            // overlapped writes lock the pages of the buffer for every
+            // write, keeping the ring locked saves doing it each time,
+            // it is only a hint and may fail under a small working set
+            w->buffs[i] = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE,
+                                       PAGE_READWRITE);
+            if(w->buffs[i] != NULL) VirtualLock(w->buffs[i], size);
+        } else {
+            w->buffs[i] = malloc(size);
+        }
+        if(w->buffs[i] == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not allocate writer buffer.\n");
+        }
+    }
+    
+    w->drained = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if(w->drained == NULL) {
+        a2p_log(A2P_LOG_ERROR, "could not create writer event.\n");
+    }
+    
+    w->outputs_num = files_num;
+    for(i = 0; i < files_num; i++) {
+        o = &w->outputs[i];
+        o->writer = w;
+        o->file = files != NULL ? files[i] : NULL;
+        o->net = net;
+        o->tail = 0;
+        o->failed = 0;
+        o->wrote = 0;
+        o->filled = NULL;
+        o->thread = NULL;
+        o->async = async && net == NULL ?
+                   a2p_writer_reopen(files[i], &o->offset) : NULL;
+        if(o->async != NULL) {
+            o->ovs = calloc(count, sizeof(*o->ovs));
+            o->issued = calloc(count, sizeof(*o->issued));
+            if(o->ovs == NULL || o->issued == NULL) {
+                a2p_log(A2P_LOG_ERROR, "could not allocate writer state.\n");
+            }
+            for(j = 0; j < count; j++) {
+                o->ovs[j].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+                if(o->ovs[j].hEvent == NULL) {
+                    a2p_log(A2P_LOG_ERROR, "could not create writer event.\n");
+                }
+            }
+            continue;
+        }
+        if(async) {
+            a2p_log(A2P_LOG_INFO, "output %d can not be written overlapped, "
+                    "using a writer thread.\n", i + 1);
+        }
+        o->filled = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if(o->filled == NULL) {
+            a2p_log(A2P_LOG_ERROR, "could not create writer event.\n");
+        }
+        o->thread = (HANDLE) _beginthreadex(NULL, 0, a2p_writer_thread, o, 0,
+                                            NULL);
+        if(o->thread == 0) {
+            a2p_log(A2P_LOG_ERROR, "could not start writer thread.\n");
+        }
+    }
+    
+    return w;
+}
+
+A2pWriter *
+a2p_writer_create(FILE *file, size_t size, int count)
+{
+    return a2p_writer_open(&file, NULL, 1, size, count, 0);
+}
+
+A2pWriter *
+a2p_writer_create_tee(FILE *const *files, int files_num, size_t size,
+                      int count)
+{
+    return a2p_writer_open(files, NULL, files_num, size, count, 0);
+}
+
+A2pWriter *
+a2p_writer_create_async(FILE *const *files, int files_num, size_t size,
+                        int count)
+{
+    return a2p_writer_open(files, NULL, files_num, size, count, 1);
+}
+
+A2pWriter *
+a2p_writer_create_net(A2pNet *net, size_t size, int count)
+{
+    return a2p_writer_open(NULL, net, 1, size, count, 0);
+}
+
+// buffers still waited on by the slowest live output, -1 when all failed
+static LONG
+a2p_writer_pending(A2pWriter *w)
+{
+    LONG pending, used;
+    int i;
+    
+    pending = -1;
+    for(i = 0; i < w->outputs_num; i++) {
+        if(w->outputs[i].failed) continue;
+        used = w->head - w->outputs[i].tail;
+        if(used > pending) pending = used;
+    }
+    
+    return pending;
+}
+
+void *
+a2p_writer_acquire(A2pWriter *w)
+{
+    A2pWriterOutput *o;
+    LONG pending;
+    int i;
+    
+    // completed overlapped writes give their buffers back to the ring
+    for(i = 0; i < w->outputs_num; i++) {
+        o = &w->outputs[i];
+        while(o->async != NULL && !o->failed && w->head - o->tail >= w->count) {
+            a2p_writer_reap(o);
+        }
+    }
+    while((pending = a2p_writer_pending(w)) >= w->count) {
+        WaitForSingleObject(w->drained, INFINITE);
+    }
+    if(pending < 0) return NULL;
+    
+    return w->buffs[w->head % w->count];
+}
+
+void
+a2p_writer_commit(A2pWriter *w, size_t size)
+{
+    int i;
+    
+    w->sizes[w->head % w->count] = size;
+    // interlocked ops are full barriers so the writers see size first
+    for(i = 0; i < w->outputs_num; i++) {
+        if(w->outputs[i].async != NULL && !w->outputs[i].failed) {
+            a2p_writer_issue(&w->outputs[i], w->head % w->count);
+        }
+    }
+    InterlockedIncrement(&w->head);
+    for(i = 0; i < w->outputs_num; i++) {
+        if(w->outputs[i].filled != NULL) SetEvent(w->outputs[i].filled);
+    }
+}
+
+uint64_t
+a2p_writer_destroy(A2pWriter *w)
+{
+    A2pWriterOutput *o;
+    uint64_t wrote;
+    int i, j;
+    
+    InterlockedExchange(&w->closing, 1);
+    wrote = 0;
+    for(i = 0; i < w->outputs_num; i++) {
+        o = &w->outputs[i];
+        if(o->async != NULL) {
+            // even a failed output has to finish with its buffers
+            while(o->tail != w->head) a2p_writer_reap(o);
+            for(j = 0; j < w->count; j++) {
+                CloseHandle(o->ovs[j].hEvent);
+            }
+            CloseHandle(o->async);
+            free(o->issued);
+            free(o->ovs);
+        } else {
+            SetEvent(o->filled);
+            WaitForSingleObject(o->thread, INFINITE);
+            CloseHandle(o->thread);
+            CloseHandle(o->filled);
+        }
+        if(o->failed && w->outputs_num > 1) {
+            a2p_log(A2P_LOG_WARNING, "output %d failed after %I64u "
+                    "buffers.\n", i + 1, o->wrote);
+        }
+        if(i == 0 || o->wrote < wrote) wrote = o->wrote;
+    }
+    
+    CloseHandle(w->drained);
+    for(i = 0; i < w->count; i++) {
+        if(w->locked) {
+            VirtualUnlock(w->buffs[i], w->size);
+            VirtualFree(w->buffs[i], 0, MEM_RELEASE);
+        } else {
+            free(w->buffs[i]);
+        }
+    }
+    free(w->outputs);
+    free(w->sizes);
+    free(w->buffs);
+    free(w);
+    
+    return wrote;
+}
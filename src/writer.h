@@ -0,0 +1,71 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Output writer threads fed through a single producer ring of buffers so
+// rendering the next buffer overlaps writing the last one. Each output has
+// its own thread and read position, so a slow output only holds up the
+// producer once the whole ring is waiting on it. Outputs can instead be
+// written with overlapped I/O, keeping every buffer of the ring in flight
+// without a thread.
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "net.h"
+
+typedef struct A2pWriter A2pWriter;
+
+A2pWriter *
+a2p_writer_create(FILE *file, size_t size, int count);
+
+// every committed buffer is written to all files
+A2pWriter *
+a2p_writer_create_tee(FILE *const *files, int files_num, size_t size,
+                      int count);
+
+// files and named pipes get overlapped writes issued from commit, the ring
+// buffers are locked in memory, other outputs fall back to a thread
+A2pWriter *
+a2p_writer_create_async(FILE *const *files, int files_num, size_t size,
+                        int count);
+
+// buffers are sent on a connection, so packing the next frame overlaps
+// sending the last
+A2pWriter *
+a2p_writer_create_net(A2pNet *net, size_t size, int count);
+
+// blocks for a free buffer of size bytes, NULL once writes to every file
+// have failed, a file that fails is dropped with a warning
+void *
+a2p_writer_acquire(A2pWriter *writer);
+
+// queues size bytes of the acquired buffer for writing
+void
+a2p_writer_commit(A2pWriter *writer, size_t size);
+
+// drains the ring and returns the fewest buffers completely written to
+// any of the files
+uint64_t
+a2p_writer_destroy(A2pWriter *writer);
+
+#endif // WRITER_H
@@ -0,0 +1,93 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include "xxh32.h"
+
+#define A2P_XXH_PRIME1  2654435761U
+#define A2P_XXH_PRIME2  2246822519U
+#define A2P_XXH_PRIME3  3266489917U
+#define A2P_XXH_PRIME4  668265263U
+#define A2P_XXH_PRIME5  374761393U
+
+#define A2P_XXH_ROTL(x, r) (((x) << (r)) | ((x) >> (32 - (r))))
+
+static uint32_t
+a2p_xxh32_read(const uint8_t *p)
+{
+    uint32_t v;
+    
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t
+a2p_xxh32_round(uint32_t acc, uint32_t input)
+{
+    acc += input * A2P_XXH_PRIME2;
+    acc = A2P_XXH_ROTL(acc, 13);
+    return acc * A2P_XXH_PRIME1;
+}
+
+uint32_t
+a2p_xxh32(const void *data, size_t size, uint32_t seed)
+{
+    const uint8_t *p = data;
+    const uint8_t *end = p + size;
+    uint32_t v1, v2, v3, v4, h;
+    
+    if(size >= 16) {
+        v1 = seed + A2P_XXH_PRIME1 + A2P_XXH_PRIME2;
+        v2 = seed + A2P_XXH_PRIME2;
+        v3 = seed;
+        v4 = seed - A2P_XXH_PRIME1;
+        // four independent lanes keep the multipliers busy
+        while(end - p >= 16) {
+            v1 = a2p_xxh32_round(v1, a2p_xxh32_read(p));
+            v2 = a2p_xxh32_round(v2, a2p_xxh32_read(p + 4));
+            v3 = a2p_xxh32_round(v3, a2p_xxh32_read(p + 8));
+            v4 = a2p_xxh32_round(v4, a2p_xxh32_read(p + 12));
+            p += 16;
+        }
+        h = A2P_XXH_ROTL(v1, 1) + A2P_XXH_ROTL(v2, 7) +
+            A2P_XXH_ROTL(v3, 12) + A2P_XXH_ROTL(v4, 18);
+    } else {
+        h = seed + A2P_XXH_PRIME5;
+    }
+    h += (uint32_t) size;
+    
+    while(end - p >= 4) {
+        h += a2p_xxh32_read(p) * A2P_XXH_PRIME3;
+        h = A2P_XXH_ROTL(h, 17) * A2P_XXH_PRIME4;
+        p += 4;
+    }
+    while(p < end) {
+        h += *p++ * A2P_XXH_PRIME5;
+        h = A2P_XXH_ROTL(h, 11) * A2P_XXH_PRIME1;
+    }
+    
+    h ^= h >> 15;
+    h *= A2P_XXH_PRIME2;
+    h ^= h >> 13;
+    h *= A2P_XXH_PRIME3;
+    h ^= h >> 16;
+    
+    return h;
+}
@@ -0,0 +1,33 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// xxHash32 of a buffer, a fast check for frames damaged in transit. The
+// values match the reference implementation.
+
+#ifndef XXH32_H
+#define XXH32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+uint32_t
+a2p_xxh32(const void *data, size_t size, uint32_t seed);
+
+#endif // XXH32_H
@@ -0,0 +1,149 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Checks every a2p_blit kernel writes the same bytes as the memcpy row
+// loop of avs_bit_blt, across odd widths, padded and unpadded pitches and
+// misaligned planes. Returns non-zero and lists the failures otherwise.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+#include "blit.h"
+
+#define A2P_TEST_FILL 0xcd
+
+typedef struct A2pBlitKernel A2pBlitKernel;
+
+struct A2pBlitKernel {
+    const char *name;
+    A2pBlitFunc func;
+    int         flags;          // a2p_cpu_flags the kernel needs
+};
+
+static const A2pBlitKernel a2p_test_kernels[] = {
+    { "a2p_blit",             a2p_blit,             0 },
+    { "a2p_blit_stream",      a2p_blit_stream,      0 },
+    { "a2p_blit_c",           a2p_blit_c,           0 },
+    { "a2p_blit_sse2",        a2p_blit_sse2,        A2P_CPU_SSE2 },
+    { "a2p_blit_stream_sse2", a2p_blit_stream_sse2, A2P_CPU_SSE2 },
+    #ifdef A2P_HAVE_AVX2
+    { "a2p_blit_avx2",        a2p_blit_avx2,        A2P_CPU_AVX2 },
+    { "a2p_blit_stream_avx2", a2p_blit_stream_avx2, A2P_CPU_AVX2 },
+    #endif
+};
+
+static const int a2p_test_widths[] = {
+    1, 3, 7, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 129, 255, 257, 1000,
+    1921
+};
+
+static const int a2p_test_heights[] = { 1, 2, 5 };
+
+// pitch - row_size, 0 is the single long copy of an unpadded plane
+static const int a2p_test_pads[] = { 0, 13, 64 };
+
+static const int a2p_test_offsets[] = { 0, 1, 5, 16, 31 };
+
+#define A2P_TEST_COUNT(a) ((int) (sizeof(a) / sizeof(a[0])))
+
+// avs_bit_blt, what a2p_video_pack copied planes with before the kernels
+static void
+a2p_test_reference(uint8_t *dst, int dst_pitch, const uint8_t *src,
+                   int src_pitch, int row_size, int height)
+{
+    int y;
+    
+    for(y = 0; y < height; y++) {
+        memcpy(dst + y * dst_pitch, src + y * src_pitch, row_size);
+    }
+}
+
+int
+main(void)
+{
+    const A2pBlitKernel *kernel;
+    uint8_t *src, *expect, *dst;
+    size_t size;
+    int flags, k, w, h, p, s, d, width, height, pitch, i, failed, checked;
+    
+    // the largest plane with room for the largest offset
+    size = (a2p_test_widths[A2P_TEST_COUNT(a2p_test_widths) - 1] + 64) * 5 +
+           64;
+    src = malloc(size);
+    expect = malloc(size);
+    dst = malloc(size);
+    if(src == NULL || expect == NULL || dst == NULL) {
+        fprintf(stderr, "could not allocate test planes.\n");
+        return 1;
+    }
+    for(i = 0; i < (int) size; i++) src[i] = (uint8_t) (i * 7 + (i >> 8));
+    
+    flags = a2p_cpu_flags();
+    failed = 0;
+    for(k = 0; k < A2P_TEST_COUNT(a2p_test_kernels); k++) {
+        kernel = &a2p_test_kernels[k];
+        if((flags & kernel->flags) != kernel->flags) {
+            fprintf(stdout, "%-22s skipped, not supported by this cpu\n",
+                    kernel->name);
+            continue;
+        }
+        checked = 0;
+        for(w = 0; w < A2P_TEST_COUNT(a2p_test_widths); w++)
+        for(h = 0; h < A2P_TEST_COUNT(a2p_test_heights); h++)
+        for(p = 0; p < A2P_TEST_COUNT(a2p_test_pads); p++)
+        for(s = 0; s < A2P_TEST_COUNT(a2p_test_offsets); s++)
+        for(d = 0; d < A2P_TEST_COUNT(a2p_test_offsets); d++) {
+            width = a2p_test_widths[w];
+            height = a2p_test_heights[h];
+            pitch = width + a2p_test_pads[p];
+            
+            // the padding between rows must be left alone as well
+            memset(expect, A2P_TEST_FILL, size);
+            memset(dst, A2P_TEST_FILL, size);
+            a2p_test_reference(expect + a2p_test_offsets[d], pitch,
+                               src + a2p_test_offsets[s], pitch, width,
+                               height);
+            kernel->func(dst + a2p_test_offsets[d], pitch,
+                         src + a2p_test_offsets[s], pitch, width, height);
+            if(memcmp(dst, expect, size) != 0) {
+                fprintf(stderr, "%s differs: width %d, height %d, pitch %d, "
+                        "src offset %d, dst offset %d\n", kernel->name,
+                        width, height, pitch, a2p_test_offsets[s],
+                        a2p_test_offsets[d]);
+                failed++;
+            }
+            checked++;
+        }
+        fprintf(stdout, "%-22s %d copies checked\n", kernel->name, checked);
+    }
+    
+    free(dst);
+    free(expect);
+    free(src);
+    
+    if(failed) {
+        fprintf(stderr, "%d copies differ from avs_bit_blt.\n", failed);
+        return 1;
+    }
+    fprintf(stdout, "all kernels match avs_bit_blt.\n");
+    
+    return 0;
+}
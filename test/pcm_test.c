@@ -0,0 +1,154 @@
+/* 
+ * Copyright (C) 2010-2011 Chris Beswick <chris.beswick@gmail.com>
+ *
+ * This file is part of avs2pipe.
+ *
+ * avs2pipe is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * avs2pipe is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with avs2pipe.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Checks the sse2 pcm kernels write the same samples and leave the same
+// dither state as the C ones, whose rounding they must match exactly for
+// a stream to be identical on every cpu. Returns non-zero and lists the
+// failures otherwise.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+#include "pcm.h"
+
+#define A2P_TEST_SAMPLES 4099
+
+typedef struct A2pPcmKernel A2pPcmKernel;
+
+struct A2pPcmKernel {
+    const char *name;
+    A2pPcmFunc  func;
+    A2pPcmFunc  reference;
+    int         bits;
+};
+
+static const A2pPcmKernel a2p_test_kernels[] = {
+    { "a2p_pcm_16_sse2", a2p_pcm_16_sse2, a2p_pcm_16_c, 16 },
+    { "a2p_pcm_24_sse2", a2p_pcm_24_sse2, a2p_pcm_24_c, 24 },
+};
+
+// sample counts, covering every tail after the simd loops
+static const int a2p_test_counts[] = {
+    0, 1, 2, 3, 4, 5, 7, 8, 9, 11, 12, 13, 15, 16, 17, 31, 33, 1000,
+    A2P_TEST_SAMPLES
+};
+
+#define A2P_TEST_COUNT(a) ((int) (sizeof(a) / sizeof(a[0])))
+
+// full scale noise and clipping, with exact halves of both output lsbs
+// and values just inside the clip every few samples
+static void
+a2p_test_samples(float *src, int count)
+{
+    uint32_t s;
+    int i;
+    
+    s = 12345;
+    for(i = 0; i < count; i++) {
+        s = s * 1664525 + 1013904223;
+        switch(i % 8) {
+        case 3:
+            src[i] = ((int32_t) (s >> 16) - 32768 + 0.5f) / 32768.0f;
+            break;
+        case 5:
+            src[i] = ((int32_t) (s >> 8) - 8388608 + 0.5f) / 8388608.0f;
+            break;
+        case 7:
+            src[i] = s & 0x100 ? 32767.0f / 32768 : -1.0f;
+            break;
+        default:
+            src[i] = ((int32_t) s / 2147483648.0f) * 1.25f;
+            break;
+        }
+    }
+}
+
+int
+main(void)
+{
+    const A2pPcmKernel *kernel;
+    A2pPcm expect_pcm, pcm;
+    uint8_t *expect, *dst;
+    float *src;
+    size_t size;
+    int k, c, dither, count, step, failed, checked;
+    
+    size = A2P_TEST_SAMPLES * 3 * 2;
+    src = malloc(A2P_TEST_SAMPLES * sizeof(*src));
+    expect = malloc(size);
+    dst = malloc(size);
+    if(src == NULL || expect == NULL || dst == NULL) {
+        fprintf(stderr, "could not allocate test samples.\n");
+        return 1;
+    }
+    a2p_test_samples(src, A2P_TEST_SAMPLES);
+    
+    failed = 0;
+    for(k = 0; k < A2P_TEST_COUNT(a2p_test_kernels); k++) {
+        kernel = &a2p_test_kernels[k];
+        if(!(a2p_cpu_flags() & A2P_CPU_SSE2)) {
+            fprintf(stdout, "%-16s skipped, not supported by this cpu\n",
+                    kernel->name);
+            continue;
+        }
+        checked = 0;
+        for(c = 0; c < A2P_TEST_COUNT(a2p_test_counts); c++)
+        for(dither = 0; dither < 2; dither++) {
+            count = a2p_test_counts[c];
+            step = count * kernel->bits / 8;
+            
+            // two calls in a row, the second starting from the dither
+            // state the first left, written after it
+            a2p_pcm_init(&expect_pcm, kernel->bits, dither);
+            a2p_pcm_init(&pcm, kernel->bits, dither);
+            memset(expect, 0, size);
+            memset(dst, 0, size);
+            kernel->reference(expect, src, count, expect_pcm.seed,
+                              expect_pcm.noise);
+            kernel->func(dst, src, count, pcm.seed, pcm.noise);
+            kernel->reference(expect + step, src, count, expect_pcm.seed,
+                              expect_pcm.noise);
+            kernel->func(dst + step, src, count, pcm.seed, pcm.noise);
+            if(memcmp(dst, expect, size) != 0 ||
+               memcmp(pcm.seed, expect_pcm.seed, sizeof(pcm.seed)) != 0) {
+                fprintf(stderr, "%s differs: %d samples, dither %d\n",
+                        kernel->name, count, dither);
+                failed++;
+            }
+            checked++;
+        }
+        fprintf(stdout, "%-16s %d conversions checked\n", kernel->name,
+                checked);
+    }
+    
+    free(dst);
+    free(expect);
+    free(src);
+    
+    if(failed) {
+        fprintf(stderr, "%d conversions differ from the C kernels.\n",
+                failed);
+        return 1;
+    }
+    fprintf(stdout, "all kernels match the C kernels.\n");
+    
+    return 0;
+}